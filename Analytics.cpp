@@ -0,0 +1,510 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Analytics.h"
+
+using namespace std;
+
+// Constants for the report
+const int TICKS_PER_SECOND = 240; // The game's simulation rate
+const char HEATMAP_SHADES[] = " .:-=+*#%@";
+
+// Structure for command-line options
+struct AggregateOptions {
+    vector<string> files;
+    int threads = 0; // 0 picks one per core
+    bool humansOnly = false; // Leave out games the autopilot played
+    string heatmapFile; // CSV of deaths per cell, empty for none
+
+    // Log generator
+    long long generateSessions = 0;
+    string generateFile;
+};
+
+// Structure for the cleared levels of one level number
+struct LevelTotals {
+    long long cleared = 0;
+    long long ticks = 0;
+    uint32_t fastest = UINT32_MAX;
+    uint32_t slowest = 0;
+};
+
+// Structure for everything counted over a set of logs. Each thread fills its
+// own, and they are summed at the end.
+struct AnalyticsTotals {
+    long long files = 0;
+    long long bytes = 0;
+    long long damaged = 0; // Not a log, or cut short; the blocks before the damage still count
+    long long sessions = 0;
+    long long botSessions = 0;
+    long long finished = 0;
+    long long scoreSum = 0;
+    uint32_t bestScore = 0;
+    long long ticksPlayed = 0;
+    long long poisoned = 0;
+    long long kills[AS_COUNT] = {};
+    long long killRows[AS_COUNT][ANALYTICS_GRID] = {};
+    long long deaths[AS_COUNT] = {};
+    long long deathCells[ANALYTICS_GRID * ANALYTICS_GRID] = {};
+    LevelTotals levels[ANALYTICS_MAX_LEVEL + 1];
+    long long frames[ANALYTICS_FRAME_BUCKETS] = {};
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//                                                                         //
+// Function declarations                                                   //
+//                                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+// Helper functions
+void parseOptions(int argc, char* argv[], AggregateOptions& options);
+long long percentile(const long long counts[], int buckets, double fraction);
+
+// Aggregation functions
+void aggregateWorker(const AggregateOptions* options, atomic<int>* nextFile, AnalyticsTotals* totals);
+bool aggregateFile(const string& path, bool humansOnly, AnalyticsTotals& totals);
+bool scanLog(const uint8_t* data, size_t size, bool humansOnly, AnalyticsTotals& totals);
+void scanEvents(const uint8_t* columns, uint32_t count, bool humansOnly, bool& counting, AnalyticsTotals& totals);
+void mergeTotals(AnalyticsTotals& into, const AnalyticsTotals& from);
+
+// Report functions
+void printReport(const AnalyticsTotals& totals, double seconds);
+void printHeatmap(const AnalyticsTotals& totals);
+bool writeHeatmap(const AnalyticsTotals& totals, const string& path);
+
+// Generator functions
+int runGenerator(const AggregateOptions& options);
+void writeEventColumns(FILE* file, const vector<uint32_t>& tick, const vector<uint32_t>& value, const vector<uint16_t>& level,
+                       const vector<uint16_t>& cell, const vector<uint8_t>& kind, const vector<uint8_t>& subject);
+
+int main(int argc, char* argv[]) {
+    AggregateOptions options;
+    parseOptions(argc, argv, options);
+    if (options.generateSessions > 0) {
+        return runGenerator(options);
+    }
+    if (options.files.empty()) {
+        cerr << "Usage: " << argv[0] << " [--threads N] [--humans] [--heatmap FILE] LOG..." << endl;
+        cerr << "       " << argv[0] << " --generate SESSIONS FILE" << endl;
+        return 1;
+    }
+
+    // Files are handed out one at a time, so a few large logs and many small ones both spread evenly
+    int threadCount = options.threads > 0 ? options.threads : max(1u, thread::hardware_concurrency());
+    threadCount = min<int>(threadCount, options.files.size());
+    vector<AnalyticsTotals> partial(threadCount);
+    vector<thread> workers;
+    atomic<int> nextFile{0};
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < threadCount; i++) {
+        workers.emplace_back(aggregateWorker, &options, &nextFile, &partial[i]);
+    }
+    AnalyticsTotals totals;
+    for (int i = 0; i < threadCount; i++) {
+        workers[i].join();
+        mergeTotals(totals, partial[i]);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printReport(totals, seconds);
+    if (!options.heatmapFile.empty() && !writeHeatmap(totals, options.heatmapFile)) {
+        cerr << "Could not write " << options.heatmapFile << endl;
+        return 1;
+    }
+    return totals.damaged > 0 ? 2 : 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//                                                                          //
+// Function implementations                                                 //
+//                                                                          //
+//////////////////////////////////////////////////////////////////////////////
+
+// Helper functions
+void parseOptions(int argc, char* argv[], AggregateOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            options.threads = max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--humans") {
+            // Only count games a person played
+            options.humansOnly = true;
+        }
+        else if (arg == "--heatmap" && i + 1 < argc) {
+            // Also write the death counts per cell as CSV, one grid row per line
+            options.heatmapFile = argv[++i];
+        }
+        else if (arg == "--generate" && i + 2 < argc) {
+            // Write a log of made-up sessions, for trying the aggregator at scale
+            options.generateSessions = max(0LL, atoll(argv[++i]));
+            options.generateFile = argv[++i];
+        }
+        else {
+            options.files.push_back(arg);
+        }
+    }
+}
+
+long long percentile(const long long counts[], int buckets, double fraction) {
+    // The bucket holding the given fraction of all samples, -1 if there are none
+    long long total = 0;
+    for (int i = 0; i < buckets; i++) {
+        total += counts[i];
+    }
+    if (total == 0)
+        return -1;
+    long long target = (long long) (fraction * total);
+    long long seen = 0;
+    for (int i = 0; i < buckets; i++) {
+        seen += counts[i];
+        if (seen > target)
+            return i;
+    }
+    return buckets - 1;
+}
+
+// Aggregation functions
+void aggregateWorker(const AggregateOptions* options, atomic<int>* nextFile, AnalyticsTotals* totals) {
+    while (true) {
+        int i = (*nextFile)++;
+        if (i >= (int) options->files.size())
+            return;
+        if (!aggregateFile(options->files[i], options->humansOnly, *totals)) {
+            cerr << "Could not read all of " << options->files[i] << endl;
+            totals->damaged++;
+        }
+    }
+}
+
+bool aggregateFile(const string& path, bool humansOnly, AnalyticsTotals& totals) {
+    // The log is mapped rather than read, so only the pages the scan touches
+    // come in, straight from the page cache
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = info.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    totals.files++;
+    totals.bytes += size;
+    bool ok = scanLog((const uint8_t*) data, size, humansOnly, totals);
+    munmap(data, size);
+    return ok;
+}
+
+bool scanLog(const uint8_t* data, size_t size, bool humansOnly, AnalyticsTotals& totals) {
+    AnalyticsFileHeader header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != ANALYTICS_MAGIC || header.version != ANALYTICS_VERSION)
+        return false;
+
+    // Blocks are walked in order: whether a session counts is decided by its
+    // start event, and its frame times come after its last events
+    size_t at = sizeof(header);
+    bool counting = true;
+    while (at + sizeof(AnalyticsBlockHeader) <= size) {
+        AnalyticsBlockHeader block;
+        memcpy(&block, data + at, sizeof(block));
+        at += sizeof(block);
+        size_t bytes = analyticsBlockBytes(block.type, block.count);
+        bool valid = (block.type == AB_EVENTS && block.count <= ANALYTICS_BLOCK_EVENTS) ||
+                     (block.type == AB_FRAMES && block.count == ANALYTICS_FRAME_BUCKETS);
+        if (!valid || bytes > size - at)
+            return false;
+
+        if (block.type == AB_EVENTS) {
+            scanEvents(data + at, block.count, humansOnly, counting, totals);
+        } else if (counting) {
+            const uint32_t* frames = (const uint32_t*) (data + at);
+            for (int i = 0; i < ANALYTICS_FRAME_BUCKETS; i++) {
+                totals.frames[i] += frames[i];
+            }
+        }
+        at += bytes;
+    }
+    return at == size;
+}
+
+void scanEvents(const uint8_t* columns, uint32_t count, bool humansOnly, bool& counting, AnalyticsTotals& totals) {
+    // Columns start on 4-byte boundaries, so each can be read in place
+    const uint32_t* tick = (const uint32_t*) columns;
+    const uint32_t* value = tick + count;
+    const uint16_t* level = (const uint16_t*) (value + count);
+    const uint16_t* cell = (const uint16_t*) ((const uint8_t*) level + analyticsPad(2 * count));
+    const uint8_t* kind = (const uint8_t*) cell + analyticsPad(2 * count);
+    const uint8_t* subject = kind + analyticsPad(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (kind[i] == AE_START) {
+            counting = !humansOnly || value[i] == 0;
+            if (counting) {
+                totals.sessions++;
+                totals.botSessions += value[i] != 0;
+            }
+            continue;
+        }
+        if (!counting || subject[i] >= AS_COUNT || cell[i] >= ANALYTICS_GRID * ANALYTICS_GRID)
+            continue;
+        switch (kind[i]) {
+            case AE_KILL:
+                totals.kills[subject[i]]++;
+                totals.killRows[subject[i]][cell[i] / ANALYTICS_GRID]++;
+                break;
+            case AE_DEATH:
+                totals.deaths[subject[i]]++;
+                totals.deathCells[cell[i]]++;
+                break;
+            case AE_POISON:
+                totals.poisoned++;
+                break;
+            case AE_LEVEL: {
+                LevelTotals& cleared = totals.levels[min<int>(level[i], ANALYTICS_MAX_LEVEL)];
+                cleared.cleared++;
+                cleared.ticks += value[i];
+                cleared.fastest = min(cleared.fastest, value[i]);
+                cleared.slowest = max(cleared.slowest, value[i]);
+                break;
+            }
+            case AE_END:
+                totals.finished++;
+                totals.scoreSum += value[i];
+                totals.bestScore = max(totals.bestScore, value[i]);
+                totals.ticksPlayed += tick[i];
+                break;
+        }
+    }
+}
+
+void mergeTotals(AnalyticsTotals& into, const AnalyticsTotals& from) {
+    into.files += from.files;
+    into.bytes += from.bytes;
+    into.damaged += from.damaged;
+    into.sessions += from.sessions;
+    into.botSessions += from.botSessions;
+    into.finished += from.finished;
+    into.scoreSum += from.scoreSum;
+    into.bestScore = max(into.bestScore, from.bestScore);
+    into.ticksPlayed += from.ticksPlayed;
+    into.poisoned += from.poisoned;
+    for (int s = 0; s < AS_COUNT; s++) {
+        into.kills[s] += from.kills[s];
+        into.deaths[s] += from.deaths[s];
+        for (int r = 0; r < ANALYTICS_GRID; r++) {
+            into.killRows[s][r] += from.killRows[s][r];
+        }
+    }
+    for (int c = 0; c < ANALYTICS_GRID * ANALYTICS_GRID; c++) {
+        into.deathCells[c] += from.deathCells[c];
+    }
+    for (int l = 0; l <= ANALYTICS_MAX_LEVEL; l++) {
+        into.levels[l].cleared += from.levels[l].cleared;
+        into.levels[l].ticks += from.levels[l].ticks;
+        into.levels[l].fastest = min(into.levels[l].fastest, from.levels[l].fastest);
+        into.levels[l].slowest = max(into.levels[l].slowest, from.levels[l].slowest);
+    }
+    for (int b = 0; b < ANALYTICS_FRAME_BUCKETS; b++) {
+        into.frames[b] += from.frames[b];
+    }
+}
+
+// Report functions
+void printReport(const AnalyticsTotals& totals, double seconds) {
+    double games = max(1LL, totals.sessions);
+    double finished = max(1LL, totals.finished);
+    printf("Sessions: %lld (%lld by the autopilot) from %lld files, %.1f MB%s\n", totals.sessions, totals.botSessions,
+           totals.files, totals.bytes / 1048576.0, totals.damaged ? ", some damaged" : "");
+    printf("Finished games: %lld, mean score %.0f, best %u, mean length %.1f s\n", totals.finished,
+           totals.scoreSum / finished, totals.bestScore, totals.ticksPlayed / finished / TICKS_PER_SECOND);
+
+    printf("\nKills            total   per game\n");
+    for (int s = 1; s < AS_COUNT; s++) {
+        if (totals.kills[s])
+            printf("  %-15s %9lld %9.2f\n", ANALYTICS_SUBJECT_NAMES[s], totals.kills[s], totals.kills[s] / games);
+    }
+    printf("\nKills by row (top to bottom)\n  row");
+    for (int s = 1; s < AS_COUNT; s++) {
+        if (totals.kills[s])
+            printf(" %9.9s", ANALYTICS_SUBJECT_NAMES[s]);
+    }
+    printf("\n");
+    for (int r = 0; r < ANALYTICS_GRID; r++) {
+        printf("  %3d", r);
+        for (int s = 1; s < AS_COUNT; s++) {
+            if (totals.kills[s])
+                printf(" %9lld", totals.killRows[s][r]);
+        }
+        printf("\n");
+    }
+
+    printf("\nDeaths           total   per game\n");
+    for (int s = 1; s < AS_COUNT; s++) {
+        if (totals.deaths[s])
+            printf("  %-15s %9lld %9.2f\n", ANALYTICS_SUBJECT_NAMES[s], totals.deaths[s], totals.deaths[s] / games);
+    }
+    printf("Mushrooms poisoned: %lld, %.2f per game\n", totals.poisoned, totals.poisoned / games);
+
+    printf("\nLevel  cleared   mean s  fastest s  slowest s\n");
+    for (int l = 0; l <= ANALYTICS_MAX_LEVEL; l++) {
+        const LevelTotals& level = totals.levels[l];
+        if (level.cleared == 0)
+            continue;
+        printf("  %2d%s %9lld %8.1f %10.1f %10.1f\n", l, l == ANALYTICS_MAX_LEVEL ? "+" : " ", level.cleared,
+               (double) level.ticks / level.cleared / TICKS_PER_SECOND, (double) level.fastest / TICKS_PER_SECOND,
+               (double) level.slowest / TICKS_PER_SECOND);
+    }
+
+    printf("\nFrame times (ms, to within one histogram bucket):");
+    const double fractions[] = {0.5, 0.9, 0.99, 0.999};
+    const char* names[] = {"p50", "p90", "p99", "p99.9"};
+    for (int i = 0; i < 4; i++) {
+        long long bucket = percentile(totals.frames, ANALYTICS_FRAME_BUCKETS, fractions[i]);
+        if (bucket >= 0)
+            printf(" %s %.2f", names[i], analyticsBucketMicros(bucket) / 1000.0f);
+    }
+    printf("\n\n");
+
+    printHeatmap(totals);
+    printf("\nAggregated in %.3f s (%.0f sessions/s, %.0f MB/s)\n", seconds, totals.sessions / max(seconds, 1e-9),
+           totals.bytes / 1048576.0 / max(seconds, 1e-9));
+}
+
+void printHeatmap(const AnalyticsTotals& totals) {
+    // One character per cell, darker where more players died
+    long long most = *max_element(totals.deathCells, totals.deathCells + ANALYTICS_GRID * ANALYTICS_GRID);
+    int shades = sizeof(HEATMAP_SHADES) - 2;
+    printf("Deaths by cell (most %lld in one cell)\n", most);
+    for (int r = 0; r < ANALYTICS_GRID; r++) {
+        string line = "  |";
+        for (int c = 0; c < ANALYTICS_GRID; c++) {
+            long long deaths = totals.deathCells[r * ANALYTICS_GRID + c];
+            int shade = deaths == 0 ? 0 : 1 + (int) ((shades - 1) * deaths / max(1LL, most));
+            line += HEATMAP_SHADES[shade];
+        }
+        printf("%s|\n", line.c_str());
+    }
+}
+
+bool writeHeatmap(const AnalyticsTotals& totals, const string& path) {
+    ofstream file(path);
+    for (int r = 0; r < ANALYTICS_GRID; r++) {
+        for (int c = 0; c < ANALYTICS_GRID; c++) {
+            file << totals.deathCells[r * ANALYTICS_GRID + c] << (c + 1 < ANALYTICS_GRID ? "," : "\n");
+        }
+    }
+    return (bool) file;
+}
+
+// Generator functions
+int runGenerator(const AggregateOptions& options) {
+    // Sessions of a made-up player: a few levels, kills mostly high on the
+    // field, deaths mostly near the bottom. Only the shape matters.
+    FILE* file = fopen(options.generateFile.c_str(), "wb");
+    if (!file) {
+        cerr << "Could not write " << options.generateFile << endl;
+        return 1;
+    }
+    AnalyticsFileHeader header = {ANALYTICS_MAGIC, ANALYTICS_VERSION};
+    fwrite(&header, sizeof(header), 1, file);
+
+    unsigned int seed = 12345;
+    auto random = [&](int range) {
+        seed = seed * 1103515245 + 12345;
+        return (int) ((seed >> 8) % range);
+    };
+    vector<uint32_t> tick, value, frames(ANALYTICS_FRAME_BUCKETS);
+    vector<uint16_t> level, cell;
+    vector<uint8_t> kind, subject;
+    auto add = [&](uint32_t t, uint32_t v, int l, int c, int k, int s) {
+        tick.push_back(t);
+        value.push_back(v);
+        level.push_back(l);
+        cell.push_back(c);
+        kind.push_back(k);
+        subject.push_back(s);
+    };
+    for (long long session = 0; session < options.generateSessions; session++) {
+        tick.clear(); value.clear(); level.clear(); cell.clear(); kind.clear(); subject.clear();
+        uint32_t now = 0, score = 0;
+        int lives = 3, currentLevel = 1;
+        add(0, random(10) == 0, currentLevel, 0, AE_START, AS_NONE);
+        while (lives > 0 && kind.size() + 256 < ANALYTICS_BLOCK_EVENTS) {
+            uint32_t levelStart = now;
+            for (int kills = 20 + random(20); kills > 0; kills--) {
+                now += 30 + random(400);
+                int row = min(random(ANALYTICS_GRID), random(ANALYTICS_GRID));
+                add(now, 0, currentLevel, row * ANALYTICS_GRID + random(ANALYTICS_GRID), AE_KILL, AS_SEGMENT + random(AS_COUNT - 1));
+                score += 10 + 90 * (random(8) == 0);
+                if (random(12) == 0)
+                    add(now, 0, currentLevel, 26 * ANALYTICS_GRID + random(ANALYTICS_GRID), AE_POISON, AS_SCORPION);
+                if (random(30) == 0) {
+                    int deathRow = ANALYTICS_GRID - 1 - min(random(10), random(10));
+                    add(now, 0, currentLevel, deathRow * ANALYTICS_GRID + random(ANALYTICS_GRID), AE_DEATH, AS_SEGMENT + random(4));
+                    if (--lives == 0)
+                        break;
+                }
+            }
+            if (lives > 0) {
+                add(now, now - levelStart, currentLevel, 0, AE_LEVEL, AS_NONE);
+                currentLevel++;
+            }
+        }
+        add(now, score, currentLevel, 29 * ANALYTICS_GRID + 15, AE_END, AS_NONE);
+        writeEventColumns(file, tick, value, level, cell, kind, subject);
+
+        for (int b = 0; b < ANALYTICS_FRAME_BUCKETS; b++) {
+            frames[b] = 0;
+        }
+        for (uint32_t frame = 0; frame < now / 4; frame += 16) {
+            frames[analyticsFrameBucket(16000.0f + random(2000) + (random(200) == 0) * random(40000))] += 16;
+        }
+        AnalyticsBlockHeader framesHeader = {AB_FRAMES, ANALYTICS_FRAME_BUCKETS};
+        fwrite(&framesHeader, sizeof(framesHeader), 1, file);
+        fwrite(frames.data(), sizeof(uint32_t), ANALYTICS_FRAME_BUCKETS, file);
+    }
+    bool ok = fclose(file) == 0;
+    cout << "Wrote " << options.generateSessions << " sessions to " << options.generateFile << endl;
+    return ok ? 0 : 1;
+}
+
+void writeEventColumns(FILE* file, const vector<uint32_t>& tick, const vector<uint32_t>& value, const vector<uint16_t>& level,
+                       const vector<uint16_t>& cell, const vector<uint8_t>& kind, const vector<uint8_t>& subject) {
+    // The same layout the game writes: each column padded to 4 bytes
+    static const uint8_t padding[4] = {};
+    uint32_t count = tick.size();
+    AnalyticsBlockHeader header = {AB_EVENTS, count};
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(tick.data(), sizeof(uint32_t), count, file);
+    fwrite(value.data(), sizeof(uint32_t), count, file);
+    fwrite(level.data(), sizeof(uint16_t), count, file);
+    fwrite(padding, 1, analyticsPad(2 * count) - 2 * count, file);
+    fwrite(cell.data(), sizeof(uint16_t), count, file);
+    fwrite(padding, 1, analyticsPad(2 * count) - 2 * count, file);
+    fwrite(kind.data(), sizeof(uint8_t), count, file);
+    fwrite(padding, 1, analyticsPad(count) - count, file);
+    fwrite(subject.data(), sizeof(uint8_t), count, file);
+    fwrite(padding, 1, analyticsPad(count) - count, file);
+}
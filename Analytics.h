@@ -0,0 +1,101 @@
+// Session log format shared by the game's analytics writer and the aggregator (Analytics.cpp).
+// A log is the file header followed by blocks. A block is its header, then its
+// columns one after another (every value of one field, then the next field),
+// each column padded to 4 bytes, so a reader scanning one field never touches
+// the others. Values are little-endian, as written by the machine that played.
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+const uint32_t ANALYTICS_MAGIC = 0x4c474e41; // "ANGL"
+const uint32_t ANALYTICS_VERSION = 1;
+const int ANALYTICS_GRID = 30; // Cells per side of the playing field
+const int ANALYTICS_BLOCK_EVENTS = 4096; // Most events in one block
+const int ANALYTICS_MAX_LEVEL = 64; // Levels past this are counted with it
+
+// Frame times are kept as a histogram: bucket 0 ends at the base time and
+// every bucket after it is 2^(1/8) longer, so percentiles come out within 9%.
+const int ANALYTICS_FRAME_BUCKETS = 96;
+const int ANALYTICS_BUCKETS_PER_OCTAVE = 8;
+const float ANALYTICS_FRAME_BASE_MICROS = 250.0f;
+
+// Block types
+enum AnalyticsBlock {
+    AB_EVENTS, // uint32 tick, uint32 value, uint16 level, uint16 cell, uint8 kind, uint8 subject per event
+    AB_FRAMES  // uint32 frame count per bucket, for the session that just ended
+};
+
+// Event kinds. A session's events run from its start to its end in one file.
+enum AnalyticsEvent {
+    AE_START,  // value 1 if the autopilot is playing
+    AE_KILL,   // subject was shot in cell
+    AE_DEATH,  // subject killed the player in cell
+    AE_POISON, // subject poisoned the mushroom in cell
+    AE_LEVEL,  // level was cleared after value ticks
+    AE_END     // value is the final score
+};
+
+// What was killed, or what did the killing
+enum AnalyticsSubject {
+    AS_NONE,
+    AS_SEGMENT,
+    AS_HEAD,
+    AS_FLEA,
+    AS_SPIDER,
+    AS_SCORPION,
+    AS_MUSHROOM,
+    AS_POISON_MUSHROOM,
+    AS_COUNT
+};
+
+const char* const ANALYTICS_SUBJECT_NAMES[AS_COUNT] = {
+    "none", "segment", "head", "flea", "spider", "scorpion", "mushroom", "poison mushroom"
+};
+
+struct AnalyticsFileHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct AnalyticsBlockHeader {
+    uint32_t type;
+    uint32_t count; // Events, or buckets
+};
+
+inline size_t analyticsPad(size_t bytes) {
+    return (bytes + 3) & ~(size_t) 3;
+}
+
+// Bytes of column data following a block header
+inline size_t analyticsBlockBytes(uint32_t type, uint32_t count) {
+    if (type == AB_FRAMES)
+        return 4 * (size_t) count;
+    return 8 * (size_t) count + 2 * analyticsPad(2 * (size_t) count) + 2 * analyticsPad(count);
+}
+
+inline int analyticsFrameBucket(float micros) {
+    if (micros <= ANALYTICS_FRAME_BASE_MICROS)
+        return 0;
+    int bucket = (int) ceil(ANALYTICS_BUCKETS_PER_OCTAVE * log2(micros / ANALYTICS_FRAME_BASE_MICROS));
+    return bucket < ANALYTICS_FRAME_BUCKETS ? bucket : ANALYTICS_FRAME_BUCKETS - 1;
+}
+
+// Longest frame time a bucket holds
+inline float analyticsBucketMicros(int bucket) {
+    return ANALYTICS_FRAME_BASE_MICROS * exp2((float) bucket / ANALYTICS_BUCKETS_PER_OCTAVE);
+}
+
+inline int analyticsCell(float posX, float posY) {
+    // Cells are 32 pixels square, and entities are placed by their top-left
+    // corner, so use the cell under their middle
+    int column = (int) (posX + 16) / 32;
+    int row = (int) (posY + 16) / 32;
+    column = column < 0 ? 0 : column >= ANALYTICS_GRID ? ANALYTICS_GRID - 1 : column;
+    row = row < 0 ? 0 : row >= ANALYTICS_GRID ? ANALYTICS_GRID - 1 : row;
+    return row * ANALYTICS_GRID + column;
+}
+
+#endif
@@ -0,0 +1,769 @@
+// The headless benchmarks and checks, kept out of the game so it only plays.
+// The whole game is built in without its main, so every mode runs the code
+// that ships. A new mode is one function and one entry in HEADLESS_MODES.
+#define CENTIPEDE_NO_MAIN
+#include "Centipede.cpp"
+#include <cstdarg>
+
+// Constants for the modes
+const int BENCH_TICKS = 10 * SIM_TICKS_PER_SECOND; // How long the world benchmarks run
+const int BENCH_LABEL_WIDTH = 16;
+const int MAX_BENCH_TIMERS = 60000;
+const unsigned int HEADLESS_PARTICLE_SEED = 1; // So headless runs draw the same bursts every time
+const int ALLOC_WARMUP_FRAMES = 120; // Frames the check lets settle (glyph pages, first sounds)
+const float ALLOC_CHECK_SECONDS = 60.0f;
+
+// Structure for command-line options
+struct BenchOptions {
+    float amount = 0.0f; // The number after the mode: a count or seconds
+    GameOptions game; // Everything after it, read as the game reads it
+};
+
+// Structure for one mode
+struct HeadlessMode {
+    const char* name;
+    const char* amount; // What the number after the name means, nullptr if it takes none
+    float defaultAmount;
+    float maxAmount;
+    int (*run)(const BenchOptions& options);
+    const char* help;
+};
+
+// Structure for the offscreen target and everything the render modes draw with
+struct HeadlessScene {
+    sf::RenderTexture target;
+    ResourceCache resources;
+    shared_ptr<sf::Font> font;
+    HudText hud;
+    GameSprites sprites;
+    shared_ptr<sf::Texture> mushTexture;
+    sf::Texture particleTexture;
+    ParticleSystem particles;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//                                                                         //
+// Function declarations                                                   //
+//                                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+// Helper functions
+const HeadlessMode* parseOptions(int argc, char* argv[], BenchOptions& options);
+void printUsage();
+void initializeCrowdedWorld(GameWorld& world, int fireRate, int enemies, bool scorpions);
+bool initializeScene(HeadlessScene& scene);
+
+// Report functions
+void benchTitle(const char* format, ...);
+void benchLine(const char* label, const char* format, ...);
+int benchVerdict(int failures, const char* failed, const char* passed);
+int countDrawnEntities(const GameWorld& world);
+bool checkRenderBudget(const string& scene, Canvas& canvas, int subsystem, int maxDrawCalls, long long maxVertices);
+
+// Mode functions
+int runBotBenchmark(const BenchOptions& options);
+int runEnemyBenchmark(const BenchOptions& options);
+int runTimerBenchmark(const BenchOptions& options);
+int runOverlapBenchmark(const BenchOptions& options);
+int runFieldBenchmark(const BenchOptions& options);
+int runFlowBenchmark(const BenchOptions& options);
+int runJobBenchmark(const BenchOptions& options);
+int runRenderCheck(const BenchOptions& options);
+int runAllocCheck(const BenchOptions& options);
+int runCaptureDemo(const BenchOptions& options);
+
+const HeadlessMode HEADLESS_MODES[] = {
+    {"bot", "SECONDS", 10, 3600, runBotBenchmark,
+     "let the autopilot play and print rollouts/s (--bot-rollouts, --bot-threads, --fire-rate)"},
+    {"enemies", "N", 256, MAX_ENEMIES, runEnemyBenchmark, "time N scripted spiders and scorpions"},
+    {"timers", "N", 10000, MAX_BENCH_TIMERS, runTimerBenchmark, "churn N timers for ten minutes and check each goes off on time"},
+    {"overlap", nullptr, 0, 0, runOverlapBenchmark, "check the overlap kernels this CPU runs against the scalar one and time them"},
+    {"fields", "N", 10000, 1000000, runFieldBenchmark, "draw N mushroom fields per style, check their rules and time them"},
+    {"flow", "N", 256, MAX_ENEMIES, runFlowBenchmark, "chase the player with N spiders, check every flow field update and time it"},
+    {"jobs", nullptr, 0, 0, runJobBenchmark, "step a crowded world on one thread and on --sim-threads, check they match"},
+    {"render-check", nullptr, 0, 0, runRenderCheck, "draw fixed scenes offscreen and fail if any goes over its budget"},
+    {"check-allocs", nullptr, 0, 0, runAllocCheck, "play offscreen and fail if any frame allocates after warm-up"},
+    {"record-demo", "SECONDS", 10, 3600, runCaptureDemo, "record the scripted demo to --record, the same on every run"},
+};
+const int HEADLESS_MODE_COUNT = sizeof(HEADLESS_MODES) / sizeof(HEADLESS_MODES[0]);
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    const HeadlessMode* mode = parseOptions(argc, argv, options);
+    if (!mode) {
+        printUsage();
+        return 2;
+    }
+    return mode->run(options);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//                                                                         //
+// Helper functions                                                        //
+//                                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+const HeadlessMode* parseOptions(int argc, char* argv[], BenchOptions& options) {
+    if (argc < 2)
+        return nullptr;
+    const HeadlessMode* mode = nullptr;
+    for (int m = 0; m < HEADLESS_MODE_COUNT; m++) {
+        if (strcmp(argv[1], HEADLESS_MODES[m].name) == 0)
+            mode = &HEADLESS_MODES[m];
+    }
+    if (!mode) {
+        cerr << "Unknown mode: " << argv[1] << endl;
+        return nullptr;
+    }
+
+    // The amount is optional; the game's own options follow it
+    int next = 2;
+    options.amount = mode->defaultAmount;
+    if (mode->amount && next < argc && argv[next][0] != '-') {
+        options.amount = min(max(1.0f, (float) atof(argv[next])), mode->maxAmount);
+        next++;
+    }
+    parseOptions(argc - next + 1, argv + next - 1, options.game);
+    return mode;
+}
+
+void printUsage() {
+    cerr << "Usage: centipede-bench MODE [AMOUNT] [game options]" << endl;
+    for (int m = 0; m < HEADLESS_MODE_COUNT; m++) {
+        const HeadlessMode& mode = HEADLESS_MODES[m];
+        string name = mode.name;
+        if (mode.amount)
+            name += string(" [") + mode.amount + "]";
+        cerr << "  " << name << string(max(1, 24 - (int) name.size()), ' ') << mode.help << endl;
+    }
+}
+
+void initializeCrowdedWorld(GameWorld& world, int fireRate, int enemies, bool scorpions) {
+    // A new game with its enemies replaced by spiders (and scorpions, every
+    // other one) spread over the bottom of the field
+    initializeGame(world, 1, fireRate);
+    world.enemies.count = 0;
+    for (int i = 0; i < enemies; i++) {
+        int kind = scorpions && i % 2 ? ENEMY_SCORPION : ENEMY_SPIDER;
+        int column = (i * 7) % (gameColumns - 2);
+        int row = kind == ENEMY_SPIDER ? 20 + i % 9 : 26;
+        spawnEnemy(world.enemies, kind, toFixed(column * boxPixelsX), toFixed(row * boxPixelsY));
+    }
+}
+
+bool initializeScene(HeadlessScene& scene) {
+    if (!scene.target.create(resolutionX, resolutionY)) {
+        cerr << "Could not create the offscreen render target" << endl;
+        return false;
+    }
+    scene.font = cachedFont(scene.resources, "/usr/share/fonts/truetype/freefont/FreeMonoBold.ttf");
+    hudInit(scene.hud, *scene.font);
+    scene.mushTexture = loadSprites(scene.resources, scene.sprites);
+    buildParticleAtlas(scene.particleTexture);
+    particlesInit(scene.particles, HEADLESS_PARTICLE_SEED);
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//                                                                         //
+// Report functions                                                        //
+//                                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+void benchTitle(const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    cout << line << endl;
+}
+
+void benchLine(const char* label, const char* format, ...) {
+    // "  label:         value", the values lined up under each other
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    string head = string(label) + ":";
+    cout << "  " << head << string(max(1, BENCH_LABEL_WIDTH - (int) head.size()), ' ') << line << endl;
+}
+
+int benchVerdict(int failures, const char* failed, const char* passed) {
+    // failed reads the count with %d; returns the exit code
+    if (failures > 0) {
+        char line[256];
+        snprintf(line, sizeof(line), failed, failures);
+        cout << "  " << line << endl;
+        return 1;
+    }
+    cout << "  " << passed << endl;
+    return 0;
+}
+
+int countDrawnEntities(const GameWorld& world) {
+    // Everything drawWorld may draw one sprite for
+    int entities = 1 + world.bullets.count; // Player and bullets
+    for (int i = 0; i < world.centipedeLength; i++)
+        entities += world.centipede[i][4] ? 1 : 0;
+    for (int i = 0; i < MAX_HEADS; i++)
+        entities += world.centipedeheads[i][2] ? 1 : 0;
+    for (int i = 0; i < world.nmush; i++)
+        entities += world.mush[i][3] ? 1 : 0;
+    for (int i = 0; i < world.enemies.count; i++)
+        entities += world.enemies.items[i].alive ? 1 : 0;
+    return entities;
+}
+
+bool checkRenderBudget(const string& scene, Canvas& canvas, int subsystem, int maxDrawCalls, long long maxVertices) {
+    RenderCounts& c = canvas.frame[subsystem];
+    bool ok = c.drawCalls <= maxDrawCalls && c.vertices <= maxVertices;
+    cout << (ok ? "  ok    " : "  FAIL  ") << scene << " / " << RENDER_SUBSYSTEM_NAMES[subsystem] << ": "
+         << c.drawCalls << " draws (budget " << maxDrawCalls << "), " << c.vertices << " vertices (budget " << maxVertices << "), "
+         << c.textureSwitches << " texture switches" << endl;
+    return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//                                                                         //
+// Mode functions                                                          //
+//                                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+int runBotBenchmark(const BenchOptions& options) {
+    // Let the bot play for a while and report simulation throughput
+    const GameOptions& game = options.game;
+    GameWorld world;
+    Autopilot bot;
+    initializeGame(world, 1, game.fireRate);
+    autopilotStart(bot, game.botRollouts, game.botThreads);
+
+    sf::Clock benchClock;
+    long long ticks = 0;
+    int games = 1;
+    int bestScore = 0;
+    while (benchClock.getElapsedTime().asSeconds() < options.amount) {
+        stepWorld(world, autopilotInput(bot, world), nullptr);
+        ticks++;
+        if (world.player.lives <= 0) {
+            bestScore = max(bestScore, world.player.score);
+            initializeGame(world, ++games, game.fireRate);
+        }
+    }
+    bestScore = max(bestScore, world.player.score);
+    float seconds = benchClock.getElapsedTime().asSeconds();
+    float thinkSeconds = bot.thinkMicros / 1e6f;
+
+    benchTitle("Autopilot benchmark: %d threads, %d rollouts of %d ticks per decision",
+               (int) bot.workers.size() + 1, bot.rolloutsPerAction * BOT_ACTIONS, BOT_HORIZON_TICKS);
+    benchLine("rollouts/s", "%lld", (long long) (bot.rollouts / thinkSeconds));
+    benchLine("sim ticks/s", "%lld (upper bound, rollouts end early on death)", (long long) (bot.rollouts * BOT_HORIZON_TICKS / thinkSeconds));
+    benchLine("game ticks", "%lld in %g s (%g per s)", ticks, seconds, ticks / seconds);
+    benchLine("games / best", "%d / %d", games, bestScore);
+    autopilotStop(bot);
+    return 0;
+}
+
+int runEnemyBenchmark(const BenchOptions& options) {
+    // Time the enemy behaviors alone over a crowded field
+    int count = (int) options.amount;
+    static GameWorld world; // Too big for the stack
+    initializeCrowdedWorld(world, 0, count, true);
+
+    sf::Clock benchClock;
+    updateFlowField(world.flow, world.player, world.mush, world.nmush);
+    for (int t = 0; t < BENCH_TICKS; t++) {
+        updateEnemies(world.enemies, world.flow, world.mush, world.mushBoxes, world.nmush, world.stats, world.records);
+    }
+    float micros = benchClock.getElapsedTime().asMicroseconds();
+
+    benchTitle("Enemy benchmark: %d enemies, %d ticks", count, BENCH_TICKS);
+    benchLine("per tick", "%g us", micros / BENCH_TICKS);
+    benchLine("per enemy", "%g ns", 1000.0f * micros / BENCH_TICKS / count);
+    benchLine("pool memory", "%d bytes (%d per enemy)", (int) sizeof(EnemyPool), (int) sizeof(Enemy));
+    return 0;
+}
+
+int runTimerBenchmark(const BenchOptions& options) {
+    // Keep this many timers running with delays out to a minute, each
+    // restarted with a new delay when it goes off and a few more rescheduled
+    // or paused and resumed every tick, and check that every one goes off on
+    // the exact tick it was due
+    int count = (int) options.amount;
+    const int capacity = MAX_BENCH_TIMERS;
+    TimerWheel<capacity>* wheel = new TimerWheel<capacity>;
+    timerReset(*wheel);
+    unsigned int rng = 1;
+    unsigned short* handles = new unsigned short[count];
+    unsigned short* expired = new unsigned short[capacity];
+    for (int i = 0; i < count; i++) {
+        handles[i] = timerStart(*wheel, 1 + nextRandom(rng) % (60 * SIM_TICKS_PER_SECOND), i);
+    }
+
+    const int ticks = 60 * BENCH_TICKS;
+    long long fired = 0, late = 0, changes = 0;
+    sf::Clock benchClock;
+    for (int t = 0; t < ticks; t++) {
+        int expiredCount = timerAdvance(*wheel, expired);
+        for (int i = 0; i < expiredCount; i++) {
+            TimerNode& node = wheel->nodes[expired[i]];
+            if (node.due != wheel->now)
+                late++;
+            timerRestart(*wheel, expired[i], 1 + nextRandom(rng) % (60 * SIM_TICKS_PER_SECOND));
+        }
+        fired += expiredCount;
+        for (int i = 0; i < 8; i++) {
+            unsigned short timer = handles[nextRandom(rng) % count];
+            if (i % 2)
+                timerRestart(*wheel, timer, 1 + nextRandom(rng) % (60 * SIM_TICKS_PER_SECOND));
+            else {
+                timerPause(*wheel, timer);
+                timerResume(*wheel, timer);
+            }
+        }
+        changes += 8;
+    }
+    float micros = benchClock.getElapsedTime().asMicroseconds();
+
+    // A timer still waiting for a tick that has passed was skipped
+    for (int i = 0; i < count; i++) {
+        TimerNode& node = wheel->nodes[handles[i]];
+        if (node.slot < TIMER_FREE && (int) (node.due - wheel->now) <= 0)
+            late++;
+    }
+
+    benchTitle("Timer benchmark: %d timers, %d ticks", count, ticks);
+    benchLine("per tick", "%g us", micros / ticks);
+    benchLine("per operation", "%g ns (%lld went off, %lld rescheduled)", 1000.0f * micros / max(1LL, fired + changes), fired, changes);
+    benchLine("wheel memory", "%d bytes (%d per timer)", (int) sizeof(TimerWheel<capacity>), (int) sizeof(TimerNode));
+    delete[] expired;
+    delete[] handles;
+    delete wheel;
+    return benchVerdict((int) late, "%d timers went off on the wrong tick or not at all", "every timer went off on the tick it was due");
+}
+
+int runOverlapBenchmark(const BenchOptions&) {
+    // Check every kernel this CPU runs against the scalar one on random
+    // fields, then time one query against a full field
+    const int words = (MAX_MUSHROOMS + 31) / 32;
+    MushroomBoxes boxes;
+    unsigned int rng = 12345;
+    int mismatches = 0;
+    for (int trial = 0; trial < 20000; trial++) {
+        // Whole-pixel positions, so plenty of boxes exactly touch the query
+        int count = nextRandom(rng) % (MAX_MUSHROOMS + 1);
+        for (int i = 0; i < count; i++) {
+            boxes.x[i] = toFixed(nextRandom(rng) % (4 * boxPixelsX));
+            boxes.y[i] = toFixed(nextRandom(rng) % (4 * boxPixelsY));
+        }
+        Fixed boxX = toFixed(nextRandom(rng) % (4 * boxPixelsX)) + fixedRatio(nextRandom(rng) % 4, 4);
+        Fixed boxY = toFixed(nextRandom(rng) % (4 * boxPixelsY)) + fixedRatio(nextRandom(rng) % 4, 4);
+        int from = count ? nextRandom(rng) % count : 0;
+
+        unsigned int expected[words] = {};
+        int expectedFirst = overlapScanScalar(boxX, boxY, boxes.x, boxes.y, 0, count, expected);
+        int expectedFrom = overlapScanScalar(boxX, boxY, boxes.x, boxes.y, from, count, nullptr);
+        for (int k = 0; k < OVERLAP_KERNEL_COUNT; k++) {
+            const OverlapKernel& kernel = OVERLAP_KERNELS[k];
+            if (!kernel.supported())
+                continue;
+            unsigned int mask[words] = {};
+            int first = kernel.scan(boxX, boxY, boxes.x, boxes.y, 0, count, mask);
+            if (first != expectedFirst || memcmp(mask, expected, sizeof(mask)) != 0 ||
+                kernel.scan(boxX, boxY, boxes.x, boxes.y, from, count, nullptr) != expectedFrom) {
+                if (mismatches++ < 10)
+                    cerr << kernel.name << " disagrees with scalar: trial " << trial << ", " << count << " boxes" << endl;
+            }
+        }
+        unsigned int mask[words];
+        int hits = overlapMask(boxX, boxY, boxes.x, boxes.y, count, mask);
+        int expectedHits = 0;
+        for (int w = 0; w < (count + 31) / 32; w++) {
+            expectedHits += __builtin_popcount(expected[w]);
+        }
+        if (hits != expectedHits || memcmp(mask, expected, (count + 31) / 32 * sizeof(unsigned int)) != 0) {
+            if (mismatches++ < 10)
+                cerr << "overlapMask disagrees with scalar: trial " << trial << ", " << count << " boxes" << endl;
+        }
+    }
+
+    // A field as full as it gets, spread over the whole screen
+    for (int i = 0; i < MAX_MUSHROOMS; i++) {
+        boxes.x[i] = toFixed(nextRandom(rng) % (resolutionX - boxPixelsX));
+        boxes.y[i] = toFixed(nextRandom(rng) % (resolutionY - boxPixelsY));
+    }
+    const int queries = 200000;
+    benchTitle("Overlap kernels: %d boxes, %d queries", MAX_MUSHROOMS, queries);
+    for (int k = 0; k < OVERLAP_KERNEL_COUNT; k++) {
+        const OverlapKernel& kernel = OVERLAP_KERNELS[k];
+        if (!kernel.supported())
+            continue;
+        int hits = 0;
+        sf::Clock benchClock;
+        for (int q = 0; q < queries; q++) {
+            Fixed boxX = toFixed(q % (resolutionX - boxPixelsX));
+            Fixed boxY = toFixed((q * 7) % (resolutionY - boxPixelsY));
+            hits += kernel.scan(boxX, boxY, boxes.x, boxes.y, 0, MAX_MUSHROOMS, nullptr) < MAX_MUSHROOMS;
+        }
+        float micros = benchClock.getElapsedTime().asMicroseconds();
+        string label = string(kernel.name) + (&kernel == &overlapKernel() ? " (in use)" : "");
+        benchLine(label.c_str(), "%g ns per query, %d hit something", 1000.0f * micros / queries, hits);
+    }
+    return benchVerdict(mismatches, "%d queries disagree with the scalar kernel", "every kernel agrees with the scalar one");
+}
+
+int runFieldBenchmark(const BenchOptions& options) {
+    // Draw fields in each style, from the usual count up to as many
+    // mushrooms as the world holds, check every one keeps the rules, then
+    // check a library hands out the same fields as drawing them afresh
+    int count = (int) options.amount;
+    FieldSpec specs[4] = {DEFAULT_FIELD_SPEC, DEFAULT_FIELD_SPEC, DEFAULT_FIELD_SPEC, DEFAULT_FIELD_SPEC};
+    const char* names[4] = {"spread", "uniform", "dense spread", "dense uniform"};
+    specs[1].spread = false;
+    specs[2].minMushrooms = specs[2].maxMushrooms = MAX_MUSHROOMS;
+    specs[3] = specs[2];
+    specs[3].spread = false;
+
+    benchTitle("Mushroom field benchmark: %d fields per style, %dx%d cells", count, FIELD_COLUMNS, FIELD_ROWS);
+    MushroomField field;
+    int broken = 0;
+    for (int s = 0; s < 4; s++) {
+        long long mushrooms = 0, perBand[FIELD_BANDS] = {};
+        int failed = 0;
+        sf::Clock benchClock;
+        for (int i = 0; i < count; i++) {
+            generateMushroomField(field, i + 1, specs[s]);
+            mushrooms += field.count;
+        }
+        float micros = benchClock.getElapsedTime().asMicroseconds();
+        for (int i = 0; i < count; i++) {
+            generateMushroomField(field, i + 1, specs[s]);
+            failed += checkMushroomField(field, specs[s]) > 0;
+            for (int m = 0; m < field.count; m++) {
+                int row = field.cells[m] / FIELD_COLUMNS;
+                int band = 0;
+                while (row >= FIELD_BAND_ROWS[band + 1])
+                    band++;
+                perBand[band]++;
+            }
+        }
+        broken += failed;
+        string bands;
+        for (int band = 0; band < FIELD_BANDS; band++) {
+            char mean[32];
+            snprintf(mean, sizeof(mean), "%s%g", band ? " / " : "", (float) perBand[band] / count);
+            bands += mean;
+        }
+        benchLine(names[s], "%g ns per field, %g mushrooms (%s by band), %d broke a rule",
+                  1000.0f * micros / count, (float) mushrooms / count, bands.c_str(), failed);
+    }
+
+    static FieldLibrary library;
+    sf::Clock libraryClock;
+    buildFieldLibrary(library, 1, DEFAULT_FIELD_SPEC);
+    float buildMicros = libraryClock.getElapsedTime().asMicroseconds();
+    int mismatches = 0;
+    for (unsigned int seed = 1; seed <= FIELD_LIBRARY_SIZE + 4; seed++) {
+        const MushroomField& stored = fieldForSeed(library, seed);
+        generateMushroomField(field, seed, DEFAULT_FIELD_SPEC);
+        mismatches += stored.rngState != field.rngState || stored.startRow != field.startRow || stored.count != field.count ||
+                      memcmp(stored.cells, field.cells, field.count * sizeof(field.cells[0])) != 0;
+    }
+    benchLine("library", "%d fields in %g us, %d bytes, %d differ from a fresh draw",
+              FIELD_LIBRARY_SIZE, buildMicros, (int) sizeof(FieldLibrary), mismatches);
+    return benchVerdict(broken + mismatches, "%d fields broke a rule or differ", "every field kept the rules");
+}
+
+int runFlowBenchmark(const BenchOptions& options) {
+    // Chase a wandering player with spiders over a field that loses
+    // mushrooms to shots and grows new ones, check the field after every
+    // update against one built from scratch, and time both halves
+    int count = (int) options.amount;
+    static GameWorld world; // Too big for the stack
+    initializeCrowdedWorld(world, 0, count, false);
+
+    unsigned int rng = 12345;
+    long long updates[3] = {}, flowMicros = 0, chaseMicros = 0;
+    int mismatches = 0;
+    long long startCost = 0, endCost = 0;
+    unsigned char input = 0;
+    sf::Clock benchClock;
+    for (int t = 0; t < BENCH_TICKS; t++) {
+        if (t % 60 == 0)
+            input = autopilotActionInput(nextRandom(rng) % 5);
+        movePlayer(world.player, input & INPUT_LEFT, input & INPUT_RIGHT, input & INPUT_UP, input & INPUT_DOWN, PLAYER_SPEED, world.mush, world.mushBoxes, world.nmush);
+        if (t % 8 == 0)
+            removeMushroom(world.mush, nextRandom(rng) % world.nmush, world.stats);
+        if (t % 97 == 0)
+            addMushroom(world.mush, world.mushBoxes, world.nmush, world.stats, toFixed(nextRandom(rng) % FLOW_COLUMNS * boxPixelsX),
+                        toFixed(nextRandom(rng) % (FLOW_ROWS - 1) * boxPixelsY), false);
+
+        benchClock.restart();
+        updates[updateFlowField(world.flow, world.player, world.mush, world.nmush)]++;
+        flowMicros += benchClock.getElapsedTime().asMicroseconds();
+        benchClock.restart();
+        updateEnemies(world.enemies, world.flow, world.mush, world.mushBoxes, world.nmush, world.stats, world.records);
+        chaseMicros += benchClock.getElapsedTime().asMicroseconds();
+        mismatches += !checkFlowField(world.flow);
+        if (t == 0 || t == BENCH_TICKS - 1) {
+            // How far the spiders are from the player, in path cost
+            long long total = 0;
+            for (int i = 0; i < world.enemies.count; i++) {
+                const Enemy& e = world.enemies.items[i];
+                int column = min(max(fixedCell(e.posX, boxPixelsX), 0), FLOW_COLUMNS - 1);
+                int row = min(max(fixedCell(e.posY, boxPixelsY), 0), FLOW_ROWS - 1);
+                total += world.flow.cost[row * FLOW_COLUMNS + column];
+            }
+            (t == 0 ? startCost : endCost) = total;
+        }
+    }
+
+    const int rebuilds = 1000;
+    benchClock.restart();
+    for (int i = 0; i < rebuilds; i++) {
+        rebuildFlowField(world.flow);
+    }
+    float rebuildMicros = (float) benchClock.getElapsedTime().asMicroseconds() / rebuilds;
+
+    int spiders = max(world.enemies.count, 1);
+    benchTitle("Flow field benchmark: %d spiders, %d ticks, %dx%d cells", count, BENCH_TICKS, FLOW_COLUMNS, FLOW_ROWS);
+    benchLine("updates", "%lld rebuilt, %lld repaired, %lld unchanged", updates[FLOW_REBUILT], updates[FLOW_REPAIRED], updates[FLOW_UNCHANGED]);
+    benchLine("field", "%g us per tick (%g us per full rebuild)", (float) flowMicros / BENCH_TICKS, rebuildMicros);
+    benchLine("chase", "%g us per tick, %g ns per spider", (float) chaseMicros / BENCH_TICKS, 1000.0f * chaseMicros / BENCH_TICKS / count);
+    benchLine("distance", "%g to %g mean path cost from a spider to the player", (float) startCost / spiders, (float) endCost / spiders);
+    return benchVerdict(mismatches, "%d updates left the field different from a fresh build", "every update matched a fresh build");
+}
+
+int runJobBenchmark(const BenchOptions& options) {
+    // A crowded world with a full bullet pool, stepped on one thread and on
+    // the job system side by side. The two copies must stay identical byte
+    // for byte.
+    const int enemies = 64;
+    JobSystem jobs;
+    jobsStart(jobs, options.game.simThreads == 1 ? 0 : options.game.simThreads);
+    static GameWorld serial, parallel; // Too big for the stack
+    initializeCrowdedWorld(serial, 60, enemies, true);
+    serial.player.lives = 1000000;
+    memcpy(&parallel, &serial, sizeof(GameWorld));
+
+    unsigned int rng = 12345;
+    long long serialMicros = 0, parallelMicros = 0;
+    int mismatches = 0;
+    for (int t = 0; t < BENCH_TICKS; t++) {
+        // Keep the bullet pool full, the same bullets in both worlds
+        while (serial.bullets.count < MAX_BULLETS) {
+            Fixed posX = toFixed(nextRandom(rng) % (resolutionX - boxPixelsX));
+            Fixed posY = toFixed(nextRandom(rng) % (resolutionY - boxPixelsY));
+            spawnBullet(serial.bullets, posX, posY);
+            spawnBullet(parallel.bullets, posX, posY);
+        }
+        unsigned char input = (t / 120 % 2 ? INPUT_LEFT : INPUT_RIGHT);
+        sf::Clock serialClock;
+        stepWorld(serial, input, nullptr);
+        serialMicros += serialClock.getElapsedTime().asMicroseconds();
+        sf::Clock parallelClock;
+        stepWorld(parallel, input, &jobs);
+        parallelMicros += parallelClock.getElapsedTime().asMicroseconds();
+        if (memcmp(&serial, &parallel, sizeof(GameWorld)) != 0 && mismatches++ == 0)
+            cerr << "Worlds differ after tick " << t << endl;
+    }
+
+    benchTitle("Job benchmark: %d ticks, %d bullets, %d enemies, %d threads", BENCH_TICKS, MAX_BULLETS, enemies, jobs.threads);
+    benchLine("one thread", "%g us per tick", (float) serialMicros / BENCH_TICKS);
+    benchLine("job system", "%g us per tick, %lld jobs and %lld steals per tick", (float) parallelMicros / BENCH_TICKS,
+              (long long) jobs.jobsRun.load() / BENCH_TICKS, (long long) jobs.steals.load() / BENCH_TICKS);
+    jobsStop(jobs);
+    return benchVerdict(mismatches, "worlds: %d ticks differ", "worlds: identical");
+}
+
+int runRenderCheck(const BenchOptions&) {
+    // Draw fixed scenes into an offscreen target and hold them to their budgets
+    HeadlessScene scene;
+    if (!initializeScene(scene))
+        return 1;
+    Canvas canvas(scene.target);
+    bool ok = true;
+
+    // The menu is a fixed handful of texts
+    vector<string> menuOptions = {"Play Game", "Instructions", "High Scores", "Exit"};
+    beginRenderFrame(canvas);
+    canvas.subsystem = STATS_MENU;
+    drawMenu(canvas, *scene.font, menuOptions, 0);
+    ok &= checkRenderBudget("menu", canvas, STATS_MENU, 2 + menuOptions.size(), 6000);
+
+    // A fresh field and one deep into a rapid-fire game: at most one sprite per
+    // entity, all particles in one draw, and a fixed HUD
+    static GameWorld world, busy; // Too big for the stack
+    initializeGame(world, 1, 0);
+    initializeGame(busy, 1, SIM_TICKS_PER_SECOND);
+    for (int tick = 0; tick < 20 * SIM_TICKS_PER_SECOND; tick++) {
+        stepWorld(busy, (tick / 120 % 2 ? INPUT_LEFT : INPUT_RIGHT) | INPUT_FIRE, nullptr);
+        emitWorldBursts(scene.particles, busy);
+        if (busy.player.lives <= 0)
+            break;
+    }
+    for (int i = 0; i < 40; i++)
+        emitBurst(scene.particles, resolutionX / 2, resolutionY / 2, BURST_DEATH);
+
+    GameWorld* worlds[2] = {&world, &busy};
+    const char* names[2] = {"new game", "rapid fire"};
+    for (int w = 0; w < 2; w++) {
+        beginRenderFrame(canvas);
+        canvas.subsystem = STATS_WORLD;
+        drawWorld(canvas, *worlds[w], scene.sprites, *scene.mushTexture, 0.0f);
+        canvas.subsystem = STATS_PARTICLES;
+        drawParticles(canvas, scene.particles, scene.particleTexture);
+        canvas.subsystem = STATS_HUD;
+        drawHUD(canvas, scene.hud, worlds[w]->player, worlds[w]->level);
+
+        int entities = countDrawnEntities(*worlds[w]);
+        ok &= checkRenderBudget(names[w], canvas, STATS_WORLD, entities, 4LL * entities);
+        ok &= checkRenderBudget(names[w], canvas, STATS_PARTICLES, scene.particles.count > 0 ? 1 : 0, 4LL * MAX_PARTICLES);
+        ok &= checkRenderBudget(names[w], canvas, STATS_HUD, 3, 6 * 3 * 16);
+    }
+
+    cout << (ok ? "Render budgets met" : "Render budgets exceeded") << endl;
+    return ok ? 0 : 1;
+}
+
+int runAllocCheck(const BenchOptions& options) {
+    // The render check's scripted player, with the rewind capture, particles
+    // and HUD a frame in play has around it. Once warmed up, no frame may
+    // allocate.
+    HeadlessScene scene;
+    if (!initializeScene(scene))
+        return 1;
+    Canvas canvas(scene.target);
+    RewindBuffer rewind;
+    rewindInit(rewind, options.game.rewindBudgetMB);
+    JobSystem jobs;
+    jobsStart(jobs, options.game.simThreads);
+    AllocStats stats;
+
+    static GameWorld world; // Too big for the stack
+    unsigned int seed = 1;
+    initializeGame(world, seed, SIM_TICKS_PER_SECOND);
+    rewindReset(rewind, world);
+    static NetSession net; // Only its remote world and counters are drawn
+    initializeGame(net.remoteWorld, seed, SIM_TICKS_PER_SECOND);
+    const int ticksPerFrame = SIM_TICKS_PER_SECOND / CAPTURE_FPS;
+    const float frameTime = 1.0f / CAPTURE_FPS;
+    int frames = (int) (ALLOC_CHECK_SECONDS * CAPTURE_FPS);
+    long long allocated = 0;
+    int failedFrames = 0;
+    int firstFailed = -1;
+    for (int frame = 0; frame < frames; frame++) {
+        if (frame == ALLOC_WARMUP_FRAMES) {
+            resetAllocSites();
+        }
+        allocFrameBegin(stats, PLAYING);
+        if (world.player.lives <= 0) {
+            // Start the next game straight away, as the demo would
+            initializeGame(world, ++seed, SIM_TICKS_PER_SECOND);
+            rewindReset(rewind, world);
+        }
+        {
+            AllocScope scope("simulation");
+            for (int i = 0; i < ticksPerFrame; i++) {
+                int tick = frame * ticksPerFrame + i;
+                stepWorld(world, (tick / 120 % 2 ? INPUT_LEFT : INPUT_RIGHT) | INPUT_FIRE, &jobs);
+                rewindCapture(rewind, world);
+                emitWorldBursts(scene.particles, world);
+            }
+        }
+        scene.target.clear(sf::Color(0, 0, 0));
+        beginRenderFrame(canvas);
+        {
+            AllocScope scope("world");
+            canvas.subsystem = STATS_WORLD;
+            drawWorld(canvas, world, scene.sprites, *scene.mushTexture, frameTime);
+        }
+        {
+            AllocScope scope("particles");
+            updateParticles(scene.particles, frameTime);
+            canvas.subsystem = STATS_PARTICLES;
+            drawParticles(canvas, scene.particles, scene.particleTexture);
+        }
+        {
+            AllocScope scope("hud");
+            canvas.subsystem = STATS_HUD;
+            drawHUD(canvas, scene.hud, world.player, world.level);
+        }
+        {
+            // The overlays a game in play can show: a quick save message now
+            // and then, and the netplay inset with its counters changing
+            AllocScope scope("overlay");
+            canvas.subsystem = STATS_OVERLAY;
+            if (frame % CAPTURE_FPS == 0) {
+                char message[HUD_LINE_LENGTH];
+                snprintf(message, sizeof(message), "Quick saved in %d us", frame);
+                showHudMessage(scene.hud, message);
+            }
+            net.rollbacks = frame;
+            net.lastRollbackMicros = frame % 97;
+            drawNetplayStatus(canvas, scene.hud, net, scene.sprites, *scene.mushTexture);
+            drawHudMessage(canvas, scene.hud);
+        }
+        scene.target.display();
+        long long allocations = allocFrameEnd(stats);
+        if (frame >= ALLOC_WARMUP_FRAMES && allocations > 0) {
+            if (failedFrames == 0)
+                firstFailed = frame;
+            failedFrames++;
+            allocated += allocations;
+        }
+    }
+    jobsStop(jobs);
+
+    benchTitle("Allocation check: %d frames in play, %u games, the first %d frames to warm up", frames, seed, ALLOC_WARMUP_FRAMES);
+    if (failedFrames == 0) {
+        cout << "No allocations after warm-up" << endl;
+        return 0;
+    }
+    cout << failedFrames << " frames allocated after warm-up, " << allocated << " times, the first at frame " << firstFailed << endl;
+    printAllocSites();
+    return 1;
+}
+
+int runCaptureDemo(const BenchOptions& options) {
+    // Play the scripted demo and record it frame by frame. The world, inputs
+    // and frame times are all fixed, so every run writes the same images,
+    // ready to be kept as golden frames and compared against later.
+    HeadlessScene scene;
+    if (!initializeScene(scene))
+        return 1;
+    Canvas canvas(scene.target);
+    VideoCapture capture;
+    if (options.game.recordPath.empty() || !captureStart(capture, scene.target, options.game.recordPath, options.game.recordEvery)) {
+        cerr << "record-demo needs a path to --record to" << endl;
+        return 1;
+    }
+
+    // The same scripted player the render check uses, drawn at 60 frames a second
+    static GameWorld world; // Too big for the stack
+    initializeGame(world, 1, SIM_TICKS_PER_SECOND);
+    const int ticksPerFrame = SIM_TICKS_PER_SECOND / CAPTURE_FPS;
+    const float frameTime = 1.0f / CAPTURE_FPS;
+    int frames = (int) (options.amount * CAPTURE_FPS);
+    for (int frame = 0; frame < frames && world.player.lives > 0; frame++) {
+        for (int i = 0; i < ticksPerFrame; i++) {
+            int tick = frame * ticksPerFrame + i;
+            stepWorld(world, (tick / 120 % 2 ? INPUT_LEFT : INPUT_RIGHT) | INPUT_FIRE, nullptr);
+            emitWorldBursts(scene.particles, world);
+        }
+        scene.target.clear(sf::Color(0, 0, 0));
+        beginRenderFrame(canvas);
+        canvas.subsystem = STATS_WORLD;
+        drawWorld(canvas, world, scene.sprites, *scene.mushTexture, frameTime);
+        updateParticles(scene.particles, frameTime);
+        canvas.subsystem = STATS_PARTICLES;
+        drawParticles(canvas, scene.particles, scene.particleTexture);
+        canvas.subsystem = STATS_HUD;
+        drawHUD(canvas, scene.hud, world.player, world.level);
+        scene.target.display();
+        captureFrame(capture, scene.target, resolutionX);
+    }
+    captureStop(capture, scene.target);
+    return capture.dropped + capture.skipped > 0 ? 1 : 0;
+}
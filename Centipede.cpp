@@ -1,1323 +1,6433 @@
-#include <iostream>
-#include <SFML/Graphics.hpp>
-#include <SFML/Audio.hpp>
-#include <fstream>
-#include <sstream>
-#include <vector>
-#include <algorithm>
-
-using namespace std;
-
-// Game states
-enum GameState {
-    MENU,
-    PLAYING,
-    PAUSED,
-    GAME_OVER,
-    INSTRUCTIONS,
-    HIGH_SCORES
-};
-
-// Initializing Dimensions.
-const int resolutionX = 960;
-const int resolutionY = 960;
-const int boxPixelsX = 32;
-const int boxPixelsY = 32;
-const int gameRows = resolutionX / boxPixelsX; // Total rows on grid
-const int gameColumns = resolutionY / boxPixelsY; // Total columns on grid
-
-// Initializing GameGrid.
-int gameGrid[gameRows][gameColumns] = {};
-
-// The following exist purely for readability.
-const int x = 0;
-const int y = 1;
-const int exists = 2;
-
-// Constants for animations
-const float ANIMATION_FRAME_TIME = 0.1f; // Time to switch animation frames (seconds)
-
-// Structure for animations
-struct Animation {
-    int currentFrame = 0;
-    int totalFrames = 0;
-    float elapsedTime = 0.0f;
-    bool isPlaying = false;
-};
-
-// Structure for player data
-struct PlayerData {
-    float position[2]; // x, y
-    Animation animation;
-    int lives;
-    int score;
-    string name;
-    bool isMoving;
-    bool isInvulnerable;
-    float invulnerabilityTime;
-};
-
-// Structure for high score entries
-struct HighScoreEntry {
-  string name;
-  int score;
-  
-  // Default constructor
-  HighScoreEntry() : name(""), score(0) {}
-  
-  // Constructor for convenience
-  HighScoreEntry(string n, int s) : name(n), score(s) {}
-  
-  // Operator for sorting
-  bool operator<(const HighScoreEntry& other) const {
-    return score > other.score; // Sort in descending order
-  }
-};
-
-// Global variables for high scores
-vector<HighScoreEntry> highScores;
-const string HIGH_SCORE_FILE = "high_scores.txt";
-const int MAX_HIGH_SCORES = 10;
-
-/////////////////////////////////////////////////////////////////////////////
-//                                                                         //
-// Function declarations                                                   //
-//                                                                         //
-/////////////////////////////////////////////////////////////////////////////
-
-// Helper functions
-void initializeGame(PlayerData& player, float centipede[][10], float centipedeheads[][10], float mush[][6], int& nmush, 
-                   float& flea, float spider[], float scorpion[], int& centipedeLength, int& level, int& heads);
-void loadHighScores();
-void saveHighScores(const string& playerName, int score);
-void checkForHighScore(PlayerData& player);
-
-// Menu functions
-void handleMenuInput(GameState& gameState, sf::RenderWindow& window);
-void drawMenu(sf::RenderWindow& window, sf::Font& font, const vector<string>& menuOptions, int selectedOption);
-void drawInstructions(sf::RenderWindow& window, sf::Font& font);
-void drawHighScores(sf::RenderWindow& window, sf::Font& font);
-void drawGameOver(sf::RenderWindow& window, sf::Font& font, PlayerData& player);
-void drawPauseMenu(sf::RenderWindow& window, sf::Font& font);
-
-// Animation functions
-void updateAnimation(Animation& anim, float deltaTime);
-void setupAnimations(PlayerData& player);
-
-// Gameplay functions
-void drawPlayer(sf::RenderWindow& window, PlayerData& player, sf::Sprite& playerSprite, float deltaTime);
-void moveBullet(float bullet[], sf::Clock& bulletClock);
-void drawBullet(sf::RenderWindow& window, float bullet[], sf::Sprite& bulletSprite, float mush[][6], int nmush, int& score);
-void movePlayer(PlayerData& player, bool moveLeft, bool moveRight, bool moveUp, bool moveDown, float playerSpeed, float mush[][6], int nmush, float deltaTime);
-void mushrooms(sf::RenderWindow& window, float mush[][6], sf::Sprite& mushSprite, sf::Texture& mushTexture, int nmush);
-void moveCentipede(int centipedeLength, float centipede[][10], float mush[][6], int nmush, sf::RenderWindow& window, sf::Sprite& centipedeSprite, sf::Sprite& cheadSprite, float deltaTime);
-void drawCentipede(sf::RenderWindow& window, sf::Sprite& centipedeSprite, sf::Sprite& cheadSprite, int centipedeLength, float centipede[][10], int i, float deltaTime);
-bool mushroomxcentipede(int centipedeLength, float centipede[][10], float mush[][6], int nmush, int i);
-void bulletxcentipede(int centipedeLength, float centipede[][10], float bullet[3], float mush[][6], int& nmush, sf::Sound& killSound, int& score, int level);
-void MakingHeads(int& h, float centipedeheads[][10], float centipede[][10], sf::Clock& headClock, float mush[][6], int nmush, sf::RenderWindow& window, sf::Sprite& cheadSprite, float deltaTime);
-void bulletxhead(int& h, float centipedeheads[][10], float bullet[3], float mush[][6], int& nmush, sf::Sound& killSound, int& score);
-void isPlayerhit(PlayerData& player, float centipede[][10], int centipedeLength, float mush[][6], int& nmush, float centipedeheads[][10], sf::Sound& hitSound);
-void FleasDrop(float flea[5], float mush[][6], int& nmush, sf::RenderWindow& window, sf::Sprite& fleaSprite, float deltaTime);
-void moveSpider(float spider[5], float mush[][6], int& nmush, sf::RenderWindow& window, sf::Sprite& spiderSprite, PlayerData& player, float bullet[3], sf::Sound& hitSound, float deltaTime);
-void moveScorpion(float scorpion[5], float mush[][6], int& nmush, sf::RenderWindow& window, sf::Sprite& scorpionSprite, PlayerData& player, float bullet[3], float deltaTime);
-void nextLevel(int& centipedeLength, float centipede[][10], float mush[][6], int nmush, float flea[5], float spider[5], float scorpion[5], int& score, 
-              int startColumn, int startRow, int& level, float centipedeheads[][10], sf::Sound& levelupSound);
-void createParticleEffect(sf::RenderWindow& window, float posX, float posY, sf::Color color);
-void drawHUD(sf::RenderWindow& window, sf::Font& font, PlayerData& player, int level);
-
-int main() {
-    // Set random seed
-    srand(time(0));
-    
-    // Initialize game state
-    GameState gameState = MENU;
-    
-    // Declaring RenderWindow.
-    sf::RenderWindow window(sf::VideoMode(resolutionX, resolutionY), "Centipede", sf::Style::Close | sf::Style::Titlebar);
-    window.setSize(sf::Vector2u(640, 640)); // Recommended for 1366x768 (768p) displays.
-    window.setPosition(sf::Vector2i(100, 0));
-    
-    // Clock for timing
-    sf::Clock gameClock;
-    float deltaTime;
-    
-    // Initializing Background Music.
-    sf::Music bgMusic;
-    sf::Music menuMusic;
-    bgMusic.openFromFile("Music/field_of_hopes.ogg");
-    menuMusic.openFromFile("Music/field_of_hopes.ogg");
-    menuMusic.setLoop(true);
-    bgMusic.setLoop(true);
-    menuMusic.setVolume(50);
-    bgMusic.setVolume(40);
-    menuMusic.play();
-    
-    // Sound effects
-    sf::SoundBuffer bulletSoundBuffer;
-    sf::Sound bulletSound;
-    bulletSoundBuffer.loadFromFile("Sound Effects/fire1.wav");
-    bulletSound.setBuffer(bulletSoundBuffer);
-    
-    sf::SoundBuffer playerdiedBuffer;
-    sf::Sound playerdiedSound;
-    playerdiedBuffer.loadFromFile("Sound Effects/death.wav");
-    playerdiedSound.setBuffer(playerdiedBuffer);
-    
-    sf::SoundBuffer killBuffer;
-    sf::Sound killSound;
-    killBuffer.loadFromFile("Sound Effects/death.wav");
-    killSound.setBuffer(killBuffer);
-    
-    sf::SoundBuffer levelupBuffer;
-    sf::Sound levelupSound;
-    levelupBuffer.loadFromFile("Sound Effects/1up.wav");
-    levelupSound.setBuffer(levelupBuffer);
-    
-    sf::SoundBuffer hitBuffer;
-    sf::Sound hitSound;
-    hitBuffer.loadFromFile("Sound Effects/kill.wav");
-    hitSound.setBuffer(hitBuffer);
-    
-    sf::SoundBuffer menuSelectBuffer;
-    sf::Sound menuSelectSound;
-    menuSelectBuffer.loadFromFile("Sound Effects/newBeat.wav");
-    menuSelectSound.setBuffer(menuSelectBuffer);
-    
-    // Initializing Background.
-    sf::Texture backgroundTexture;
-    sf::Sprite backgroundSprite;
-    backgroundTexture.loadFromFile("Textures/orange_forest.png");
-    backgroundSprite.setTexture(backgroundTexture);
-    backgroundSprite.setColor(sf::Color(255, 255, 255, 255 * 0.20)); // Reduces Opacity to 20%
-    
-    // Menu background
-    sf::Texture menuBackgroundTexture;
-    sf::Sprite menuBackgroundSprite;
-    menuBackgroundTexture.loadFromFile("Textures/menu_background.png");
-    menuBackgroundSprite.setTexture(menuBackgroundTexture);
-    
-    // Menu options
-    vector<string> menuOptions = {"Play Game", "Instructions", "High Scores", "Exit"};
-    int selectedOption = 0;
-    
-    // Font loading
-    sf::Font font;
-    font.loadFromFile("/usr/share/fonts/truetype/freefont/FreeMonoBold.ttf");
-    
-    // Load high scores
-    loadHighScores();
-    
-    // Initializing Player data
-    PlayerData player;
-    player.position[x] = (gameColumns / 2) * boxPixelsX;
-    player.position[y] = (gameColumns) * boxPixelsY;
-    player.animation.totalFrames = 4;
-    player.lives = 3;
-    player.score = 0;
-    player.isInvulnerable = false;
-    player.invulnerabilityTime = 0.0f;
-    player.name = "Player";
-    
-    sf::Texture playerTexture;
-    sf::Sprite playerSprite;
-    playerTexture.loadFromFile("Textures/player.png");
-    playerSprite.setTexture(playerTexture);
-    playerSprite.setTextureRect(sf::IntRect(0, 0, boxPixelsX, boxPixelsY));
-    const float playerSpeed = 200.0f; // Pixels per second
-    
-    int startRow = rand() % 10; // Random starting row top 10 of centipede
-    int level = 1;
-    
-    // Initializing mushroom and mushroom Sprites.
-    float mush[50][6] = {0};
-    sf::Texture mushTexture;
-    sf::Sprite mushSprite;
-    mushTexture.loadFromFile("Textures/mushroom.png");
-    mushSprite.setTexture(mushTexture);
-    
-    int nmush = (rand() % 11 + 20);
-    for (int i = 0; i < nmush; i++) {
-        mush[i][2] = 0; // Hit counter
-        mush[i][3] = false; // No mushrooms exist
-        mush[i][4] = false; // mush eat
-        mush[i][5] = false; // poisonous?
-    }
-    
-    // Initializing Bullet and Bullet Sprites.
-    float bullet[3] = {};
-    bullet[x] = player.position[x];
-    bullet[y] = player.position[y] - boxPixelsY;
-    bullet[exists] = false;
-    sf::Clock bulletClock;
-    sf::Texture bulletTexture;
-    sf::Sprite bulletSprite;
-    bulletTexture.loadFromFile("Textures/bullet.png");
-    bulletSprite.setTexture(bulletTexture);
-    
-    // Initialize Centipede
-    sf::Clock headClock;
-    sf::Texture centipedeTexture;
-    sf::Sprite centipedeSprite;
-    centipedeTexture.loadFromFile("Textures/c_body_left_walk.png");
-    centipedeSprite.setTexture(centipedeTexture);
-    sf::Texture cheadTexture;
-    sf::Sprite cheadSprite;
-    cheadTexture.loadFromFile("Textures/c_head_left_walk.png");
-    cheadSprite.setTexture(cheadTexture);
-    int centipedeLength = 12;
-    float centipede[12][10] = {0};
-    int startColumn = gameColumns - centipedeLength;
-    
-    // Centipede heads array
-    float centipedeheads[12][10] = {0};
-    int heads = 0;
-    
-    // Initialize enemies
-    // Fleas
-    sf::Texture fleaTexture;
-    sf::Sprite fleaSprite;
-    fleaTexture.loadFromFile("Textures/flea.png");
-    fleaSprite.setTexture(fleaTexture);
-    float flea[5] = {0};
-    flea[x] = 15 * boxPixelsX;
-    flea[y] = 0;
-    flea[2] = false; // doesn't exist yet
-    
-    // Spider
-    sf::Texture spiderTexture;
-    sf::Sprite spiderSprite;
-    spiderTexture.loadFromFile("Textures/spider_and_score.png");
-    spiderSprite.setTexture(spiderTexture);
-    float spider[5] = {0};
-    spider[x] = 0;
-    spider[y] = 20 * boxPixelsY;
-    spider[2] = true; // exists
-    spider[3] = true; // direction right
-    spider[4] = true; // direction down
-    
-    // Scorpion
-    sf::Texture scorpionTexture;
-    sf::Sprite scorpionSprite;
-    scorpionTexture.loadFromFile("Textures/scorpion.png");
-    scorpionSprite.setTexture(scorpionTexture);
-    float scorpion[5] = {0};
-    scorpion[x] = 0;
-    scorpion[y] = 26 * boxPixelsY;
-    scorpion[2] = true; // exists
-    scorpion[3] = true; // direction right
-    
-    // Particle effect texture
-    sf::Texture particleTexture;
-    particleTexture.loadFromFile("Textures/bullet.png");
-    
-    // Game initialization function (populates mushrooms, sets up centipede, etc.)
-    initializeGame(player, centipede, centipedeheads, mush, nmush, *flea, spider, scorpion, centipedeLength, level, heads);
-    
-    // Main game loop
-    while (window.isOpen()) {
-        // Calculate delta time
-        deltaTime = gameClock.restart().asSeconds();
-        
-        // Handle events
-        sf::Event e;
-        while (window.pollEvent(e)) {
-            if (e.type == sf::Event::Closed) {
-                window.close();
-                return 0;
-            }
-            
-            // Handle key presses
-            if (e.type == sf::Event::KeyPressed) {
-                if (gameState == MENU) {
-                    // Menu controls
-                    if (e.key.code == sf::Keyboard::Up) {
-                        selectedOption = (selectedOption - 1 + menuOptions.size()) % menuOptions.size();
-                        menuSelectSound.play();
-                    }
-                    else if (e.key.code == sf::Keyboard::Down) {
-                        selectedOption = (selectedOption + 1) % menuOptions.size();
-                        menuSelectSound.play();
-                    }
-                    else if (e.key.code == sf::Keyboard::Return) {
-                        menuSelectSound.play();
-                        switch (selectedOption) {
-                            case 0: // Play
-                                gameState = PLAYING;
-                                menuMusic.stop();
-                                bgMusic.play();
-                                // Reset game state for a new game
-                                initializeGame(player, centipede, centipedeheads, mush, nmush, *flea, spider, scorpion, centipedeLength, level, heads);
-                                break;
-                            case 1: // Instructions
-                                gameState = INSTRUCTIONS;
-                                break;
-                            case 2: // High Scores
-                                gameState = HIGH_SCORES;
-                                break;
-                            case 3: // Exit
-                                window.close();
-                                return 0;
-                        }
-                    }
-                }
-                else if (gameState == PLAYING) {
-                    // In-game controls
-                    if (e.key.code == sf::Keyboard::Space) {
-                        // Only fire a new bullet if one does not exist
-                        if (!bullet[exists]) {
-                            bullet[x] = player.position[x] + boxPixelsX/2 - 4; // Center the bullet
-                            bullet[y] = player.position[y] - boxPixelsY/2;
-                            bullet[exists] = true;
-                            bulletSound.play();
-                        }
-                    }
-                    else if (e.key.code == sf::Keyboard::Escape) {
-                        gameState = PAUSED;
-                        bgMusic.pause();
-                    }
-                    else if (e.key.code == sf::Keyboard::P) {
-                        gameState = PAUSED;
-                        bgMusic.pause();
-                    }
-                }
-                else if (gameState == PAUSED) {
-                    if (e.key.code == sf::Keyboard::Escape || e.key.code == sf::Keyboard::P) {
-                        gameState = PLAYING;
-                        bgMusic.play();
-                    }
-                }
-                else if (gameState == GAME_OVER || gameState == INSTRUCTIONS || gameState == HIGH_SCORES) {
-                    if (e.key.code == sf::Keyboard::Escape) {
-                        gameState = MENU;
-                        if (!menuMusic.getStatus()) {
-                            bgMusic.stop();
-                            menuMusic.play();
-                        }
-                    }
-                    else if (e.key.code == sf::Keyboard::Return && gameState == GAME_OVER) {
-                        // Check for high score and save if needed
-                        checkForHighScore(player);
-                        gameState = MENU;
-                        if (!menuMusic.getStatus()) {
-                            bgMusic.stop();
-                            menuMusic.play();
-                        }
-                    }
-                }
-            }
-        }
-        
-        // Clear the window
-        window.clear(sf::Color(0, 0, 0));
-        
-        // Game state machine
-        switch (gameState) {
-            case MENU:
-                window.draw(menuBackgroundSprite);
-                drawMenu(window, font, menuOptions, selectedOption);
-                break;
-                
-            case PLAYING: {
-                // Draw background
-                window.draw(backgroundSprite);
-                
-                // Check if player is still alive
-                if (player.lives <= 0) {
-                    gameState = GAME_OVER;
-                    playerdiedSound.play();
-                    break;
-                }
-                
-                // Process player movement
-                bool moveLeft = false;
-                bool moveRight = false;
-                bool moveUp = false;
-                bool moveDown = false;
-                                
-                if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))
-                    moveLeft = true;
-                if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right))
-                    moveRight = true;
-                if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))
-                    moveUp = true;
-                if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down))
-                    moveDown = true;
-                
-                // Update invulnerability timer
-                if (player.isInvulnerable) {
-                    player.invulnerabilityTime -= deltaTime;
-                    if (player.invulnerabilityTime <= 0) {
-                        player.isInvulnerable = false;
-                    }
-                }
-                
-                // Update game elements
-                movePlayer(player, moveLeft, moveRight, moveUp, moveDown, playerSpeed, mush, nmush, deltaTime);
-                bulletxcentipede(centipedeLength, centipede, bullet, mush, nmush, killSound, player.score, level);
-                moveCentipede(centipedeLength, centipede, mush, nmush, window, centipedeSprite, cheadSprite, deltaTime);
-                MakingHeads(heads, centipedeheads, centipede, headClock, mush, nmush, window, cheadSprite, deltaTime);
-                bulletxhead(heads, centipedeheads, bullet, mush, nmush, killSound, player.score);
-                FleasDrop(flea, mush, nmush, window, fleaSprite, deltaTime);
-                moveSpider(spider, mush, nmush, window, spiderSprite, player, bullet, hitSound, deltaTime);
-                moveScorpion(scorpion, mush, nmush, window, scorpionSprite, player, bullet, deltaTime);
-                mushrooms(window, mush, mushSprite, mushTexture, nmush);
-                
-                if (bullet[exists]) {
-                    moveBullet(bullet, bulletClock);
-                    drawBullet(window, bullet, bulletSprite, mush, nmush, player.score);
-                }
-                
-                // Draw player
-                drawPlayer(window, player, playerSprite, deltaTime);
-                
-                // Check for collision with enemies
-                if (!player.isInvulnerable) {
-                    isPlayerhit(player, centipede, centipedeLength, mush, nmush, centipedeheads, hitSound);
-                }
-                
-                // Check for next level
-                nextLevel(centipedeLength, centipede, mush, nmush, flea, spider, scorpion, player.score, 
-                         startColumn, startRow, level, centipedeheads, levelupSound);
-                
-                // Award extra lives at certain score thresholds
-                static int lastLifeScore = 0;
-                if (player.score >= 10000 && lastLifeScore < 10000 ||
-                    player.score >= 20000 && lastLifeScore < 20000 ||
-                    player.score >= 50000 && lastLifeScore < 50000) {
-                    player.lives++;
-                    levelupSound.play();
-                    lastLifeScore = player.score;
-                }
-                
-                // Cap maximum lives at 6
-                if (player.lives > 6) {
-                    player.lives = 6;
-                }
-                
-                // Cap maximum score
-                if (player.score > 999999) {
-                    player.score = 999999;
-                }
-                
-                // Draw HUD last to be on top
-                drawHUD(window, font, player, level);
-                break;
-            }
-                
-            case PAUSED: {
-                // Draw paused game state
-                window.draw(backgroundSprite);
-                drawPauseMenu(window, font);
-                break;
-            }
-                
-            case GAME_OVER: {
-                // Draw game over screen
-                drawGameOver(window, font, player);
-                break;
-            }
-                
-            case INSTRUCTIONS: {
-                // Draw instructions screen
-                drawInstructions(window, font);
-                break;
-            }
-                
-            case HIGH_SCORES: {
-                // Draw high scores screen
-                drawHighScores(window, font);
-                break;
-            }
-        }
-        
-        // Display the window
-        window.display();
-    }
-    
-    return 0;
-}
-
-//////////////////////////////////////////////////////////////////////////////
-//                                                                          //
-// Function implementations                                                 //
-//                                                                          //
-//////////////////////////////////////////////////////////////////////////////
-
-// Helper functions
-void initializeGame(PlayerData& player, float centipede[][10], float centipedeheads[][10], float mush[][6], int& nmush, 
-                   float& flea, float spider[], float scorpion[], int& centipedeLength, int& level, int& heads) {
-    // Reset player
-    player.position[x] = (gameColumns / 2) * boxPixelsX;
-    player.position[y] = (gameColumns - 1) * boxPixelsY;
-    player.lives = 3;
-    player.score = 0;
-    player.isInvulnerable = false;
-    
-    // Reset level
-    level = 1;
-    
-    // Reset mushrooms
-    nmush = (rand() % 11 + 20);
-    for (int i = 0; i < 50; i++) {
-        mush[i][2] = 0; // Hit counter
-        mush[i][3] = false; // No mushrooms exist
-        mush[i][4] = false; // mush eat
-        mush[i][5] = false; // poisonous?
-    }
-    
-    int startRow = rand() % 10; // Random starting row
-    
-    // Create random mushrooms
-    for (int i = 0; i < nmush; i++) {
-        mush[i][0] = rand() % (resolutionX - boxPixelsX);
-        do {
-            mush[i][1] = rand() % (resolutionY - 3 * boxPixelsY);
-        } while ((int)mush[i][1] / boxPixelsY == startRow || 
-                 (int)mush[i][1] / boxPixelsY == startRow + 1 || 
-                 (int)mush[i][1] / boxPixelsY == startRow - 1);
-        mush[i][3] = true; // Mushroom exists
-    }
-    
-    // Reset centipede
-    for (int i = 0; i < centipedeLength; i++) {
-        centipede[i][2] = false; // head exists or no
-        centipede[i][3] = true; // direction left?
-        centipede[i][4] = true; // segment exists?
-    }
-    centipede[0][2] = true; // first segment is head
-    
-    // Position centipede
-    int startColumn = gameColumns - centipedeLength;
-    for (int i = 0; i < centipedeLength; i++) {
-        centipede[i][x] = (startColumn + i) * boxPixelsX;
-        centipede[i][y] = startRow * boxPixelsY;
-    }
-    
-    // Reset centipede heads
-    heads = 0;
-    for (int p = 0; p < 12; p++) {
-        centipedeheads[p][x] = (gameColumns - 1) * boxPixelsX;
-        centipedeheads[p][y] = (gameRows - 3) * boxPixelsX;
-        centipedeheads[p][2] = false; // head doesn't exist
-        centipedeheads[p][3] = true; // direction left
-    }
-    
-    // Reset flea
-    flea = 0;
-    flea = 15 * boxPixelsX;
-    (&flea)[1] = 0;
-    (&flea)[2] = false; // doesn't exist yet
-    
-    // Reset spider
-    spider[x] = 0;
-    spider[y] = 20 * boxPixelsY;
-    spider[2] = true; // exists
-    spider[3] = true; // direction right
-    spider[4] = true; // direction down
-    
-    // Reset scorpion
-    scorpion[x] = 0;
-    scorpion[y] = 26 * boxPixelsY;
-    scorpion[2] = true; // exists
-    scorpion[3] = true; // direction right
-}
-
-void loadHighScores() {
-    highScores.clear();
-    ifstream file(HIGH_SCORE_FILE);
-    if (file.is_open()) {
-        string line;
-        while (getline(file, line)) {
-            stringstream ss(line);
-            string name;
-            int score;
-            ss >> name >> score;
-            highScores.push_back(HighScoreEntry(name, score));
-        }
-        file.close();
-        
-        // Sort high scores
-        sort(highScores.begin(), highScores.end());
-        
-        // Truncate to maximum number of scores if needed
-        if (highScores.size() > MAX_HIGH_SCORES) {
-            highScores.resize(MAX_HIGH_SCORES);
-        }
-    }
-}
-
-void saveHighScores(const string& playerName, int score) {
-    // Add new score
-    highScores.push_back(HighScoreEntry(playerName, score));
-    
-    // Sort scores
-    sort(highScores.begin(), highScores.end());
-    
-    // Truncate to maximum
-    if (highScores.size() > MAX_HIGH_SCORES) {
-        highScores.resize(MAX_HIGH_SCORES);
-    }
-    
-    // Save to file
-    ofstream file(HIGH_SCORE_FILE);
-    if (file.is_open()) {
-        for (const auto& entry : highScores) {
-            file << entry.name << " " << entry.score << endl;
-        }
-        file.close();
-    }
-}
-
-void checkForHighScore(PlayerData& player) {
-    // Check if score qualifies for high score
-    if (highScores.size() < MAX_HIGH_SCORES || player.score > highScores.back().score) {
-        saveHighScores(player.name, player.score);
-    }
-}
-
-// Menu functions
-void drawMenu(sf::RenderWindow& window, sf::Font& font, const vector<string>& menuOptions, int selectedOption) {
-    // Draw title
-    sf::Text titleText("CENTIPEDE", font, 60);
-    titleText.setStyle(sf::Text::Bold);
-    titleText.setFillColor(sf::Color::Green);
-    titleText.setPosition(resolutionX / 2 - titleText.getGlobalBounds().width / 2, 120);
-    window.draw(titleText);
-    
-    // Draw subtitle
-    sf::Text subtitleText("Enhanced Edition", font, 30);
-    subtitleText.setStyle(sf::Text::Italic);
-    subtitleText.setFillColor(sf::Color(255, 165, 0)); // Orange
-    subtitleText.setPosition(resolutionX / 2 - subtitleText.getGlobalBounds().width / 2, 200);
-    window.draw(subtitleText);
-    
-    // Draw menu options
-    for (size_t i = 0; i < menuOptions.size(); i++) {
-        sf::Text optionText(menuOptions[i], font, 40);
-        if (i == selectedOption) {
-            optionText.setFillColor(sf::Color::Red);
-        } else {
-            optionText.setFillColor(sf::Color::White);
-        }
-        optionText.setPosition(resolutionX / 2 - optionText.getGlobalBounds().width / 2, 300 + i * 60);
-        window.draw(optionText);
-    }
-}
-
-void drawInstructions(sf::RenderWindow& window, sf::Font& font) {
-    // Draw instructions
-    sf::Text instructionsText("Instructions:\n\nUse arrow keys to move.\nPress Space to shoot.\nAvoid enemies and obstacles.\n\nPress ESC to return to menu.", font, 30);
-    instructionsText.setFillColor(sf::Color::White);
-    instructionsText.setPosition(50, 100);
-    window.draw(instructionsText);
-}
-
-void drawHighScores(sf::RenderWindow& window, sf::Font& font) {
-    // Draw high scores
-    sf::Text highScoresText("High Scores:", font, 40);
-    highScoresText.setFillColor(sf::Color::White);
-    highScoresText.setPosition(50, 50);
-    window.draw(highScoresText);
-    
-    for (size_t i = 0; i < highScores.size(); i++) {
-        sf::Text scoreText(to_string(i + 1) + ". " + highScores[i].name + " - " + to_string(highScores[i].score), font, 30);
-        scoreText.setFillColor(sf::Color::White);
-        scoreText.setPosition(50, 100 + i * 40);
-        window.draw(scoreText);
-    }
-}
-
-void drawGameOver(sf::RenderWindow& window, sf::Font& font, PlayerData& player) {
-    // Draw game over screen
-    sf::Text gameOverText("GAME OVER", font, 60);
-    gameOverText.setFillColor(sf::Color::Red);
-    gameOverText.setPosition(resolutionX / 2 - gameOverText.getGlobalBounds().width / 2, 200);
-    window.draw(gameOverText);
-    
-    sf::Text scoreText("Score: " + to_string(player.score), font, 40);
-    scoreText.setFillColor(sf::Color::White);
-    scoreText.setPosition(resolutionX / 2 - scoreText.getGlobalBounds().width / 2, 300);
-    window.draw(scoreText);
-    
-    sf::Text promptText("Press Enter to return to menu", font, 30);
-    promptText.setFillColor(sf::Color::White);
-    promptText.setPosition(resolutionX / 2 - promptText.getGlobalBounds().width / 2, 400);
-    window.draw(promptText);
-}
-
-void drawPauseMenu(sf::RenderWindow& window, sf::Font& font) {
-    // Draw pause menu
-    sf::Text pauseText("PAUSED", font, 60);
-    pauseText.setFillColor(sf::Color::Yellow);
-    pauseText.setPosition(resolutionX / 2 - pauseText.getGlobalBounds().width / 2, 200);
-    window.draw(pauseText);
-    
-    sf::Text promptText("Press P or ESC to resume", font, 30);
-    promptText.setFillColor(sf::Color::White);
-    promptText.setPosition(resolutionX / 2 - promptText.getGlobalBounds().width / 2, 300);
-    window.draw(promptText);
-}
-
-// Animation functions
-void updateAnimation(Animation& anim, float deltaTime) {
-    if (anim.isPlaying) {
-        anim.elapsedTime += deltaTime;
-        if (anim.elapsedTime >= ANIMATION_FRAME_TIME) {
-            anim.elapsedTime = 0.0f;
-            anim.currentFrame = (anim.currentFrame + 1) % anim.totalFrames;
-        }
-    }
-}
-
-void setupAnimations(PlayerData& player) {
-    player.animation.totalFrames = 4;
-    player.animation.isPlaying = true;
-}
-
-// Gameplay functions
-void drawPlayer(sf::RenderWindow& window, PlayerData& player, sf::Sprite& playerSprite, float deltaTime) {
-    updateAnimation(player.animation, deltaTime);
-    playerSprite.setTextureRect(sf::IntRect(player.animation.currentFrame * boxPixelsX, 0, boxPixelsX, boxPixelsY));
-    playerSprite.setPosition(player.position[x], player.position[y]);
-    window.draw(playerSprite);
-}
-
-void moveBullet(float bullet[], sf::Clock& bulletClock) {
-    if (bulletClock.getElapsedTime().asMilliseconds() < 20)
-        return;
-
-    bulletClock.restart();
-    bullet[y] -= 20; //changed to 20 from 10
-    if (bullet[y] < -32)
-        bullet[exists] = false;
-}
-
-void drawBullet(sf::RenderWindow& window, float bullet[], sf::Sprite& bulletSprite, float mush[][6], int nmush, int& score) {
-    bulletSprite.setPosition(bullet[x], bullet[y]);
-    window.draw(bulletSprite);
-    // Check for collisions with mushrooms
-    for (int i = 0; i < nmush; i++) {
-        if (mush[i][3] && bullet[x] < mush[i][0] + boxPixelsX && bullet[x] + boxPixelsX > mush[i][0] && bullet[y] < mush[i][1] + boxPixelsY && bullet[y] + boxPixelsY > mush[i][1])
-        // ^Bullet within the boundaries(left, right, top, bottom) of the mushroom?
-        {
-
-            mush[i][2]++; // Increment the hit counter
-
-            if (mush[i][2] >= 2) {
-                // Destroing the mushroom if it has been hit twice
-                mush[i][3] = false; // Set mushroom existence to false
-                score += 1;
-            }
-
-            // Reset the bullet
-            bullet[exists] = false;
-        }
-    }
-}
-
-void movePlayer(PlayerData& player, bool moveLeft, bool moveRight, bool moveUp, bool moveDown, float playerSpeed, float mush[][6], int nmush, float deltaTime) {
-    float prevPlayerX = player.position[x];
-    float prevPlayerY = player.position[y];
-
-    if (moveLeft)
-        player.position[x] -= playerSpeed * deltaTime;
-    if (moveRight)
-        player.position[x] += playerSpeed * deltaTime;
-    if (moveUp)
-        player.position[y] -= playerSpeed * deltaTime;
-    if (moveDown)
-        player.position[y] += playerSpeed * deltaTime;
-
-    // Ensure the player stays within the game window
-    if (player.position[x] < 0)
-        player.position[x] = 0;
-    if (player.position[x] > resolutionX - boxPixelsX)
-        player.position[x] = resolutionX - boxPixelsX;
-    if (player.position[y] < 0)
-        player.position[y] = 0;
-    if (player.position[y] < ((gameColumns - 5.0) / gameColumns) * (resolutionY - boxPixelsY))
-        player.position[y] = ((gameColumns - 5.0) / gameColumns) * (resolutionY - boxPixelsY);
-    if (player.position[y] > resolutionY - boxPixelsY)
-        player.position[y] = resolutionY - boxPixelsY;
-
-    // Check for collisions with mushrooms
-    for (int i = 0; i < nmush; i++) {
-        if (mush[i][3] && !mush[i][5]) {
-            if (player.position[x] < mush[i][0] + boxPixelsX && player.position[x] + boxPixelsX > mush[i][0] &&
-                player.position[y] < mush[i][1] + boxPixelsY && player.position[y] + boxPixelsY > mush[i][1]) {
-                // Restore the original position in case of collision with mushrooms
-                player.position[x] = prevPlayerX;
-                player.position[y] = prevPlayerY;
-                break; // Break the loop after handling one collision
-            }
-        }
-    }
-}
-
-void mushrooms(sf::RenderWindow& window, float mush[][6], sf::Sprite& mushSprite, sf::Texture& mushTexture, int nmush) {
-
-    for (int i = 0; i < nmush; i++) {
-
-        if (mush[i][3]) {
-
-            if ((int) mush[i][2] == 0 && mush[i][5]) {
-                mushSprite.setTextureRect(sf::IntRect(0, boxPixelsY, boxPixelsX, boxPixelsY));
-            } else if ((int) mush[i][2] == 1 && mush[i][5]) {
-                mushSprite.setTextureRect(sf::IntRect(3 * boxPixelsX, boxPixelsY, boxPixelsX, boxPixelsY));
-            } else if ((int) mush[i][2] == 0) {
-                mushSprite.setTextureRect(sf::IntRect(0, 0, boxPixelsX, boxPixelsY));
-            } else if ((int) mush[i][2] == 1) {
-                mushSprite.setTextureRect(sf::IntRect(3 * boxPixelsX, 0, boxPixelsX, boxPixelsY));
-            }
-            mushSprite.setPosition(mush[i][0], mush[i][1]);
-            window.draw(mushSprite);
-
-        }
-    }
-}
-
-void MakingHeads(int& h, float centipedeheads[][10], float centipede[][10], sf::Clock& headClock, float mush[][6], int nmush, sf::RenderWindow& window, sf::Sprite& cheadSprite, float deltaTime) {
-
-    if ((centipede[0][y] >= resolutionY - 6 * boxPixelsY) && headClock.getElapsedTime().asSeconds() > 5.0) {
-        if (h < 12) {
-            centipedeheads[h++][2] = true;
-        }
-        headClock.restart();
-    }
-    static int hdown = true;
-    for (int i = 0; i < 12; i++) {
-
-        if (centipedeheads[i][2]) {
-            bool mushexists = mushroomxcentipede(h, centipedeheads, mush, nmush, i);
-            // Check if the centipede hits the screen edge or mushrooms
-            if (centipedeheads[i][x] < 0 || centipedeheads[i][x] > resolutionX - boxPixelsX || mushexists) {
-                centipedeheads[i][3] = !centipedeheads[i][3]; //Changing the direction
-
-                if (centipedeheads[i][y] >= resolutionY - boxPixelsY) //Checking for player box boundaries
-                    hdown = false;
-                if (centipedeheads[i][y] <= resolutionY - 6 * boxPixelsY)
-                    hdown = true;
-                // Move hdown a row if hitting the edges    
-                if (hdown == true)
-                    centipedeheads[i][y] += boxPixelsY;
-                else
-                    centipedeheads[i][y] -= boxPixelsY;
-
-            }
-            if (centipedeheads[i][3] == true) {
-                centipedeheads[i][x] = centipedeheads[i][x] - 0.11; //Speed of centipedeheads        
-            } else
-                centipedeheads[i][x] = centipedeheads[i][x] + 0.11;
-
-            cheadSprite.setTextureRect(sf::IntRect(0, 0, boxPixelsX, boxPixelsY));
-            cheadSprite.setPosition(centipedeheads[i][x], centipedeheads[i][y]);
-            window.draw(cheadSprite);
-        }
-    }
-
-}
-
-void moveCentipede(int centipedeLength, float centipede[][10], float mush[][6], int nmush, sf::RenderWindow& window, sf::Sprite& centipedeSprite, sf::Sprite& cheadSprite, float deltaTime) {
-    static bool down = true;
-
-    for (int i = 0; i < centipedeLength; i++) {
-        bool mushexists = mushroomxcentipede(centipedeLength, centipede, mush, nmush, i);
-        // Check if the centipede hits the screen edge or mushrooms
-        if (centipede[i][x] < 0 || centipede[i][x] > resolutionX - boxPixelsX || mushexists) {
-            centipede[i][3] = !centipede[i][3]; //Changing the direction
-
-            if (centipede[i][y] >= resolutionY - boxPixelsY) //Checking for player box boundaries
-                down = false;
-            if (centipede[i][y] <= resolutionY - 6 * boxPixelsY)
-                down = true;
-            // Move down a row if hitting the edges    
-            if (down == true)
-                centipede[i][y] += boxPixelsY;
-            else
-                centipede[i][y] -= boxPixelsY;
-
-        }
-        if (centipede[i][3] == true) {
-            centipede[i][x] = centipede[i][x] - 0.1; //Speed of centipede        
-        } else
-            centipede[i][x] = centipede[i][x] + 0.1;
-
-        drawCentipede(window, centipedeSprite, cheadSprite, centipedeLength, centipede, i, deltaTime);
-    }
-
-}
-
-void drawCentipede(sf::RenderWindow& window, sf::Sprite& centipedeSprite, sf::Sprite& cheadSprite, int centipedeLength, float centipede[][10], int i, float deltaTime) {
-    if (centipede[i][2] == true && centipede[i][4]) {
-        cheadSprite.setTextureRect(sf::IntRect(0, 0, boxPixelsX, boxPixelsY));
-        cheadSprite.setPosition(centipede[i][x], centipede[i][y]);
-        window.draw(cheadSprite);
-    } else if (centipede[i][4]) {
-        centipedeSprite.setTextureRect(sf::IntRect(0, 0, boxPixelsX, boxPixelsY));
-        centipedeSprite.setPosition(centipede[i][x], centipede[i][y]);
-        window.draw(centipedeSprite);
-    }
-}
-
-bool mushroomxcentipede(int centipedeLength, float centipede[][10], float mush[][6], int nmush, int i) {
-
-    for (int j = 0; j < nmush; j++) {
-        if (centipede[i][4]) {
-            if (mush[j][3] && centipede[i][x] < mush[j][0] + boxPixelsX && centipede[i][x] + boxPixelsX > mush[j][0] && centipede[i][y] < mush[j][1] + boxPixelsY && centipede[i][y] + boxPixelsY > mush[j][1]) {
-                // ^if Centipede segment collided with a mushroom, move down a row,Perimeters logic same as bullet hits mush
-                return true;
-            }
-        }
-    }
-    return false;
-}
-
-void bulletxcentipede(int centipedeLength, float centipede[][10], float bullet[3], float mush[][6], int& nmush, sf::Sound& killSound, int& score, int level) {
-
-    for (int i = 0; i < centipedeLength; i++) {
-
-        if (centipede[i][4]) {
-            if (bullet[exists] && bullet[x] < centipede[i][x] + boxPixelsX && bullet[x] + boxPixelsX > centipede[i][x] && bullet[y] < centipede[i][y] + boxPixelsY && bullet[y] + boxPixelsY > centipede[i][y]) {
-
-                if (centipede[i][y] >= resolutionY - 6 * boxPixelsY) {
-                    // Add a new mushroom where the bullet hit
-                    mush[nmush][0] = centipede[i][x]; // X position
-                    mush[nmush][1] = centipede[i][y]; // Y position
-                    mush[nmush][2] = 0; // Hit counter
-                    mush[nmush][3] = true; // Mushroom exists
-                    mush[nmush][4] = false; // Mush eat
-                    mush[nmush][5] = true; //Poisonous
-                    nmush++;
-                }
-                if (centipede[i][2]) {
-                    score += 20;
-                } else {
-                    score += 10;
-                }
-                // ^if Bullet hit a centipede segment, v split the centipede
-                centipede[i][4] = false;
-                centipede[i + 1][2] = true; //new head
-                bullet[exists] = false; // Reset the bullet
-
-                if (centipede[i][2]) //only when earlier levels to get rid of all segments of one centipede
-                {
-                    killSound.play();
-                    int j = i + 1;
-                    while (centipede[j][4] && j < centipedeLength) {
-                        centipede[j][4] = false;
-                        j++;
-                    }
-
-                }
-            }
-
-        }
-
-    }
-}
-
-void bulletxhead(int& h, float centipedeheads[][10], float bullet[3], float mush[][6], int& nmush, sf::Sound& killSound, int& score) {
-    for (int i = 0; i < h; i++) {
-
-        if (centipedeheads[i][2]) {
-            if (bullet[exists] && bullet[x] < centipedeheads[i][x] + boxPixelsX && bullet[x] + boxPixelsX > centipedeheads[i][x] && bullet[y] < centipedeheads[i][y] + boxPixelsY && bullet[y] + boxPixelsY > centipedeheads[i][y]) {
-
-                // Add a new mushroom where the bullet hit
-                mush[nmush][0] = centipedeheads[i][x]; // X position
-                mush[nmush][1] = centipedeheads[i][y]; // Y position
-                mush[nmush][2] = 0; // Hit counter
-                mush[nmush][3] = true; // Mushroom exists
-                mush[nmush][4] = false; // Mush eat
-                mush[nmush][5] = true; //Poisonous
-                nmush++;
-                score += 20;
-                centipedeheads[i][2] = false;
-                bullet[exists] = false; // Reset the bullet
-                killSound.play();
-            }
-        }
-
-    }
-}
-
-void isPlayerhit(PlayerData& player, float centipede[][10], int centipedeLength, float mush[][6], int& nmush, float centipedeheads[][10], sf::Sound& hitSound) {
-
-    for (int i = 0; i < centipedeLength; i++) {
-        if (centipede[i][4]) {
-            if (player.position[x] + boxPixelsX > centipede[i][x] && player.position[x] < centipede[i][x] + boxPixelsX && player.position[y] + boxPixelsY > centipede[i][y] && player.position[y] < centipede[i][y] + boxPixelsY) {
-                player.lives--;
-                player.isInvulnerable = true;
-                player.invulnerabilityTime = 2.0f; // 2 seconds of invulnerability
-                hitSound.play();
-            }
-        }
-        if (centipedeheads[i][2]) {
-            if (player.position[x] + boxPixelsX > centipedeheads[i][x] && player.position[x] < centipedeheads[i][x] + boxPixelsX && player.position[y] + boxPixelsY > centipedeheads[i][y] && player.position[y] < centipedeheads[i][y] + boxPixelsY) {
-                player.lives--;
-                player.isInvulnerable = true;
-                player.invulnerabilityTime = 2.0f; // 2 seconds of invulnerability
-                hitSound.play();
-            }
-        }
-    }
-
-    // Check for collisions with poisonous mushrooms
-    for (int i = 0; i < nmush; i++) {
-        if (mush[i][3] && mush[i][5]) {
-            if (player.position[x] < mush[i][0] + boxPixelsX && player.position[x] + boxPixelsX > mush[i][0] &&
-                player.position[y] < mush[i][1] + boxPixelsY && player.position[y] + boxPixelsY > mush[i][1]) {
-
-                player.lives--;
-                player.isInvulnerable = true;
-                player.invulnerabilityTime = 2.0f; // 2 seconds of invulnerability
-                hitSound.play();
-
-            }
-        }
-    }
-
-}
-
-void FleasDrop(float flea[5], float mush[][6], int& nmush, sf::RenderWindow& window, sf::Sprite& fleaSprite, float deltaTime) {
-    int MushinArea = 0;
-    static bool flag = true; //to overcome floating point equivilace issue
-    for (int i = 0; i < nmush; i++) {
-        if (mush[i][y] >= resolutionY - 6 * boxPixelsY && mush[i][3]) {
-            MushinArea++;
-        }
-    }
-    if (MushinArea == 3) {
-        flea[2] = true;
-    }
-    if (flea[2]) {
-        //Draw
-        fleaSprite.setTextureRect(sf::IntRect(0, 0, boxPixelsX, boxPixelsY));
-        fleaSprite.setPosition(flea[x], flea[y]);
-        window.draw(fleaSprite);
-
-        flea[y] += 0.1; //flea speed
-
-        //Trail
-        if ((int) flea[y] == 15 * boxPixelsY && flag) {
-            for (int i = 0; i < 3; i++) {
-                mush[nmush][x] = flea[x];
-                mush[nmush][y] = flea[y] + (boxPixelsY + 2) * i;
-                mush[nmush][2] = 0; // Hit counter
-                mush[nmush][3] = true; // Mushroom exists
-                mush[nmush][4] = false; // Mush eat
-                mush[nmush][5] = false; //Poisonous?
-                nmush++;
-            }
-            flag = false;
-        }
-
-        if (flea[y] > resolutionY - boxPixelsY)
-            flea[2] = false;
-    }
-}
-
-void moveSpider(float spider[5], float mush[][6], int& nmush, sf::RenderWindow& window, sf::Sprite& spiderSprite, PlayerData& player, float bullet[3], sf::Sound& hitSound, float deltaTime) {
-    if (spider[2]) {
-        static bool died = false;
-        static bool kills = false;
-
-        static sf::Clock deathTimer;
-
-        // If the spider is hit by a bullet
-        if (bullet[exists] && bullet[x] < spider[x] + boxPixelsX && bullet[x] + boxPixelsX > spider[x] && bullet[y] < spider[y] + boxPixelsY && bullet[y] + boxPixelsY > spider[y]) {
-            bullet[exists] = false;
-            if (player.position[y] - spider[y] < 100) {
-                spiderSprite.setTextureRect(sf::IntRect(3.9 * boxPixelsX, 0, 1.9 * boxPixelsX, 2 * boxPixelsY));
-                player.score += 900;
-            } else if (player.position[y] - spider[y] < 150) {
-                spiderSprite.setTextureRect(sf::IntRect(1.9 * boxPixelsX, 0, 1.9 * boxPixelsX, 2 * boxPixelsY));
-                player.score += 600;
-            } else {
-                spiderSprite.setTextureRect(sf::IntRect(0, 0, 1.9 * boxPixelsX, 2 * boxPixelsY));
-                player.score += 300;
-            }
-            died = true;
-            deathTimer.restart();
-        }
-        // If the spider is not hit by a bullet
-        else if (!died) {
-            spiderSprite.setTextureRect(sf::IntRect(7.5 * boxPixelsX, 0, 1.9 * boxPixelsX, boxPixelsY));
-        }
-
-        // If the spider has been hit and 2 seconds have passed
-        if (died && deathTimer.getElapsedTime().asSeconds() > 0.5) {
-            spider[2] = false;
-            died = false;
-        }
-        spiderSprite.setPosition(spider[x], spider[y]);
-        window.draw(spiderSprite);
-        if (died == false) {
-            if ((int) spider[x] == 20 * boxPixelsX) {
-                spider[3] = false; //left
-            } else if ((int) spider[x] == 0) {
-                spider[3] = true; //right
-            }
-            if ((int) spider[y] == resolutionY - 10 * boxPixelsY) {
-                spider[4] = true; //down
-            } else if ((int) spider[y] == resolutionY - boxPixelsY) {
-                spider[4] = false; //up
-            }
-
-            if (spider[3]) {
-                spider[x] += 0.05;
-            } else {
-                spider[x] -= 0.05;
-            }
-
-            if (spider[4]) {
-                spider[y] += 0.05;
-            } else {
-                spider[y] -= 0.05;
-            }
-
-            //Check for collision with spider
-            if (!kills && player.position[x] < spider[x] + boxPixelsX && player.position[x] + boxPixelsX > spider[x] && player.position[y] < spider[y] + boxPixelsY && player.position[y] + boxPixelsY > spider[y]) {
-
-                player.lives--;
-                player.isInvulnerable = true;
-                player.invulnerabilityTime = 2.0f; // 2 seconds of invulnerability
-                hitSound.play();
-                kills = true;
-
-            }
-            //Eating mushrooms
-            for (int i = 0; i < nmush; i++) {
-
-                if (mush[i][3]) {
-                    if (spider[x] < mush[i][0] + boxPixelsX && spider[x] + boxPixelsX > mush[i][0] && spider[y] < mush[i][1] + boxPixelsY && spider[y] + boxPixelsY > mush[i][1]) {
-                        mush[i][3] = false;
-                    }
-                }
-            }
-        }
-    }
-}
-
-void moveScorpion(float scorpion[5], float mush[][6], int& nmush, sf::RenderWindow& window, sf::Sprite& scorpionSprite, PlayerData& player, float bullet[3], float deltaTime) {
-    if (scorpion[2]) {
-
-        //draw
-        scorpionSprite.setTextureRect(sf::IntRect(0, 0, 2 * boxPixelsX, boxPixelsY));
-        scorpionSprite.setPosition(scorpion[x], scorpion[y]);
-        window.draw(scorpionSprite);
-
-        if (scorpion[x] < 0 || scorpion[x] > resolutionX - 2 * boxPixelsX) {
-            scorpion[3] = !scorpion[3];
-        }
-        if (scorpion[3]) {
-            scorpion[x] += 0.2;
-        } else {
-            scorpion[x] -= 0.2;
-        }
-        //Killing scorpion
-        if (bullet[exists] && bullet[x] < scorpion[x] + boxPixelsX && bullet[x] + boxPixelsX > scorpion[x] && bullet[y] < scorpion[y] + boxPixelsY && bullet[y] + boxPixelsY > scorpion[y]) {
-            bullet[exists] = false;
-            scorpion[2] = false;
-            player.score += 1000;
-        }
-        //Poisonous mushrooms
-        for (int i = 0; i < nmush; i++) {
-
-            if (mush[i][3]) {
-                if (scorpion[x] < mush[i][0] + boxPixelsX && scorpion[x] + boxPixelsX > mush[i][0] && scorpion[y] < mush[i][1] + boxPixelsY && scorpion[y] + boxPixelsY > mush[i][1]) {
-                    mush[i][5] = true;
-                }
-            }
-        }
-
-    }
-
-}
-
-void nextLevel(int& centipedeLength, float centipede[][10], float mush[][6], int nmush, float flea[5], float spider[5], float scorpion[5], int& score, 
-              int startColumn, int startRow, int& level, float centipedeheads[][10], sf::Sound& levelupSound) {
-
-    bool LevelCheck = true;
-    for (int i = 0; i < centipedeLength; i++) {
-        if (centipede[i][4]) {
-            LevelCheck = false;
-            break;
-        }
-    }
-    for (int i = 0; i < centipedeLength; i++) {
-        if (centipedeheads[i][2]) {
-            LevelCheck = false;
-            break;
-        }
-    }
-    if (LevelCheck) {
-    levelupSound.play();
-        level++;
-        for (int i = 0; i < centipedeLength; i++) {
-            centipede[i][2] = false; //head exists or no
-            centipede[i][3] = true; //direction left?
-            centipede[i][4] = true; //segment exists?
-        }
-        centipede[0][2] = true; //head 
-        for (int i = 0; i < centipedeLength; i++) {
-            centipede[i][x] = (startColumn + i) * boxPixelsX; // Increase x position for each segment
-            centipede[i][y] = startRow * boxPixelsY;
-        }
-        for (int p = 0; p < 12; p++) {
-            centipedeheads[p][x] = (gameColumns - 1) * boxPixelsX;
-            centipedeheads[p][y] = (gameRows - 3) * boxPixelsX;
-            centipedeheads[p][2] = false;
-            centipedeheads[p][3] = true;
-        }
-        for (int i = 0; i < nmush; i++) {
-            if (!mush[i][3])
-                score += 5; //Regenerating score
-            mush[i][3] = true;
-            mush[i][5] = false;
-            mush[i][2] = 0;
-        }
-        flea[x] = 15 * boxPixelsX;
-        flea[y] = 0;
-        flea[2] = false; //doesn't exist yet
-
-        spider[x] = 0;
-        spider[y] = 20 * boxPixelsY;
-        spider[2] = true; //exists
-        spider[3] = true; //direction right
-        spider[4] = true; //direction down
-
-        scorpion[x] = 0;
-        scorpion[y] = 26 * boxPixelsY;
-        scorpion[2] = true; //exists
-        scorpion[3] = true; //direction right
-
-    }
-}
-
-void createParticleEffect(sf::RenderWindow& window, float posX, float posY, sf::Color color) {
-    // Create particle effect
-    sf::CircleShape particle(2);
-    particle.setFillColor(color);
-    particle.setPosition(posX, posY);
-    window.draw(particle);
-}
-
-void drawHUD(sf::RenderWindow& window, sf::Font& font, PlayerData& player, int level) {
-    // Draw score
-    sf::Text scoreText("Score: " + to_string(player.score), font, 24);
-    scoreText.setFillColor(sf::Color::Red);
-    scoreText.setPosition(10, 9);
-    window.draw(scoreText);
-    
-    // Draw lives
-    sf::Text livesText("Lives: " + to_string(player.lives), font, 24);
-    livesText.setFillColor(sf::Color::Green);
-    livesText.setPosition(10, 35);
-    window.draw(livesText);
-    
-    // Draw level
-    sf::Text levelText("Level: " + to_string(level), font, 24);
-    levelText.setFillColor(sf::Color::White);
-    levelText.setPosition(10, 61);
-    window.draw(levelText);
-}
+#include <iostream>
+#include <SFML/Graphics.hpp>
+#include <SFML/Audio.hpp>
+#include <SFML/Network.hpp>
+#define GL_GLEXT_PROTOTYPES
+#include <SFML/OpenGL.hpp>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <immintrin.h>
+#define OVERLAP_X86 // SSE2 and AVX2 overlap kernels, chosen at runtime
+#endif
+#include "Leaderboard.h"
+#include "Analytics.h"
+#include "Spectator.h"
+#include "SharedWorld.h"
+
+using namespace std;
+
+// Game states
+enum GameState {
+    MENU,
+    PLAYING,
+    PAUSED,
+    GAME_OVER,
+    INSTRUCTIONS,
+    HIGH_SCORES,
+    CONNECTING
+};
+
+// Initializing Dimensions.
+const int resolutionX = 960;
+const int resolutionY = 960;
+const int boxPixelsX = 32;
+const int boxPixelsY = 32;
+const int gameRows = resolutionX / boxPixelsX; // Total rows on grid
+const int gameColumns = resolutionY / boxPixelsY; // Total columns on grid
+
+// Initializing GameGrid.
+int gameGrid[gameRows][gameColumns] = {};
+
+// The following exist purely for readability.
+const int x = 0;
+const int y = 1;
+const int exists = 2;
+
+// Constants for animations
+const float ANIMATION_FRAME_TIME = 0.1f; // Time to switch animation frames (seconds)
+
+// Constants for the fixed-rate simulation. Gameplay only ever advances in whole
+// ticks, so two runs fed the same inputs produce the same world.
+const int SIM_TICKS_PER_SECOND = 240;
+const float SIM_TICK_TIME = 1.0f / SIM_TICKS_PER_SECOND;
+const int MAX_TICKS_PER_FRAME = 32; // Drop time rather than spiral when a frame stalls
+const float MIN_TIME_SCALE = 0.1f;
+const float MAX_TIME_SCALE = 4.0f;
+
+// Entity capacities
+const int CENTIPEDE_LENGTH = 12;
+const int MAX_HEADS = 12;
+const int MAX_MUSHROOMS = 200;
+const int MAX_BULLETS = 256;
+
+// Gameplay coordinates are 16.16 fixed point, FIXED_ONE to the pixel. Integer
+// arithmetic comes out the same with every compiler, optimization level and
+// CPU, which replays, rollback and comparing runs across machines rely on.
+// Whole pixels and cells are a shift away, and floats are only made for drawing.
+typedef int32_t Fixed;
+const int FIXED_SHIFT = 16;
+const Fixed FIXED_ONE = 1 << FIXED_SHIFT;
+
+constexpr Fixed toFixed(int pixels) {
+    return pixels * FIXED_ONE;
+}
+
+// numerator / denominator pixels, rounded to the nearest step
+constexpr Fixed fixedRatio(int numerator, int denominator) {
+    return (Fixed) (((int64_t) numerator * FIXED_ONE + denominator / 2) / denominator);
+}
+
+// Whole pixels, rounded down
+inline int fixedToInt(Fixed value) {
+    return value >> FIXED_SHIFT;
+}
+
+// Cell of a grid with cells this many pixels wide, rounded down like the pixels
+inline int fixedCell(Fixed value, int cellPixels) {
+    int pixels = fixedToInt(value);
+    return (pixels >= 0 ? pixels : pixels - cellPixels + 1) / cellPixels;
+}
+
+inline float fixedToFloat(Fixed value) {
+    return value * (1.0f / FIXED_ONE);
+}
+
+// Movement speeds (per tick) and tick-based timers
+const Fixed PLAYER_SPEED = fixedRatio(200, SIM_TICKS_PER_SECOND); // 200 pixels per second
+const Fixed CENTIPEDE_SPEED = fixedRatio(1, 2);
+const Fixed HEAD_SPEED = fixedRatio(55, 100);
+const Fixed FLEA_SPEED = fixedRatio(1, 2);
+const Fixed SPIDER_SPEED = fixedRatio(1, 4);
+const Fixed SCORPION_SPEED = toFixed(1);
+const int BULLET_STEP_TICKS = 5; // Bullet jumps 20 pixels every 5 ticks
+const int HEAD_SPAWN_TICKS = 5 * SIM_TICKS_PER_SECOND;
+const int SPIDER_DEATH_TICKS = SIM_TICKS_PER_SECOND / 2;
+const int INVULNERABILITY_TICKS = 2 * SIM_TICKS_PER_SECOND;
+
+// Constants for timer wheels. A wheel is TIMER_LEVELS rings of TIMER_SLOTS
+// slots, each slot of a ring spanning one whole turn of the ring below, so
+// the rings reach 64, 4096, 262144 and 16777216 ticks ahead.
+const int TIMER_SLOT_BITS = 6;
+const int TIMER_SLOTS = 1 << TIMER_SLOT_BITS;
+const int TIMER_LEVELS = 4;
+const unsigned int TIMER_MAX_DELAY = (1u << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1; // Longer delays are cut to this (19 hours)
+const unsigned short NO_TIMER = 0xffff;
+
+// States of a timer that is not linked into a slot
+enum TimerState {
+    TIMER_FREE = TIMER_LEVELS * TIMER_SLOTS,
+    TIMER_PAUSED, // due holds the ticks it has left
+    TIMER_EXPIRED // Went off; the owner restarts or stops it
+};
+
+// Structure for one timer. A running one is linked into the list of the slot
+// it waits in; free ones are chained through next.
+struct TimerNode {
+    unsigned int due; // Wheel tick it goes off on
+    unsigned short next;
+    unsigned short prev;
+    unsigned short slot; // Ring and slot it is linked into, or a TimerState
+    unsigned short subject; // Whatever the owner needs to find its entity again
+};
+
+// Structure for a hierarchical timer wheel counting simulation ticks. Starting,
+// stopping, pausing and resuming a timer link or unlink one node, so they cost
+// the same with thousands running. Advancing one tick goes off with the bottom
+// ring's current slot; each time a ring comes round, the next ring up moves its
+// current slot's timers down to where they are now due. The wheel is plain data
+// with its nodes inside, so a world holding wheels still copies as raw memory,
+// and since it only moves when the simulation ticks, pausing the game or changing
+// its speed takes every timer with it.
+template <int N>
+struct TimerWheel {
+    static_assert(N < NO_TIMER, "Timer handles are 16 bits");
+    unsigned int now; // Ticks advanced since the last reset
+    unsigned short slots[TIMER_LEVELS * TIMER_SLOTS]; // First timer in each slot
+    unsigned short firstFree;
+    unsigned short count; // Timers in use
+    TimerNode nodes[N];
+};
+
+const int PLAYER_TIMERS = 1; // Invulnerability
+const int HEAD_TIMERS = 1;   // Next head
+
+// Player input bits for one simulation tick
+enum InputBits {
+    INPUT_LEFT = 1 << 0,
+    INPUT_RIGHT = 1 << 1,
+    INPUT_UP = 1 << 2,
+    INPUT_DOWN = 1 << 3,
+    INPUT_FIRE = 1 << 4
+};
+
+// Gameplay events raised during a tick (main plays the matching sounds)
+enum GameEvent {
+    EVENT_FIRE = 1 << 0,
+    EVENT_KILL = 1 << 1,
+    EVENT_HIT = 1 << 2,
+    EVENT_LEVEL_UP = 1 << 3
+};
+
+// Collision layers. Each collider has a layer and a mask of the layers it
+// reacts to; a pair becomes a contact when either side's mask has the other's layer.
+enum CollisionLayer {
+    LAYER_BULLET = 1 << 0,
+    LAYER_PLAYER = 1 << 1,
+    LAYER_SEGMENT = 1 << 2,
+    LAYER_HEAD = 1 << 3,
+    LAYER_SPIDER = 1 << 4,
+    LAYER_SCORPION = 1 << 5,
+    LAYER_FLEA = 1 << 6,
+    LAYER_MUSHROOM = 1 << 7
+};
+
+// Collision layer of each EnemyKind
+const unsigned int ENEMY_LAYERS[] = {LAYER_FLEA, LAYER_SPIDER, LAYER_SCORPION};
+
+// Structure for animations
+struct Animation {
+    int currentFrame = 0;
+    int totalFrames = 0;
+    float elapsedTime = 0.0f;
+    bool isPlaying = false;
+};
+
+// Structure for player data
+struct PlayerData {
+    Fixed position[2]; // x, y
+    Animation animation;
+    int lives;
+    int score;
+    char name[16];
+    bool isMoving;
+    bool isInvulnerable;
+    unsigned short invulnerabilityTimer; // Ends isInvulnerable, NO_TIMER when vulnerable
+    TimerWheel<PLAYER_TIMERS> timers;
+};
+
+// Kinds of particle burst the simulation can ask for
+enum BurstKind {
+    BURST_EXPLOSION, // An enemy was shot
+    BURST_DEATH,     // The player was hit
+    BURST_SPORES     // A mushroom was destroyed
+};
+
+// Structure for a particle burst raised during a tick. The simulation only
+// says where; the particles themselves live outside the world.
+struct Burst {
+    float posX, posY;
+    int kind;
+};
+
+const int MAX_BURSTS = 32; // Per tick, extra ones are dropped
+
+// Structure for a session log record raised during a tick: an AnalyticsEvent
+// and its AnalyticsSubject (see Analytics.h). Like bursts, the simulation only
+// notes what happened and where; the log is written outside the world.
+struct TickRecord {
+    float posX, posY;
+    int kind;
+    int subject;
+};
+
+const int MAX_TICK_RECORDS = 32; // Per tick, extra ones are dropped
+
+// Structure for the records raised by one tick
+struct TickRecords {
+    TickRecord items[MAX_TICK_RECORDS];
+    int count;
+};
+
+// Structure for the projectile pool, one array per field. Live bullets are
+// packed at the front: spawning appends, despawning moves the last one into the hole.
+struct BulletPool {
+    Fixed posX[MAX_BULLETS];
+    Fixed posY[MAX_BULLETS];
+    unsigned short stepTimer[MAX_BULLETS]; // Goes off for the next 20 pixel jump; its subject is the bullet
+    int count;
+    TimerWheel<MAX_BULLETS> timers;
+};
+
+// Constants for scripted enemies
+const int MAX_ENEMIES = 256;
+
+// Enemy kinds, each driven by its own behavior
+enum EnemyKind {
+    ENEMY_FLEA,
+    ENEMY_SPIDER,
+    ENEMY_SCORPION
+};
+
+// Structure for one scripted enemy. Its behavior is a resumable function (see
+// CO_BEGIN) whose frame, the resume point plus everything kept across ticks,
+// is stored right here, so a world full of half-finished scripts still copies
+// as raw memory and any number of each kind can run at once.
+struct Enemy {
+    Fixed posX, posY;
+    int kind;
+    int resume; // Where the behavior continues next tick, 0 to start
+    int wait;   // Ticks a CO_WAIT asked to sleep for
+    unsigned short timer; // Wakes it from a CO_WAIT, NO_TIMER while awake
+    int points; // Score a shot spider shows
+    int heading; // Spiders: the FLOW_DX/FLOW_DY step they are taking to the next cell
+    bool right;
+    bool down;
+    bool shot;  // A shot spider fades out showing its points
+    bool alive; // Cleared to remove; the slot is reclaimed before the next update
+};
+
+// Structure for the enemy pool, which doubles as the arena for their
+// behavior frames. Live enemies are packed at the front in spawn order.
+struct EnemyPool {
+    Enemy items[MAX_ENEMIES];
+    int count;
+    bool fleaReleased; // Only one flea per level
+    bool spiderBit;    // Spiders only bite once a game, not once a level
+    TimerWheel<MAX_ENEMIES> timers; // Sleeping enemies; a timer's subject is its enemy
+};
+
+// Resumable behaviors, in the protothread style. A behavior is an ordinary
+// function wrapped in a switch on the enemy's saved resume point: CO_YIELD
+// records the line and returns until the next tick, when the switch jumps
+// straight back in after it. Locals do not survive a yield, so anything a
+// script needs later is kept in the Enemy. A behavior returns false once done.
+// CO_WAIT yields and asks to sleep: the pool puts the enemy on its timer wheel
+// and does not resume it at all until the timer goes off.
+#define CO_BEGIN(e) switch ((e).resume) { case 0:
+#define CO_YIELD(e) do { (e).resume = __LINE__; return true; case __LINE__:; } while (0)
+#define CO_WAIT(e, ticks) do { (e).wait = (ticks); CO_YIELD(e); } while (0)
+#define CO_END(e) } return false
+
+// Scores that award an extra life, lowest first
+const int EXTRA_LIFE_SCORES[] = {10000, 20000, 50000};
+
+// Structure for aggregate counts over the world's arrays. They are updated at
+// every place that creates or destroys something, so per-tick checks read a
+// counter instead of rescanning (countWorldStats does the full scan).
+struct WorldStats {
+    int liveSegments;
+    int liveHeads; // Free heads in centipedeheads
+    int liveMushrooms;
+    int zoneMushrooms; // Live mushrooms in the player zone, the flea's trigger
+    int poisonedMushrooms; // Live poisonous mushrooms
+};
+
+// Structure for the mushroom positions, one coordinate per array, so overlap
+// queries test several mushrooms per instruction. Mushrooms never move, so
+// addMushroom writes these once and everything else only reads them.
+struct MushroomBoxes {
+    Fixed x[MAX_MUSHROOMS];
+    Fixed y[MAX_MUSHROOMS];
+};
+
+// Constants for the mushroom field generator. Mushrooms grow one to a cell in
+// the rows above the bottom three, which are split into bands of their own density.
+const int FIELD_COLUMNS = resolutionX / boxPixelsX;
+const int FIELD_ROWS = resolutionY / boxPixelsY - 3;
+const int FIELD_CELLS = FIELD_COLUMNS * FIELD_ROWS;
+const int FIELD_BANDS = 3; // Top rows, middle rows, player zone
+const int FIELD_BAND_ROWS[FIELD_BANDS + 1] = {0, 8, (resolutionY - 6 * boxPixelsY) / boxPixelsY, FIELD_ROWS};
+const int FIELD_START_ROWS = 10; // The centipede enters on one of the top rows
+const int FIELD_PLAYER_CLEARANCE = 2; // Player zone columns kept clear either side of the player's start
+const int FIELD_LIBRARY_SIZE = 64;
+
+// Structure for how a field is drawn
+struct FieldSpec {
+    int minMushrooms;
+    int maxMushrooms;
+    int bandWeight[FIELD_BANDS]; // Mushrooms per free cell, relative to the other bands
+    bool spread; // Poisson-disk: no two mushrooms in neighbouring cells
+};
+
+const FieldSpec DEFAULT_FIELD_SPEC = {20, 30, {3, 2, 1}, true};
+
+// Structure for a drawn field. The same seed and spec always draw the same field.
+struct MushroomField {
+    unsigned int seed;
+    unsigned int rngState; // The world's generator once the field is drawn
+    int startRow; // The centipede's, kept clear with the rows either side
+    int count;
+    unsigned short cells[MAX_MUSHROOMS]; // row * FIELD_COLUMNS + column
+};
+
+// Structure for fields drawn ahead of time for the seeds firstSeed onwards,
+// so a game on one of those seeds starts without drawing its field
+struct FieldLibrary {
+    FieldSpec spec;
+    unsigned int firstSeed;
+    unsigned int nextSeed; // The next game's
+    MushroomField fields[FIELD_LIBRARY_SIZE];
+    MushroomField scratch; // Seeds outside the library are drawn here
+};
+
+// One implementation of the overlap kernel. A scan tests one tile-sized box
+// against boxes from..count-1 and returns the first that overlaps (count if
+// none). Given a mask it does not stop there, but sets a bit for every hit.
+typedef int (*OverlapScan)(Fixed boxX, Fixed boxY, const Fixed xs[], const Fixed ys[], int from, int count, unsigned int mask[]);
+
+// Structure for an overlap kernel and whether this CPU can run it
+struct OverlapKernel {
+    const char* name;
+    OverlapScan scan;
+    bool (*supported)();
+};
+
+// Constants for the flow field enemies chase the player along. Each cell
+// holds the cost of the cheapest path from it to the player's cell and the
+// step that starts it, so any number of enemies steer with one lookup each.
+const int FLOW_COLUMNS = resolutionX / boxPixelsX;
+const int FLOW_ROWS = resolutionY / boxPixelsY;
+const int FLOW_CELLS = FLOW_COLUMNS * FLOW_ROWS;
+const int FLOW_STEP_COST = 1;
+const int FLOW_MUSHROOM_COST = 4; // Spiders chew through mushrooms, but it slows them down
+const int FLOW_BUCKETS = FLOW_MUSHROOM_COST + 1; // Costs still queued always span less than this
+const int FLOW_STILL = 8; // The step out of the player's own cell
+const int FLOW_DX[FLOW_STILL + 1] = {1, 1, 0, -1, -1, -1, 0, 1, 0};
+const int FLOW_DY[FLOW_STILL + 1] = {0, 1, 1, 1, 0, -1, -1, -1, 0};
+static_assert(FLOW_COLUMNS <= 32, "A row of mushroom cells must fit in one mask");
+
+// What updateFlowField had to do
+enum FlowUpdate {
+    FLOW_UNCHANGED,
+    FLOW_REPAIRED, // Mushrooms went, so only paths through their cells got cheaper
+    FLOW_REBUILT   // The player changed cell or mushrooms grew
+};
+
+// Structure for the flow field, kept up to date by the flow field system
+struct FlowField {
+    int target; // The player's cell, -1 until the first update
+    unsigned int mushroomRows[FLOW_ROWS]; // A bit per column for every cell holding a mushroom
+    unsigned short cost[FLOW_CELLS]; // From the cell to the player's
+    unsigned char step[FLOW_CELLS]; // FLOW_DX/FLOW_DY index of the next cell on the way
+};
+
+// Structure holding the complete gameplay state. It is plain data, so a
+// snapshot is a single copy and restoring one is another.
+struct GameWorld {
+    PlayerData player;
+    BulletPool bullets;
+    Fixed centipede[CENTIPEDE_LENGTH][10];
+    Fixed centipedeheads[MAX_HEADS][10];
+    Fixed mush[MAX_MUSHROOMS][6];
+    MushroomBoxes mushBoxes; // Positions of mush, for overlap queries
+    int nmush;
+    EnemyPool enemies;
+    FlowField flow;
+    int centipedeLength;
+    int startColumn;
+    int startRow;
+    int level;
+    int heads;
+    int nextLifeScore; // Score that awards the next extra life
+    WorldStats stats;
+    bool centipedeDown;
+    bool headsDown;
+    int fireInterval; // Ticks between shots, 0 for the classic one bullet on screen
+    int fireCooldown;
+    unsigned short headTimer; // Runs while the centipede is in the player zone
+    TimerWheel<HEAD_TIMERS> headTimers;
+    unsigned int tick;
+    unsigned int rngState;
+    unsigned int events; // GameEvent bits raised by the last tick
+    Burst bursts[MAX_BURSTS]; // Particle bursts raised by the last tick
+    int burstCount;
+    TickRecords records; // Session log records raised by the last tick
+};
+
+static_assert(is_trivially_copyable<GameWorld>::value, "GameWorld must stay copyable as raw memory");
+
+// The world's components. Each entity kind already lives in its own packed,
+// fixed-size table inside GameWorld; these bits name those tables so systems
+// can declare what they touch.
+enum WorldComponent {
+    COMP_PLAYER = 1 << 0,
+    COMP_BULLETS = 1 << 1,   // bullets, fireInterval, fireCooldown
+    COMP_CENTIPEDE = 1 << 2, // centipede, centipedeLength, centipedeDown
+    COMP_HEADS = 1 << 3,     // centipedeheads, heads, headTimer, headTimers, headsDown
+    COMP_MUSHROOMS = 1 << 4, // mush, mushBoxes, nmush
+    COMP_ENEMIES = 1 << 5,   // Fleas, spiders and scorpions
+    COMP_LEVEL = 1 << 6,     // level, startColumn, startRow, nextLifeScore
+    COMP_STATS = 1 << 7,
+    COMP_EVENTS = 1 << 8,    // events, bursts, burstCount, records
+    COMP_FLOW = 1 << 9
+};
+const int COMPONENT_COUNT = 10;
+const char* const COMPONENT_NAMES[COMPONENT_COUNT] = {
+    "player", "bullets", "centipede", "heads", "mushrooms", "enemies", "level", "stats", "events", "flow"
+};
+
+// Constants for the job system
+const int MAX_JOB_THREADS = 64;
+const int BULLET_CHUNK = 64; // Bullets per parallel-for job in the collision stage
+const int MAX_QUEUED_JOBS = 256; // Per thread; a job pushed onto a full queue runs at once
+
+// Structure for one job: a range of a parallel-for, or one system of the
+// tick's graph. pending is counted down once the job has run.
+struct Job {
+    void (*run)(void* context, int begin, int end);
+    void* context;
+    int begin, end;
+    atomic<int>* pending;
+};
+
+// Structure for one thread's jobs, a fixed ring so queueing never allocates.
+// The owner pushes and pops at the back, so it carries on with what it just
+// queued while the data is still in its cache; a thread with nothing to do
+// steals from the front.
+struct JobQueue {
+    mutex lock;
+    Job jobs[MAX_QUEUED_JOBS];
+    int first = 0; // Oldest job's slot
+    int count = 0;
+};
+
+// Structure for the work-stealing job system. A thread waiting for jobs it
+// started runs jobs itself meanwhile, so with one thread there are no
+// workers and everything runs inline on the caller.
+struct JobSystem {
+    int threads = 1;
+    unique_ptr<JobQueue[]> queues; // One per thread, the main thread's first
+    vector<thread> workers;
+    mutex sleepLock;
+    condition_variable wake;
+    atomic<int> queued{0}; // Jobs in all queues together
+    bool quit = false;
+
+    // Statistics
+    atomic<long long> jobsRun{0};
+    atomic<long long> steals{0};
+};
+
+// Structure for one gameplay system. A system only sees the world, the
+// tick's input and the job system it may split large loops over (null to run
+// them inline), and declares the components it reads and writes (writing
+// implies reading). Adding an enemy is a new table in GameWorld and a new
+// entry in WORLD_SYSTEMS rather than new parameters everywhere.
+struct WorldSystem {
+    const char* name;
+    void (*run)(GameWorld& world, unsigned char input, JobSystem* jobs);
+    unsigned int reads;
+    unsigned int writes;
+};
+
+const int MAX_SYSTEMS = 16;
+
+// Structure for the order systems run in. Systems that share a stage touch
+// no component another of them writes, so a stage can be spread over threads.
+// The same conflicts, as bits per system, make the graph a tick runs on the
+// job system: a system starts once every earlier one it conflicts with is done.
+struct WorldSchedule {
+    int order[MAX_SYSTEMS]; // System indices, stage by stage
+    int stage[MAX_SYSTEMS]; // Stage of each system, by system index
+    unsigned int after[MAX_SYSTEMS]; // Earlier systems each one waits for
+    unsigned int before[MAX_SYSTEMS]; // Later systems waiting for each one
+    int systemCount;
+    int stageCount;
+};
+
+// Structure for one tick's run through the system graph
+struct SystemGraphRun {
+    GameWorld* world;
+    unsigned char input;
+    JobSystem* jobs;
+    atomic<int> waiting[MAX_SYSTEMS]; // Unfinished systems each one waits for
+    atomic<int> pending; // Systems not finished yet
+};
+
+// Constants for the collision stage
+const int MAX_COLLIDERS = 1 + CENTIPEDE_LENGTH + MAX_HEADS + MAX_ENEMIES;
+const int MAX_GRID_TARGETS = CENTIPEDE_LENGTH + MAX_HEADS + MAX_ENEMIES + MAX_MUSHROOMS;
+const int MAX_CONTACTS = 4 * (MAX_COLLIDERS + MAX_BULLETS);
+const int GRID_COLUMNS = resolutionX / boxPixelsX;
+const int GRID_ROWS = resolutionY / boxPixelsY;
+
+// Structure for one moving entity's box in the collision stage
+struct Collider {
+    Fixed minX, minY, maxX, maxY;
+    unsigned int layer;
+    unsigned int mask;
+    int index; // Slot in the entity's own array
+};
+
+// Structure for an overlapping pair, ordered so layerA < layerB
+struct Contact {
+    unsigned int layerA, layerB;
+    int indexA, indexB;
+};
+
+// Structure for the per-tick collision stage. It lives on the stack of
+// stepWorld so rollout threads never share one.
+struct CollisionStage {
+    Collider colliders[MAX_COLLIDERS];
+    int colliderCount;
+    int order[MAX_COLLIDERS]; // Collider indices sorted by minX
+    Contact contacts[MAX_CONTACTS];
+    int contactCount;
+
+    // Bullets are too many to sweep, so everything they can hit goes into
+    // a grid of one-box cells, chained through targetNext
+    Collider targets[MAX_GRID_TARGETS];
+    int targetNext[MAX_GRID_TARGETS];
+    int cellHead[GRID_ROWS * GRID_COLUMNS];
+    int bulletHits[MAX_BULLETS]; // Targets each bullet touches, then where its contacts go
+    bool spent[MAX_BULLETS]; // Bullets used up this tick, despawned after resolving
+};
+
+// Structure for the bullet queries a parallel-for splits between threads
+struct BulletQuery {
+    CollisionStage* stage;
+    const BulletPool* bullets;
+};
+
+// Structure for the sprites used to draw a world
+struct GameSprites {
+    sf::Sprite player;
+    sf::Sprite bullet;
+    sf::Sprite mushroom;
+    sf::Sprite centipede;
+    sf::Sprite chead;
+    sf::Sprite flea;
+    sf::Sprite spider;
+    sf::Sprite scorpion;
+};
+
+// Constants for particles
+const int MAX_PARTICLES = 32768;
+const float PARTICLE_GRAVITY = 400.0f; // Pixels per second squared
+const int PARTICLE_FRAME_SIZE = 32; // Cells in the particle atlas
+const int EXPLOSION_FRAMES = 6;
+const int DEATH_FRAMES = 8;
+
+// Structure for the particle pool, one array per field so the update loops
+// vectorize. Everything is allocated once; live particles are packed at the front.
+struct ParticleSystem {
+    vector<float> posX, posY;
+    vector<float> velX, velY;
+    vector<float> life, lifetime; // Seconds left, seconds at birth
+    vector<float> size;
+    vector<int> row; // Atlas row: 0 explosion, 1 death
+    vector<sf::Vertex> vertices; // Four per particle, rebuilt each frame
+    int count = 0;
+    unsigned int rngState = 1;
+};
+
+// Constants for allocation tracking
+const int MAX_ALLOC_THREADS = 64; // Threads past this share the last slot
+const int MAX_ALLOC_SITES = 48; // Tags per thread; the rest are charged to the last one
+const int GAME_STATES = CONNECTING + 1;
+
+// Structure for allocations charged to one call-site tag
+struct AllocSite {
+    atomic<const char*> tag{nullptr};
+    atomic<long long> allocations{0};
+    atomic<long long> bytes{0};
+};
+
+// Structure for one thread's allocation counters. Every operator new and
+// delete in the process counts into the calling thread's slot. Only that
+// thread writes it (except the shared last slot), so the counts cost no
+// contention, and the main thread sums the slots between frames. Builds
+// without NDEBUG also split them by the innermost AllocScope's tag.
+struct AllocThread {
+    atomic<long long> allocations{0};
+    atomic<long long> frees{0};
+    atomic<long long> bytes{0}; // Requested, as delete is not told the size
+#ifndef NDEBUG
+    AllocSite sites[MAX_ALLOC_SITES];
+    atomic<int> siteCount{0};
+#endif
+};
+
+// Structure for the totals over every thread at one moment
+struct AllocCounts {
+    long long allocations = 0;
+    long long frees = 0;
+    long long bytes = 0;
+};
+
+// Structure for the allocations made during frames in one game state
+struct AllocFrameStats {
+    long long frames = 0;
+    long long allocations = 0;
+    long long bytes = 0;
+    long long allocatingFrames = 0; // Frames that allocated at all
+    long long maxAllocations = 0; // Most in one frame
+};
+
+// Structure for per-frame allocation statistics, charged to the state the
+// frame started in
+struct AllocStats {
+    bool report = false; // Print them on exit
+    int frameState = MENU;
+    AllocCounts frameStart;
+    AllocFrameStats states[GAME_STATES];
+};
+
+// Names the allocations made until it goes out of scope, on this thread
+struct AllocScope {
+    const char* previous;
+    explicit AllocScope(const char* tag);
+    ~AllocScope();
+};
+
+// Subsystems the render statistics are split by
+enum RenderSubsystem {
+    STATS_WORLD,
+    STATS_PARTICLES,
+    STATS_HUD,
+    STATS_MENU,
+    STATS_OVERLAY,
+    STATS_SUBSYSTEMS
+};
+
+// Structure for what the renderer was asked to do
+struct RenderCounts {
+    int drawCalls;
+    long long vertices;
+    int textureSwitches;
+    int blendChanges;
+};
+
+// A thin wrapper over the render target that counts every draw. The drawing
+// functions take a Canvas instead of the window, so nothing reaches the GPU
+// without being counted against the current subsystem.
+struct Canvas {
+    sf::RenderTarget& target;
+    int subsystem = STATS_WORLD;
+    RenderCounts frame[STATS_SUBSYSTEMS] = {}; // The frame being drawn
+    RenderCounts last[STATS_SUBSYSTEMS] = {};  // The last finished frame
+    long long frames = 0;
+    const void* lastTexture = nullptr;
+    sf::BlendMode lastBlend;
+
+    explicit Canvas(sf::RenderTarget& renderTarget) : target(renderTarget) {}
+
+    void draw(const sf::Sprite& sprite, const sf::RenderStates& states = sf::RenderStates::Default);
+    void draw(const sf::Text& text, const sf::RenderStates& states = sf::RenderStates::Default);
+    void draw(const sf::Shape& shape, const sf::RenderStates& states = sf::RenderStates::Default);
+    void draw(const sf::Vertex* vertices, size_t count, sf::PrimitiveType type, const sf::RenderStates& states = sf::RenderStates::Default);
+    void setView(const sf::View& view) { target.setView(view); }
+    const sf::View& getView() const { return target.getView(); }
+    void count(const void* texture, const sf::BlendMode& blend, long long vertices);
+};
+
+// Constants for the HUD
+const int HUD_LINE_LENGTH = 96; // Longest HUD or status line
+const float HUD_MESSAGE_SECONDS = 2.0f; // How long a quick save or load message stays up
+
+// Structure for the texts drawn over a game in play. They are built once and
+// only their strings are rewritten, in place, so drawing them each frame
+// allocates nothing once the font has the glyphs.
+struct HudText {
+    sf::Text score;
+    sf::Text lives;
+    sf::Text level;
+    sf::Text status; // Autopilot or rewind line
+    sf::Text message; // Quick save or load result, for a moment after the key
+    sf::Text opponent; // Netplay line
+    sf::RectangleShape inset; // Frame behind the opponent's field
+    sf::String line; // Scratch with room for HUD_LINE_LENGTH characters
+    sf::Clock messageClock;
+    bool messageShown = false;
+    int shownScore = -1;
+    int shownLives = -1;
+    int shownLevel = -1;
+};
+
+// Structure for the asset cache, keyed by path. Each file is decoded at most
+// once and handed out as a shared handle, so an entry is still in use while
+// anyone outside the cache holds a copy.
+struct ResourceCache {
+    map<string, shared_ptr<sf::Texture>> textures;
+    map<string, shared_ptr<sf::SoundBuffer>> sounds;
+    map<string, shared_ptr<sf::Music>> music;
+    map<string, shared_ptr<sf::Font>> fonts;
+    int loads = 0; // Files actually read
+    int hits = 0;  // Requests served from the cache
+};
+
+// Constants for the render scale
+const int WINDOW_SIZE = 640; // Recommended for 1366x768 (768p) displays.
+const float MIN_RENDER_SCALE = 0.25f;
+const float MAX_RENDER_SCALE = 2.0f;
+const float FRAME_BUDGET = 1.0f / 60; // Seconds per frame before the dynamic scale backs off
+const int SCALE_SAMPLE_FRAMES = 30; // Frames averaged between dynamic scale changes
+
+// Structure for drawing the scene offscreen at an internal resolution. Scale 1
+// is one texel per pixel of the default window. The texture is made once at the
+// largest scale; lower scales only use its top left corner.
+struct RenderScaler {
+    sf::RenderTexture scene;
+    unsigned int textureSize = 0;
+    float maxScale = 1.0f;
+    float scale = 1.0f;
+    bool dynamic = false;
+    sf::Clock frameClock;
+    float frameTimeSum = 0.0f;
+    int frameCount = 0;
+};
+
+// Structure for command-line options
+struct GameOptions {
+    bool netHost = false;
+    bool netJoin = false;
+    string netAddress = "127.0.0.1";
+    unsigned short netPort = 0;
+    int rewindBudgetMB = 8;
+    bool autopilot = false;
+    int botRollouts = 16;
+    int botThreads = 0; // 0 picks one per core
+    int fireRate = 0; // Shots per second while Space is held, 0 for one bullet at a time
+    float timeScale = 1.0f; // Simulation speed relative to real time, outside netplay
+    float renderScale = 1.0f;
+    bool dynamicScale = false;
+    bool resourceReport = false;
+    string renderStatsFile; // CSV of per-frame render counts, empty for none
+    bool checkStats = false; // Cross-check the world counters against a full scan every tick
+    bool checkSystems = false; // Flag systems that write components they did not declare
+    bool leaderboard = false;
+    string leaderboardAddress = "127.0.0.1";
+    unsigned short leaderboardPort = LEADERBOARD_DEFAULT_PORT;
+    string playerName = "Player"; // Name scores are submitted under
+    string recordPath; // .y4m file or PNG prefix to record to, empty for none
+    int recordEvery = 1;
+    string analyticsPath; // Session log to append to, empty for none
+    int simThreads = 1; // Threads one tick's systems run on, 0 picks one per core
+    bool allocReport = false;
+    bool spectators = false;
+    unsigned short spectatorPort = SPECTATOR_DEFAULT_PORT;
+    bool shareWorld = false;
+    string shareWorldName = SHARED_WORLD_DEFAULT_NAME; // Shared-memory object the world is published to
+};
+
+// Constants for netplay
+const unsigned short NET_DEFAULT_PORT = 47800;
+const sf::Uint32 NET_MAGIC = 0x43454e54; // "CENT"
+const int NET_MAX_ROLLBACK = 60; // Ticks of remote state we can rewind (250 ms)
+const int NET_INPUT_HISTORY = 256; // Input ring size, must exceed NET_MAX_ROLLBACK
+const int NET_MAX_INPUTS_PER_PACKET = 64;
+const float NET_TIMEOUT = 5.0f; // Seconds of silence before the peer is dropped
+
+// Netplay message types
+enum NetMessage {
+    NET_HELLO,
+    NET_WELCOME,
+    NET_INPUTS
+};
+
+// Structure for a head-to-head netplay session. Only inputs cross the wire:
+// each side simulates the opponent's world from their inputs, predicting the
+// ones that have not arrived yet and rolling back when a prediction was wrong.
+struct NetSession {
+    bool active = false;
+    bool isHost = false;
+    bool connected = false;
+    bool disconnected = false;
+    sf::UdpSocket socket;
+    sf::IpAddress remoteAddress;
+    unsigned short remotePort = 0;
+    unsigned int seed = 0;
+    int fireRate = 0; // The host's, so both worlds play by the same rules
+    sf::Clock helloClock;
+    sf::Clock lastHeard;
+    sf::Clock sendClock;
+
+    GameWorld remoteWorld;
+    GameWorld snapshots[NET_MAX_ROLLBACK]; // remoteWorld at the start of recent ticks
+    unsigned char localInputs[NET_INPUT_HISTORY];
+    unsigned char remoteInputs[NET_INPUT_HISTORY]; // Confirmed below remoteReceived, predicted above
+    int localTick = 0; // Ticks both worlds have been simulated
+    int remoteReceived = 0; // Remote inputs received so far (always contiguous)
+    int remoteAcked = 0; // Local inputs the peer has confirmed
+    int rollbackFrom = -1; // Earliest mispredicted tick, -1 if none
+
+    // Statistics
+    int rollbacks = 0;
+    int resimulatedTicks = 0;
+    float lastRollbackMicros = 0.0f;
+};
+
+// Constants for snapshots. Bump SNAPSHOT_VERSION whenever GameWorld's layout changes.
+const sf::Uint32 SNAPSHOT_MAGIC = 0x56415343; // "CSAV"
+const sf::Uint32 SNAPSHOT_VERSION = 10;
+const string QUICKSAVE_FILE = "quicksave.bin";
+
+// The rewind buffer diffs the world as an array of 32-bit words, grouped in
+// blocks of 32 so a mostly unchanged world (the mushroom field in particular)
+// costs a few mask bits instead of its full size.
+const int WORLD_WORDS = sizeof(GameWorld) / 4;
+const int WORLD_BLOCKS = (WORLD_WORDS + 31) / 32;
+const int WORLD_TOP_WORDS = (WORLD_BLOCKS + 31) / 32;
+const int REWIND_SPEED = 2; // Ticks undone per tick while rewinding
+const int REWIND_MAX_SECONDS = 600; // Upper bound on history, whatever the budget
+
+static_assert(sizeof(GameWorld) % 4 == 0, "GameWorld must be a whole number of words");
+
+// Location of one delta record in the rewind buffer
+struct RewindEntry {
+    unsigned int offset;
+    unsigned int size;
+};
+
+// Structure for the rewind history: one XOR delta per tick, stored in a ring of
+// words that overwrites the oldest history once the memory budget is reached.
+// XOR deltas undo themselves, so stepping back from the present needs no keyframes.
+struct RewindBuffer {
+    vector<sf::Uint32> data;
+    vector<RewindEntry> entries;
+    int firstEntry = 0;
+    int entryCount = 0;
+    unsigned int writeOffset = 0;
+    sf::Uint32 previous[WORLD_WORDS]; // The world as of the newest record
+    sf::Uint32 scratch[WORLD_WORDS];
+
+    // Statistics
+    long long capturedTicks = 0;
+    long long capturedBytes = 0;
+    long long captureMicros = 0;
+};
+
+// Constants for the autopilot. Each decision tries every action in a number of
+// short rollouts (the action first, then random play) and keeps the best average.
+const int BOT_ACTIONS = 10; // Stand, left, right, up, down, each with and without fire
+const int BOT_DECISION_TICKS = 12; // Ticks an action is held before choosing again
+const int BOT_HORIZON_TICKS = 96; // Length of one rollout
+const float BOT_LIFE_PENALTY = 5000.0f;
+const float ATTRACT_DELAY = 20.0f; // Seconds idle on the menu before the demo starts
+
+// Structure for the autopilot and its rollout workers
+struct Autopilot {
+    bool enabled = false;
+    int rolloutsPerAction = 16;
+    unsigned char input = 0; // Action currently held
+    int ticksLeft = 0;
+    unsigned int rngState = 1;
+
+    // Rollout jobs, shared with the workers
+    vector<thread> workers;
+    mutex lock;
+    condition_variable wake;
+    condition_variable finished;
+    long long generation = 0;
+    bool quit = false;
+    const GameWorld* root = nullptr;
+    unsigned int seed = 0;
+    int jobCount = 0;
+    atomic<int> nextJob{0};
+    atomic<int> doneJobs{0};
+    vector<float> results;
+
+    // Statistics
+    long long rollouts = 0;
+    long long thinkMicros = 0;
+};
+
+// Structure for the connection to the leaderboard daemon. A worker thread does
+// all the socket work, so finishing a game never waits on the network.
+struct LeaderboardClient {
+    bool enabled = false;
+    string address;
+    unsigned short port = 0;
+    string name;
+    thread worker;
+    mutex lock;
+    condition_variable wake;
+    bool quit = false;
+    vector<int> pending; // Scores waiting to be sent
+    atomic<int> rank{0}; // Rank of the last submission, 0 while waiting, -1 if it failed
+};
+
+// Constants for video capture
+const int CAPTURE_BUFFERS = 8; // Pixel buffers, so at most this many frames wait for the writer
+const int CAPTURE_READBACKS = 2; // Frames the GPU may still be copying out
+const int CAPTURE_FPS = 60; // Nominal rate written into .y4m headers
+
+// GPU readbacks can overlap the next frame where pixel buffer objects exist
+#if defined(GL_VERSION_2_1) && !defined(_WIN32)
+#define CAPTURE_ASYNC_READBACK
+#endif
+
+// Structure for one captured frame on its way to disk
+struct CaptureFrame {
+    vector<sf::Uint8> pixels; // RGBA, bottom row first, as OpenGL reads it
+    unsigned int size = 0; // Frames are square, like the scene
+    long long number = 0;
+};
+
+// Structure for a video capture. The main thread only starts readbacks of the
+// presented scene and copies finished ones into a free buffer; a writer thread
+// converts and writes them. When the writer falls behind there is no free
+// buffer, and the frame is dropped rather than waited for.
+struct VideoCapture {
+    bool enabled = false;
+    string path;
+    bool y4m = false; // One .y4m stream, otherwise a numbered PNG per frame
+    int every = 1; // Capture every Nth presented frame
+    long long presented = 0;
+
+    bool asyncReadback = false;
+    GLuint readbacks[CAPTURE_READBACKS] = {};
+    unsigned int readbackCapacity[CAPTURE_READBACKS] = {};
+    long long readbackFrame[CAPTURE_READBACKS]; // Frame being read, -1 if idle
+    unsigned int readbackSize[CAPTURE_READBACKS] = {};
+    int nextReadback = 0;
+
+    CaptureFrame frames[CAPTURE_BUFFERS];
+    thread writer;
+    mutex lock;
+    condition_variable wake;
+    bool quit = false;
+    vector<int> freeFrames;
+    vector<int> queued; // Waiting for the writer, oldest first
+
+    // Statistics
+    long long captured = 0;
+    long long dropped = 0;
+    long long mainMicros = 0; // Main thread time spent capturing
+    atomic<long long> written{0};
+    atomic<long long> writeMicros{0};
+    atomic<long long> skipped{0}; // Frames the writer could not use
+};
+
+// Constants for the session log
+const int ANALYTICS_BUFFERS = 4; // Event blocks, so at most this many wait for the writer
+
+// Structure for one block of session log events, held by column as it is written
+struct AnalyticsEvents {
+    uint32_t tick[ANALYTICS_BLOCK_EVENTS];
+    uint32_t value[ANALYTICS_BLOCK_EVENTS];
+    uint16_t level[ANALYTICS_BLOCK_EVENTS];
+    uint16_t cell[ANALYTICS_BLOCK_EVENTS];
+    uint8_t kind[ANALYTICS_BLOCK_EVENTS];
+    uint8_t subject[ANALYTICS_BLOCK_EVENTS];
+    int count;
+    bool endsSession; // frames holds the histogram of the session that ends with this block
+    uint32_t frames[ANALYTICS_FRAME_BUCKETS];
+};
+
+// Structure for the session log. The main thread appends each event to the
+// columns of the block it holds and hands full blocks to a writer thread, so
+// a tick costs a few stores and the file is only touched off the main thread.
+// When the writer has every block, events are dropped rather than waited for.
+struct AnalyticsLog {
+    bool enabled = false;
+    string path;
+    FILE* file = nullptr; // Written by the writer only
+    unique_ptr<AnalyticsEvents[]> blocks;
+    int current = -1; // Block the main thread is filling
+    thread writer;
+    mutex lock;
+    condition_variable wake;
+    bool quit = false;
+    vector<int> freeBlocks;
+    vector<int> queued; // Waiting for the writer, oldest first
+
+    // The game being played
+    bool inSession = false;
+    int level = 0;
+    unsigned int levelStartTick = 0;
+    uint32_t frames[ANALYTICS_FRAME_BUCKETS] = {};
+
+    // Statistics
+    long long sessions = 0;
+    long long events = 0;
+    long long dropped = 0;
+    atomic<long long> written{0}; // Bytes
+    atomic<long long> writeMicros{0};
+};
+
+// Constants for spectator streaming
+const size_t SPECTATOR_RING_BYTES = 1 << 20; // Messages waiting for the network thread, a power of two
+const size_t SPECTATOR_BACKLOG = 256 << 10; // Unsent bytes a spectator may fall behind by before it skips ahead
+const int SPECTATOR_KEYFRAME_TICKS = 2 * SIM_TICKS_PER_SECOND;
+const int MAX_SPECTATORS = 16;
+static_assert(SPECTATOR_BULLETS == MAX_BULLETS && SPECTATOR_SEGMENTS == CENTIPEDE_LENGTH && SPECTATOR_HEADS == MAX_HEADS &&
+              SPECTATOR_ENEMIES == MAX_ENEMIES && SPECTATOR_MUSHROOMS == MAX_MUSHROOMS, "The spectator view needs a slot for every entity");
+
+// Constants for the shared-memory world
+static_assert(SHARED_BULLETS == MAX_BULLETS && SHARED_SEGMENTS == CENTIPEDE_LENGTH && SHARED_HEADS == MAX_HEADS &&
+              SHARED_ENEMIES == MAX_ENEMIES, "The shared world needs room for every entity");
+static_assert(SHARED_GRID == FIELD_COLUMNS && SHARED_CELL_PIXELS == boxPixelsX && SHARED_CELL_PIXELS == boxPixelsY &&
+              SHARED_FIXED_ONE == FIXED_ONE, "The shared world's grid and positions must match the game's");
+
+// Structure for the world published to shared memory after every tick, for
+// bots and tools on the same machine. Publishing is a copy into the mapping
+// between two sequence bumps, so it never waits on a reader.
+struct SharedWorldExport {
+    bool enabled = false;
+    string name;
+    SharedWorldSegment* segment = nullptr;
+
+    // Statistics
+    long long published = 0; // Ticks
+    long long publishNanos = 0;
+};
+
+// Structure for one spectator, owned by the network thread
+struct SpectatorConnection {
+    unique_ptr<sf::TcpSocket> socket;
+    string address;
+    vector<unsigned char> queue; // Whole messages, sent up to sent
+    size_t sent = 0;
+    size_t messageEnd = 0; // First message boundary at or after sent
+    bool synced = false; // Has had a keyframe since it joined or last fell behind
+    long long bytes = 0;
+    int resyncs = 0;
+    sf::Clock connected;
+};
+
+// Structure for publishing the world to spectators. The main thread diffs
+// each tick against the view spectators already have and writes the message
+// into a single-producer, single-consumer ring; a network thread drains the
+// ring into every spectator's queue and sends whatever their sockets take.
+// Nothing waits on a spectator: a full ring drops the message and the next
+// one is a keyframe, and a spectator too far behind skips to the next keyframe.
+struct SpectatorStream {
+    bool enabled = false;
+    unsigned short port = SPECTATOR_DEFAULT_PORT;
+
+    // Main thread
+    SpectatorView sent; // Where the last message left spectators
+    SpectatorView next;
+    unsigned char message[SPECTATOR_MAX_MESSAGE];
+    int sinceKeyframe = 0;
+    bool resync = true; // The next message must be a keyframe
+
+    // The ring, with the bytes written and read since the start
+    unique_ptr<unsigned char[]> ring;
+    atomic<size_t> head{0};
+    atomic<size_t> tail{0};
+    atomic<bool> keyframeWanted{false}; // A spectator joined or fell behind
+
+    // Network thread
+    thread sender;
+    atomic<bool> quit{false};
+    sf::TcpListener listener;
+    vector<SpectatorConnection> spectators;
+    vector<string> finished; // Report lines of spectators that left
+
+    // Statistics
+    long long messages = 0;
+    long long keyframes = 0;
+    long long dropped = 0; // Messages the ring had no room for
+    long long published = 0; // Bytes
+};
+
+// Structure for high score entries
+struct HighScoreEntry {
+  string name;
+  int score;
+
+  // Default constructor
+  HighScoreEntry() : name(""), score(0) {}
+
+  // Constructor for convenience
+  HighScoreEntry(string n, int s) : name(n), score(s) {}
+
+  // Operator for sorting
+  bool operator<(const HighScoreEntry& other) const {
+    return score > other.score; // Sort in descending order
+  }
+};
+
+// Global variables for high scores
+vector<HighScoreEntry> highScores;
+const string HIGH_SCORE_FILE = "high_scores.txt";
+const int MAX_HIGH_SCORES = 10;
+
+/////////////////////////////////////////////////////////////////////////////
+//                                                                         //
+// Function declarations                                                   //
+//                                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+// Helper functions
+void initializeGame(GameWorld& world, unsigned int seed, int fireRate);
+void initializeGameFromField(GameWorld& world, const MushroomField& field, int fireRate);
+unsigned int nextRandom(unsigned int& state);
+void parseOptions(int argc, char* argv[], GameOptions& options);
+void loadHighScores();
+void saveHighScores(const string& playerName, int score);
+void checkForHighScore(PlayerData& player);
+void shutdownGame(Autopilot& bot, LeaderboardClient& board, VideoCapture& capture, sf::RenderTexture& scene, AnalyticsLog& analytics,
+                  const GameWorld& world, SpectatorStream& spectators, SharedWorldExport& share, JobSystem& jobs, const AllocStats& allocStats);
+
+// Menu functions
+void handleMenuInput(GameState& gameState, sf::RenderWindow& window);
+void drawMenu(Canvas& window, sf::Font& font, const vector<string>& menuOptions, int selectedOption);
+void drawInstructions(Canvas& window, sf::Font& font);
+void drawHighScores(Canvas& window, sf::Font& font);
+void drawGameOver(Canvas& window, sf::Font& font, PlayerData& player);
+void drawPauseMenu(Canvas& window, sf::Font& font);
+
+// Animation functions
+void updateAnimation(Animation& anim, float deltaTime);
+void setupAnimations(PlayerData& player);
+
+// Simulation functions
+unsigned char readPlayerInput(bool fire);
+void stepWorld(GameWorld& world, unsigned char input, JobSystem* jobs);
+
+// Timer functions
+template <int N> void timerReset(TimerWheel<N>& wheel);
+template <int N> unsigned short timerStart(TimerWheel<N>& wheel, unsigned int delay, int subject);
+template <int N> void timerRestart(TimerWheel<N>& wheel, unsigned short timer, unsigned int delay);
+template <int N> void timerStop(TimerWheel<N>& wheel, unsigned short timer);
+template <int N> void timerPause(TimerWheel<N>& wheel, unsigned short timer);
+template <int N> void timerResume(TimerWheel<N>& wheel, unsigned short timer);
+template <int N> int timerAdvance(TimerWheel<N>& wheel, unsigned short expired[]);
+template <int N> void timerLink(TimerWheel<N>& wheel, unsigned short timer);
+template <int N> void timerUnlink(TimerWheel<N>& wheel, unsigned short timer);
+
+// System functions
+void systemInvulnerability(GameWorld& world, unsigned char input, JobSystem* jobs);
+void systemFire(GameWorld& world, unsigned char input, JobSystem* jobs);
+void systemMovePlayer(GameWorld& world, unsigned char input, JobSystem* jobs);
+void systemMoveCentipede(GameWorld& world, unsigned char input, JobSystem* jobs);
+void systemHeads(GameWorld& world, unsigned char input, JobSystem* jobs);
+void systemFlowField(GameWorld& world, unsigned char input, JobSystem* jobs);
+void systemEnemies(GameWorld& world, unsigned char input, JobSystem* jobs);
+void systemMoveBullets(GameWorld& world, unsigned char input, JobSystem* jobs);
+void systemCollisions(GameWorld& world, unsigned char input, JobSystem* jobs);
+void systemPoison(GameWorld& world, unsigned char input, JobSystem* jobs);
+void systemNextLevel(GameWorld& world, unsigned char input, JobSystem* jobs);
+void systemExtraLives(GameWorld& world, unsigned char input, JobSystem* jobs);
+void buildSchedule(const WorldSystem systems[], int count, WorldSchedule& schedule);
+const WorldSchedule& worldSchedule();
+void runSystemJob(void* context, int system, int end);
+void printSchedule();
+bool checkSystemAccess(const GameWorld& world, unsigned char input);
+void drawWorld(Canvas& window, GameWorld& world, GameSprites& sprites, sf::Texture& mushTexture, float deltaTime);
+
+// World statistics functions
+bool inPlayerZone(Fixed posY);
+int nextLifeThreshold(int score);
+WorldStats countWorldStats(const GameWorld& world);
+bool checkWorldStats(const GameWorld& world);
+
+// Collision functions
+void addCollider(CollisionStage& stage, Fixed posX, Fixed posY, unsigned int layer, unsigned int mask, int index);
+void gatherColliders(CollisionStage& stage, GameWorld& world);
+void sweepAndPrune(CollisionStage& stage);
+void addGridTarget(CollisionStage& stage, Fixed posX, Fixed posY, unsigned int layer, int index);
+void collideBullets(CollisionStage& stage, GameWorld& world, JobSystem* jobs);
+int bulletContacts(const CollisionStage& stage, const BulletPool& bullets, int b, Contact out[], int room);
+void countBulletContacts(void* context, int begin, int end);
+void writeBulletContacts(void* context, int begin, int end);
+void resolveContacts(CollisionStage& stage, GameWorld& world);
+
+// Overlap functions
+int overlapScanScalar(Fixed boxX, Fixed boxY, const Fixed xs[], const Fixed ys[], int from, int count, unsigned int mask[]);
+#ifdef OVERLAP_X86
+int overlapScanSSE2(Fixed boxX, Fixed boxY, const Fixed xs[], const Fixed ys[], int from, int count, unsigned int mask[]);
+int overlapScanAVX2(Fixed boxX, Fixed boxY, const Fixed xs[], const Fixed ys[], int from, int count, unsigned int mask[]);
+bool cpuHasAVX2();
+#endif
+bool cpuAlways();
+const OverlapKernel& overlapKernel();
+int firstOverlap(Fixed boxX, Fixed boxY, const Fixed xs[], const Fixed ys[], int from, int count);
+int overlapMask(Fixed boxX, Fixed boxY, const Fixed xs[], const Fixed ys[], int count, unsigned int mask[]);
+
+// Gameplay functions
+void drawPlayer(Canvas& window, PlayerData& player, sf::Sprite& playerSprite, float deltaTime);
+bool spawnBullet(BulletPool& bullets, Fixed posX, Fixed posY);
+void despawnBullet(BulletPool& bullets, int i);
+void moveBullets(BulletPool& bullets);
+void bulletxmushroom(int i, Fixed mush[][6], WorldStats& stats, int& score);
+void drawBullets(Canvas& window, BulletPool& bullets, sf::Sprite& bulletSprite);
+void movePlayer(PlayerData& player, bool moveLeft, bool moveRight, bool moveUp, bool moveDown, Fixed playerSpeed, Fixed mush[][6], const MushroomBoxes& boxes, int nmush);
+bool addMushroom(Fixed mush[][6], MushroomBoxes& boxes, int& nmush, WorldStats& stats, Fixed posX, Fixed posY, bool poisonous);
+void removeMushroom(Fixed mush[][6], int i, WorldStats& stats);
+void mushrooms(Canvas& window, Fixed mush[][6], sf::Sprite& mushSprite, sf::Texture& mushTexture, int nmush);
+void moveCentipede(int centipedeLength, Fixed centipede[][10], Fixed mush[][6], const MushroomBoxes& boxes, int nmush, bool& down);
+void drawCentipede(Canvas& window, sf::Sprite& centipedeSprite, sf::Sprite& cheadSprite, int centipedeLength, Fixed centipede[][10], int i, float deltaTime);
+bool mushroomxcentipede(int centipedeLength, Fixed centipede[][10], Fixed mush[][6], const MushroomBoxes& boxes, int nmush, int i);
+void bulletxcentipede(int i, int centipedeLength, Fixed centipede[][10], Fixed mush[][6], MushroomBoxes& boxes, int& nmush, WorldStats& stats, unsigned int& events, int& score);
+void MakingHeads(int& h, Fixed centipedeheads[][10], Fixed centipede[][10], TimerWheel<HEAD_TIMERS>& timers, unsigned short headTimer, Fixed mush[][6], const MushroomBoxes& boxes, int nmush, WorldStats& stats, bool& hdown);
+void drawHeads(Canvas& window, Fixed centipedeheads[][10], sf::Sprite& cheadSprite);
+void bulletxhead(int i, Fixed centipedeheads[][10], Fixed mush[][6], MushroomBoxes& boxes, int& nmush, WorldStats& stats, unsigned int& events, int& score);
+void isPlayerhit(PlayerData& player, Fixed mush[][6], const MushroomBoxes& boxes, int nmush, unsigned int& events, TickRecords& records);
+void playerHit(PlayerData& player, unsigned int& events, TickRecords& records, int killer);
+void nextLevel(int& centipedeLength, Fixed centipede[][10], Fixed mush[][6], int nmush, EnemyPool& enemies, int& score,
+              int startColumn, int startRow, int& level, Fixed centipedeheads[][10], WorldStats& stats, unsigned int& events);
+void hudInit(HudText& hud, sf::Font& font);
+void setTextLine(sf::Text& text, sf::String& line, const char* chars);
+void drawHUD(Canvas& window, HudText& hud, PlayerData& player, int level);
+void showHudMessage(HudText& hud, const char* chars);
+void drawHudMessage(Canvas& window, HudText& hud);
+
+// Render statistics functions
+void beginRenderFrame(Canvas& canvas);
+RenderCounts totalCounts(const RenderCounts counts[STATS_SUBSYSTEMS]);
+void writeRenderStats(ofstream& file, Canvas& canvas);
+void drawRenderStats(Canvas& window, sf::Font& font);
+
+// Resource functions
+shared_ptr<sf::Texture> cachedTexture(ResourceCache& cache, const string& path);
+shared_ptr<sf::SoundBuffer> cachedSound(ResourceCache& cache, const string& path);
+shared_ptr<sf::Music> cachedMusic(ResourceCache& cache, const string& path);
+shared_ptr<sf::Font> cachedFont(ResourceCache& cache, const string& path);
+shared_ptr<sf::Texture> loadSprites(ResourceCache& cache, GameSprites& sprites);
+long long fileSize(const string& path);
+void printResourceReport(const ResourceCache& cache);
+void playMusic(sf::Music& music, bool& onMenu, bool menu);
+
+// Render scale functions
+bool renderScalerInit(RenderScaler& scaler, float scale, bool dynamic);
+void applyRenderScale(RenderScaler& scaler);
+void presentScene(sf::RenderWindow& window, RenderScaler& scaler, VideoCapture& capture);
+
+// Particle functions
+void addBurst(GameWorld& world, Fixed posX, Fixed posY, int kind);
+bool buildParticleAtlas(sf::Texture& atlas);
+void particlesInit(ParticleSystem& particles, unsigned int seed);
+void emitBurst(ParticleSystem& particles, float posX, float posY, int kind);
+void emitWorldBursts(ParticleSystem& particles, const GameWorld& world);
+void updateParticles(ParticleSystem& particles, float deltaTime);
+void drawParticles(Canvas& window, ParticleSystem& particles, sf::Texture& atlas);
+
+// Allocation functions
+AllocThread& allocThread();
+void countAllocation(size_t bytes);
+AllocCounts allocTotals();
+void allocFrameBegin(AllocStats& stats, int state);
+long long allocFrameEnd(AllocStats& stats);
+void resetAllocSites();
+void printAllocSites();
+void printAllocReport(const AllocStats& stats);
+
+// Snapshot and rewind functions
+bool saveSnapshot(const GameWorld& world, const string& path);
+bool loadSnapshot(GameWorld& world, const string& path);
+void rewindInit(RewindBuffer& rewind, int budgetMB);
+void rewindReset(RewindBuffer& rewind, const GameWorld& world);
+void rewindCapture(RewindBuffer& rewind, const GameWorld& world);
+bool rewindStep(RewindBuffer& rewind, GameWorld& world);
+void drawRewindStatus(Canvas& window, HudText& hud, RewindBuffer& rewind);
+
+// Autopilot functions
+void autopilotStart(Autopilot& bot, int rolloutsPerAction, int threads);
+void autopilotStop(Autopilot& bot);
+unsigned char autopilotInput(Autopilot& bot, const GameWorld& world);
+void autopilotDecide(Autopilot& bot, const GameWorld& world);
+void autopilotWorker(Autopilot* bot);
+void autopilotRunJobs(Autopilot& bot);
+float autopilotRollout(GameWorld& world, int action, unsigned int& rng);
+unsigned char autopilotActionInput(int action);
+void drawAutopilotStatus(Canvas& window, HudText& hud, Autopilot& bot, bool attractMode);
+
+// Enemy functions
+Enemy* spawnEnemy(EnemyPool& enemies, int kind, Fixed posX, Fixed posY);
+void resetEnemies(EnemyPool& enemies);
+void updateEnemies(EnemyPool& enemies, const FlowField& flow, Fixed mush[][6], MushroomBoxes& boxes, int& nmush, WorldStats& stats, TickRecords& records);
+bool fleaBehavior(Enemy& e, Fixed mush[][6], MushroomBoxes& boxes, int& nmush, WorldStats& stats);
+bool spiderBehavior(Enemy& e, const FlowField& flow, Fixed mush[][6], const MushroomBoxes& boxes, int nmush, WorldStats& stats);
+bool scorpionBehavior(Enemy& e, Fixed mush[][6], const MushroomBoxes& boxes, int nmush, WorldStats& stats, TickRecords& records);
+void bulletxspider(Enemy& spider, PlayerData& player);
+void playerxspider(EnemyPool& enemies, PlayerData& player, unsigned int& events, TickRecords& records);
+void bulletxscorpion(Enemy& scorpion, PlayerData& player);
+void drawEnemies(Canvas& window, EnemyPool& enemies, GameSprites& sprites);
+void drawFlea(Canvas& window, const Enemy& flea, sf::Sprite& fleaSprite);
+void drawSpider(Canvas& window, const Enemy& spider, sf::Sprite& spiderSprite);
+void drawScorpion(Canvas& window, const Enemy& scorpion, sf::Sprite& scorpionSprite);
+
+// Netplay functions
+bool netplayStart(NetSession& net, const GameOptions& options);
+void netplayStop(NetSession& net);
+void netplayPoll(NetSession& net);
+void netplaySend(NetSession& net);
+bool netplayCanAdvance(const NetSession& net);
+void netplayAdvance(NetSession& net, unsigned char localInput);
+void netplayRollback(NetSession& net);
+void drawNetplayStatus(Canvas& window, HudText& hud, NetSession& net, GameSprites& sprites, sf::Texture& mushTexture);
+
+// Leaderboard functions
+void leaderboardStart(LeaderboardClient& board, const GameOptions& options);
+void leaderboardStop(LeaderboardClient& board);
+void leaderboardSubmit(LeaderboardClient& board, int score);
+void leaderboardWorker(LeaderboardClient* board);
+void drawLeaderboardStatus(Canvas& window, sf::Font& font, LeaderboardClient& board);
+
+// Capture functions
+bool captureStart(VideoCapture& capture, sf::RenderTexture& source, const string& path, int every);
+void captureStop(VideoCapture& capture, sf::RenderTexture& source);
+void captureFrame(VideoCapture& capture, sf::RenderTexture& source, unsigned int size);
+void captureCollect(VideoCapture& capture, int slot);
+int captureTakeBuffer(VideoCapture& capture);
+void captureQueue(VideoCapture& capture, int buffer, unsigned int size, long long number);
+void captureWriter(VideoCapture* capture);
+bool writeCapturePNG(const CaptureFrame& frame, const string& prefix, vector<sf::Uint8>& scratch);
+void writeCaptureY4M(const CaptureFrame& frame, FILE* video, unsigned int videoSize, vector<sf::Uint8>& scratch);
+void printCaptureReport(const VideoCapture& capture);
+
+// Job functions
+void jobsStart(JobSystem& jobs, int threads);
+void jobsStop(JobSystem& jobs);
+void jobsPush(JobSystem& jobs, const Job& job);
+bool jobsRunOne(JobSystem& jobs, int self);
+void jobsWait(JobSystem& jobs, atomic<int>& pending);
+void jobsWorker(JobSystem* jobs, int self);
+void parallelFor(JobSystem* jobs, int count, int grain, void (*run)(void* context, int begin, int end), void* context);
+
+// Analytics functions
+void addRecord(TickRecords& records, int kind, int subject, Fixed posX, Fixed posY);
+bool analyticsStart(AnalyticsLog& log, const string& path);
+void analyticsStop(AnalyticsLog& log, const GameWorld& world);
+void analyticsBeginSession(AnalyticsLog& log, const GameWorld& world, bool autopilot);
+void analyticsEndSession(AnalyticsLog& log, const GameWorld& world);
+void analyticsTick(AnalyticsLog& log, const GameWorld& world);
+void analyticsFrame(AnalyticsLog& log, float deltaTime);
+void analyticsAppend(AnalyticsLog& log, const GameWorld& world, int kind, int subject, int cell, uint32_t value);
+void analyticsHandOff(AnalyticsLog& log);
+void analyticsWriter(AnalyticsLog* log);
+size_t writeAnalyticsBlocks(const AnalyticsEvents& block, FILE* file);
+void printAnalyticsReport(const AnalyticsLog& log);
+
+// Spectator functions
+bool spectatorStart(SpectatorStream& stream, unsigned short port);
+void spectatorStop(SpectatorStream& stream);
+void buildSpectatorView(const GameWorld& world, SpectatorView& view);
+unsigned char* putSlotUpdate(unsigned char* out, int slot, const SpectatorSlot& from, const SpectatorSlot& to);
+size_t encodeSpectatorKeyframe(const SpectatorView& view, unsigned char* out);
+size_t encodeSpectatorDelta(const SpectatorView& from, const SpectatorView& to, unsigned char* out);
+void spectatorPublish(SpectatorStream& stream, const GameWorld& world);
+bool spectatorRingPush(SpectatorStream& stream, const unsigned char* data, size_t size);
+void spectatorSender(SpectatorStream* stream);
+void queueSpectatorMessage(SpectatorStream& stream, SpectatorConnection& spectator, const unsigned char* data, size_t size);
+bool sendToSpectator(SpectatorConnection& spectator);
+string spectatorReportLine(const SpectatorConnection& spectator);
+void printSpectatorReport(const SpectatorStream& stream);
+
+// Shared world functions
+bool sharedWorldStart(SharedWorldExport& share, const string& name);
+void sharedWorldStop(SharedWorldExport& share);
+void sharedWorldPublish(SharedWorldExport& share, const GameWorld& world);
+SharedEntity sharedEntity(Fixed posX, Fixed posY, int kind, int flags, int value);
+
+// Mushroom field functions
+void generateMushroomField(MushroomField& field, unsigned int seed, const FieldSpec& spec);
+void buildFieldLibrary(FieldLibrary& library, unsigned int firstSeed, const FieldSpec& spec);
+const MushroomField& fieldForSeed(FieldLibrary& library, unsigned int seed);
+const MushroomField& nextLibraryField(FieldLibrary& library);
+int checkMushroomField(const MushroomField& field, const FieldSpec& spec);
+
+// Flow field functions
+int updateFlowField(FlowField& flow, const PlayerData& player, const Fixed mush[][6], int nmush);
+void rebuildFlowField(FlowField& flow);
+void repairFlowField(FlowField& flow, int cell);
+void relaxFlowField(FlowField& flow, unsigned short buckets[FLOW_BUCKETS][FLOW_CELLS], int counts[FLOW_BUCKETS], int cost);
+int flowCellCost(const FlowField& flow, int cell);
+int flowStep(const FlowField& flow, Fixed posX, Fixed posY);
+bool checkFlowField(const FlowField& flow);
+
+// Bench.cpp builds the game in without its main, for the headless benchmarks and checks
+#ifndef CENTIPEDE_NO_MAIN
+int main(int argc, char* argv[]) {
+    // Read command-line options
+    GameOptions options;
+    parseOptions(argc, argv, options);
+    if (options.checkSystems) {
+        printSchedule();
+    }
+
+    // Initialize game state
+    GameState gameState = MENU;
+
+    // Declaring RenderWindow.
+    sf::RenderWindow window(sf::VideoMode(WINDOW_SIZE, WINDOW_SIZE), "Centipede", sf::Style::Close | sf::Style::Titlebar | sf::Style::Resize);
+    window.setPosition(sf::Vector2i(100, 0));
+
+    // Everything is drawn offscreen at the internal scale, then blitted to the window once
+    RenderScaler scaler;
+    if (!renderScalerInit(scaler, options.renderScale, options.dynamicScale)) {
+        cerr << "Could not create the offscreen render target" << endl;
+        return 1;
+    }
+    sf::RenderTexture& scene = scaler.scene;
+
+    // Presented frames go to disk from a writer thread while recording
+    VideoCapture capture;
+    if (!options.recordPath.empty() && !captureStart(capture, scene, options.recordPath, options.recordEvery)) {
+        cerr << "Could not start recording to " << options.recordPath << endl;
+    }
+
+    // The local world's ticks run on the job system; rollouts and the
+    // opponent's world keep to the thread that steps them
+    JobSystem jobs;
+    jobsStart(jobs, options.simThreads);
+
+    // Every game's events go to the session log from a writer thread
+    AnalyticsLog analytics;
+    if (!options.analyticsPath.empty() && !analyticsStart(analytics, options.analyticsPath)) {
+        cerr << "Could not open the session log " << options.analyticsPath << endl;
+    }
+
+    // Spectators get the world from a network thread
+    SpectatorStream spectators;
+    if (options.spectators && !spectatorStart(spectators, options.spectatorPort)) {
+        cerr << "Could not listen for spectators on port " << options.spectatorPort << endl;
+    }
+
+    // Tools on this machine read the world straight from shared memory
+    SharedWorldExport share;
+    if (options.shareWorld && !sharedWorldStart(share, options.shareWorldName)) {
+        cerr << "Could not share the world as " << options.shareWorldName << endl;
+    }
+
+    // Every draw goes through the canvas so it can be counted (F3 shows the counts)
+    Canvas canvas(scene);
+    bool showRenderStats = false;
+    ofstream renderStatsFile;
+    if (!options.renderStatsFile.empty()) {
+        renderStatsFile.open(options.renderStatsFile);
+        renderStatsFile << "frame,subsystem,draw_calls,vertices,texture_switches,blend_changes" << endl;
+    }
+
+    // Clock for timing
+    sf::Clock gameClock;
+    float deltaTime;
+    float tickAccumulator = 0.0f;
+    bool fireRequested = false;
+
+    // Every asset comes through the cache, so a file shared by two uses is read once
+    ResourceCache resources;
+
+    // Initializing Background Music. Menu and game play the same song from one stream.
+    shared_ptr<sf::Music> music = cachedMusic(resources, "Music/field_of_hopes.ogg");
+    bool musicOnMenu = true;
+    music->setLoop(true);
+    music->setVolume(50);
+    music->play();
+
+    // Sound effects
+    shared_ptr<sf::SoundBuffer> bulletSoundBuffer = cachedSound(resources, "Sound Effects/fire1.wav");
+    sf::Sound bulletSound;
+    bulletSound.setBuffer(*bulletSoundBuffer);
+
+    shared_ptr<sf::SoundBuffer> playerdiedBuffer = cachedSound(resources, "Sound Effects/death.wav");
+    sf::Sound playerdiedSound;
+    playerdiedSound.setBuffer(*playerdiedBuffer);
+
+    shared_ptr<sf::SoundBuffer> killBuffer = cachedSound(resources, "Sound Effects/death.wav");
+    sf::Sound killSound;
+    killSound.setBuffer(*killBuffer);
+
+    shared_ptr<sf::SoundBuffer> levelupBuffer = cachedSound(resources, "Sound Effects/1up.wav");
+    sf::Sound levelupSound;
+    levelupSound.setBuffer(*levelupBuffer);
+
+    shared_ptr<sf::SoundBuffer> hitBuffer = cachedSound(resources, "Sound Effects/kill.wav");
+    sf::Sound hitSound;
+    hitSound.setBuffer(*hitBuffer);
+
+    shared_ptr<sf::SoundBuffer> menuSelectBuffer = cachedSound(resources, "Sound Effects/newBeat.wav");
+    sf::Sound menuSelectSound;
+    menuSelectSound.setBuffer(*menuSelectBuffer);
+
+    // Initializing Background.
+    shared_ptr<sf::Texture> backgroundTexture = cachedTexture(resources, "Textures/orange_forest.png");
+    sf::Sprite backgroundSprite;
+    backgroundSprite.setTexture(*backgroundTexture);
+    backgroundSprite.setColor(sf::Color(255, 255, 255, 255 * 0.20)); // Reduces Opacity to 20%
+
+    // Menu background
+    shared_ptr<sf::Texture> menuBackgroundTexture = cachedTexture(resources, "Textures/menu_background.png");
+    sf::Sprite menuBackgroundSprite;
+    menuBackgroundSprite.setTexture(*menuBackgroundTexture);
+
+    // Menu options
+    vector<string> menuOptions = {"Play Game", "Instructions", "High Scores", "Exit"};
+    int selectedOption = 0;
+
+    // Font loading
+    shared_ptr<sf::Font> fontHandle = cachedFont(resources, "/usr/share/fonts/truetype/freefont/FreeMonoBold.ttf");
+    sf::Font& font = *fontHandle;
+    HudText hud;
+    hudInit(hud, font);
+
+    // Load high scores
+    loadHighScores();
+
+    // The whole gameplay state lives in one world
+    GameWorld world;
+    GameSprites sprites;
+    shared_ptr<sf::Texture> mushHandle = loadSprites(resources, sprites);
+    sf::Texture& mushTexture = *mushHandle;
+
+    // Particle effects, drawn from one atlas of the explosion and death sheets
+    sf::Texture particleTexture;
+    buildParticleAtlas(particleTexture);
+    ParticleSystem particles;
+    particlesInit(particles, time(0));
+    if (options.resourceReport) {
+        printResourceReport(resources);
+    }
+
+    // Draw the next games' fields up front, then start the first on one
+    FieldLibrary fieldLibrary;
+    buildFieldLibrary(fieldLibrary, time(0), DEFAULT_FIELD_SPEC);
+    initializeGameFromField(world, nextLibraryField(fieldLibrary), options.fireRate);
+
+    // Rewind history and the quick save slot
+    RewindBuffer rewind;
+    rewindInit(rewind, options.rewindBudgetMB);
+    rewindReset(rewind, world);
+    GameWorld quickSave;
+    bool hasQuickSave = false;
+
+    // Autopilot, for --autopilot and the attract-mode demo
+    Autopilot bot;
+
+    // Finished games go to the leaderboard daemon in the background
+    LeaderboardClient board;
+    if (options.leaderboard) {
+        leaderboardStart(board, options);
+    }
+    bool attractMode = false;
+    sf::Clock menuIdleClock;
+    if (options.autopilot) {
+        autopilotStart(bot, options.botRollouts, options.botThreads);
+    }
+
+    // Netplay skips the menu and starts as soon as the opponent is found
+    NetSession netplay;
+    if (options.netHost || options.netJoin) {
+        if (netplayStart(netplay, options)) {
+            gameState = CONNECTING;
+        }
+    }
+
+    // Allocations made during each frame, by game state
+    AllocStats allocStats;
+    allocStats.report = options.allocReport;
+
+    // Main game loop
+    while (window.isOpen()) {
+        // Calculate delta time
+        deltaTime = gameClock.restart().asSeconds();
+        allocFrameBegin(allocStats, gameState);
+
+        // Handle events
+        AllocScope eventScope("events");
+        sf::Event e;
+        while (window.pollEvent(e)) {
+            if (e.type == sf::Event::Closed) {
+                window.close();
+                shutdownGame(bot, board, capture, scene, analytics, world, spectators, share, jobs, allocStats);
+                return 0;
+            }
+
+            if (e.type == sf::Event::KeyPressed && e.key.code == sf::Keyboard::F3) {
+                showRenderStats = !showRenderStats;
+                continue;
+            }
+
+            // Any key ends the demo
+            if (e.type == sf::Event::KeyPressed && attractMode) {
+                analyticsEndSession(analytics, world);
+                attractMode = false;
+                gameState = MENU;
+                menuIdleClock.restart();
+                continue;
+            }
+
+            // Handle key presses
+            if (e.type == sf::Event::KeyPressed) {
+                if (gameState == MENU) {
+                    menuIdleClock.restart();
+                    // Menu controls
+                    if (e.key.code == sf::Keyboard::Up) {
+                        selectedOption = (selectedOption - 1 + menuOptions.size()) % menuOptions.size();
+                        menuSelectSound.play();
+                    }
+                    else if (e.key.code == sf::Keyboard::Down) {
+                        selectedOption = (selectedOption + 1) % menuOptions.size();
+                        menuSelectSound.play();
+                    }
+                    else if (e.key.code == sf::Keyboard::Return) {
+                        menuSelectSound.play();
+                        switch (selectedOption) {
+                            case 0: // Play
+                                gameState = PLAYING;
+                                playMusic(*music, musicOnMenu, false);
+                                // Reset game state for a new game
+                                initializeGameFromField(world, nextLibraryField(fieldLibrary), options.fireRate);
+                                rewindReset(rewind, world);
+                                analyticsBeginSession(analytics, world, options.autopilot);
+                                tickAccumulator = 0.0f;
+                                break;
+                            case 1: // Instructions
+                                gameState = INSTRUCTIONS;
+                                break;
+                            case 2: // High Scores
+                                gameState = HIGH_SCORES;
+                                break;
+                            case 3: // Exit
+                                window.close();
+                                shutdownGame(bot, board, capture, scene, analytics, world, spectators, share, jobs, allocStats);
+                                return 0;
+                        }
+                    }
+                }
+                else if (gameState == PLAYING) {
+                    // In-game controls
+                    if (e.key.code == sf::Keyboard::Space) {
+                        // Fired on the next tick if the gun is ready
+                        fireRequested = true;
+                    }
+                    else if (netplay.active) {
+                        // The opponent cannot be paused, and our world cannot be rewritten
+                    }
+                    else if (e.key.code == sf::Keyboard::F5) {
+                        // Quick save to memory and to disk
+                        sf::Clock saveClock;
+                        quickSave = world;
+                        hasQuickSave = true;
+                        float micros = saveClock.getElapsedTime().asMicroseconds();
+                        bool written = saveSnapshot(world, QUICKSAVE_FILE);
+                        char message[HUD_LINE_LENGTH];
+                        snprintf(message, sizeof(message), "Quick saved in %d us%s", (int) micros, written ? "" : " (disk write failed)");
+                        showHudMessage(hud, message);
+                    }
+                    else if (e.key.code == sf::Keyboard::F9) {
+                        // Quick load, falling back to the file from an earlier session
+                        sf::Clock loadClock;
+                        bool loaded = hasQuickSave;
+                        if (hasQuickSave) {
+                            world = quickSave;
+                        } else {
+                            loaded = loadSnapshot(world, QUICKSAVE_FILE);
+                        }
+                        float micros = loadClock.getElapsedTime().asMicroseconds();
+                        char message[HUD_LINE_LENGTH];
+                        if (loaded) {
+                            rewindReset(rewind, world);
+                            snprintf(message, sizeof(message), "Quick loaded in %d us", (int) micros);
+                        } else {
+                            snprintf(message, sizeof(message), "No quick save");
+                        }
+                        showHudMessage(hud, message);
+                    }
+                    else if (e.key.code == sf::Keyboard::Escape) {
+                        gameState = PAUSED;
+                        music->pause();
+                    }
+                    else if (e.key.code == sf::Keyboard::P) {
+                        gameState = PAUSED;
+                        music->pause();
+                    }
+                }
+                else if (gameState == PAUSED) {
+                    if (e.key.code == sf::Keyboard::Escape || e.key.code == sf::Keyboard::P) {
+                        gameState = PLAYING;
+                        playMusic(*music, musicOnMenu, false);
+                    }
+                }
+                else if (gameState == CONNECTING) {
+                    if (e.key.code == sf::Keyboard::Escape) {
+                        netplayStop(netplay);
+                        gameState = MENU;
+                    }
+                }
+                else if (gameState == GAME_OVER || gameState == INSTRUCTIONS || gameState == HIGH_SCORES) {
+                    if (e.key.code == sf::Keyboard::Escape) {
+                        gameState = MENU;
+                        netplayStop(netplay);
+                        playMusic(*music, musicOnMenu, true);
+                    }
+                    else if (e.key.code == sf::Keyboard::Return && gameState == GAME_OVER) {
+                        // Check for high score and save if needed
+                        checkForHighScore(world.player);
+                        gameState = MENU;
+                        netplayStop(netplay);
+                        playMusic(*music, musicOnMenu, true);
+                    }
+                }
+            }
+        }
+
+        // Exchange inputs with the opponent and repair mispredictions
+        AllocScope simulationScope("simulation");
+        if (netplay.active) {
+            netplayPoll(netplay);
+            if (gameState == CONNECTING && netplay.connected) {
+                initializeGame(world, netplay.seed, netplay.fireRate);
+                initializeGame(netplay.remoteWorld, netplay.seed, netplay.fireRate);
+                rewindReset(rewind, world);
+                analyticsBeginSession(analytics, world, options.autopilot);
+                tickAccumulator = 0.0f;
+                gameState = PLAYING;
+                playMusic(*music, musicOnMenu, false);
+            }
+            netplayRollback(netplay);
+        }
+
+        // Advance the simulation in fixed ticks. A netplay game keeps ticking on
+        // the game over screen so the opponent is never left waiting for inputs.
+        if (gameState == PLAYING || (gameState == GAME_OVER && netplay.connected)) {
+            // Every gameplay timer counts ticks, so scaling time here scales them all
+            tickAccumulator += netplay.active ? deltaTime : deltaTime * options.timeScale;
+            int ticks = 0;
+            unsigned int frameEvents = 0;
+            bool rewinding = gameState == PLAYING && !netplay.active && sf::Keyboard::isKeyPressed(sf::Keyboard::R);
+            while (tickAccumulator >= SIM_TICK_TIME && ticks < MAX_TICKS_PER_FRAME) {
+                if (netplay.active && !netplayCanAdvance(netplay))
+                    break; // Too far ahead of the opponent, wait for their inputs
+
+                if (rewinding) {
+                    // Holding R plays history backwards
+                    for (int i = 0; i < REWIND_SPEED; i++) {
+                        rewindStep(rewind, world);
+                    }
+                    spectatorPublish(spectators, world);
+                    sharedWorldPublish(share, world);
+                    tickAccumulator -= SIM_TICK_TIME;
+                    ticks++;
+                    continue;
+                }
+
+                unsigned char input = 0;
+                if (gameState == PLAYING && (attractMode || options.autopilot)) {
+                    input = autopilotInput(bot, world);
+                }
+                else if (gameState == PLAYING) {
+                    // With a fire rate set, holding Space keeps firing
+                    bool held = world.fireInterval > 0 && sf::Keyboard::isKeyPressed(sf::Keyboard::Space);
+                    input = readPlayerInput(fireRequested || held);
+                    fireRequested = false;
+                }
+                if (options.checkSystems) {
+                    checkSystemAccess(world, input);
+                }
+                stepWorld(world, input, &jobs);
+                if (options.checkStats) {
+                    checkWorldStats(world);
+                }
+                rewindCapture(rewind, world);
+                frameEvents |= world.events;
+                emitWorldBursts(particles, world);
+                analyticsTick(analytics, world);
+                spectatorPublish(spectators, world);
+                sharedWorldPublish(share, world);
+                if (netplay.active) {
+                    netplayAdvance(netplay, input);
+                }
+                tickAccumulator -= SIM_TICK_TIME;
+                ticks++;
+            }
+            if (tickAccumulator > MAX_TICKS_PER_FRAME * SIM_TICK_TIME) {
+                tickAccumulator = MAX_TICKS_PER_FRAME * SIM_TICK_TIME;
+            }
+            if (netplay.active) {
+                netplaySend(netplay);
+            }
+
+            // Play the sounds for what happened this frame
+            if (frameEvents & EVENT_FIRE)
+                bulletSound.play();
+            if (frameEvents & EVENT_KILL)
+                killSound.play();
+            if (frameEvents & EVENT_HIT)
+                hitSound.play();
+            if (frameEvents & EVENT_LEVEL_UP)
+                levelupSound.play();
+            if (gameState == PLAYING)
+                analyticsFrame(analytics, deltaTime);
+        }
+
+        // Clear the window
+        AllocScope drawScope("draw");
+        scene.clear(sf::Color(0, 0, 0));
+        beginRenderFrame(canvas);
+        canvas.subsystem = STATS_MENU;
+
+        // Game state machine
+        switch (gameState) {
+            case MENU:
+                canvas.draw(menuBackgroundSprite);
+                drawMenu(canvas, font, menuOptions, selectedOption);
+
+                // Start the demo after sitting idle on the menu
+                if (menuIdleClock.getElapsedTime().asSeconds() > ATTRACT_DELAY) {
+                    autopilotStart(bot, options.botRollouts, options.botThreads);
+                    initializeGameFromField(world, nextLibraryField(fieldLibrary), options.fireRate);
+                    rewindReset(rewind, world);
+                    analyticsBeginSession(analytics, world, true);
+                    tickAccumulator = 0.0f;
+                    attractMode = true;
+                    gameState = PLAYING;
+                }
+                break;
+
+            case PLAYING: {
+                // Draw background
+                canvas.subsystem = STATS_WORLD;
+                canvas.draw(backgroundSprite);
+
+                // Check if player is still alive
+                if (world.player.lives <= 0) {
+                    analyticsEndSession(analytics, world);
+                }
+                if (world.player.lives <= 0 && attractMode) {
+                    attractMode = false;
+                    gameState = MENU;
+                    menuIdleClock.restart();
+                    break;
+                }
+                if (world.player.lives <= 0) {
+                    gameState = GAME_OVER;
+                    playerdiedSound.play();
+                    if (board.enabled) {
+                        leaderboardSubmit(board, world.player.score);
+                    }
+                    break;
+                }
+
+                canvas.subsystem = STATS_WORLD;
+                {
+                    AllocScope scope("world");
+                    drawWorld(canvas, world, sprites, mushTexture, deltaTime);
+                }
+                {
+                    AllocScope scope("particles");
+                    updateParticles(particles, deltaTime);
+                    canvas.subsystem = STATS_PARTICLES;
+                    drawParticles(canvas, particles, particleTexture);
+                }
+
+                // Draw HUD last to be on top
+                canvas.subsystem = STATS_HUD;
+                {
+                    AllocScope scope("hud");
+                    drawHUD(canvas, hud, world.player, world.level);
+                }
+                canvas.subsystem = STATS_OVERLAY;
+                AllocScope overlayScope("overlay");
+                if (netplay.active) {
+                    drawNetplayStatus(canvas, hud, netplay, sprites, mushTexture);
+                }
+                if (!netplay.active && sf::Keyboard::isKeyPressed(sf::Keyboard::R)) {
+                    drawRewindStatus(canvas, hud, rewind);
+                }
+                if (attractMode || options.autopilot) {
+                    drawAutopilotStatus(canvas, hud, bot, attractMode);
+                }
+                drawHudMessage(canvas, hud);
+                break;
+            }
+
+            case PAUSED: {
+                // Draw paused game state
+                canvas.draw(backgroundSprite);
+                drawPauseMenu(canvas, font);
+                break;
+            }
+
+            case GAME_OVER: {
+                // Draw game over screen
+                drawGameOver(canvas, font, world.player);
+                if (board.enabled) {
+                    drawLeaderboardStatus(canvas, font, board);
+                }
+                if (netplay.active) {
+                    drawNetplayStatus(canvas, hud, netplay, sprites, mushTexture);
+                }
+                break;
+            }
+
+            case INSTRUCTIONS: {
+                // Draw instructions screen
+                drawInstructions(canvas, font);
+                break;
+            }
+
+            case HIGH_SCORES: {
+                // Draw high scores screen
+                drawHighScores(canvas, font);
+                break;
+            }
+
+            case CONNECTING: {
+                // Draw netplay lobby
+                sf::Text waitText(netplay.isHost ? "Waiting for opponent..." : "Connecting to host...", font, 40);
+                waitText.setFillColor(sf::Color::White);
+                waitText.setPosition(resolutionX / 2 - waitText.getGlobalBounds().width / 2, 400);
+                canvas.draw(waitText);
+                break;
+            }
+        }
+
+        canvas.subsystem = STATS_OVERLAY;
+        if (showRenderStats) {
+            drawRenderStats(canvas, font);
+        }
+        if (renderStatsFile.is_open()) {
+            writeRenderStats(renderStatsFile, canvas);
+        }
+
+        // Scale the scene onto the window
+        {
+            AllocScope scope("present");
+            presentScene(window, scaler, capture);
+        }
+        allocFrameEnd(allocStats);
+    }
+
+    shutdownGame(bot, board, capture, scene, analytics, world, spectators, share, jobs, allocStats);
+    return 0;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+//                                                                          //
+// Function implementations                                                 //
+//                                                                          //
+//////////////////////////////////////////////////////////////////////////////
+
+// Helper functions
+void initializeGame(GameWorld& world, unsigned int seed, int fireRate) {
+    // Draw the field from the seed so every machine builds the same one
+    MushroomField field;
+    generateMushroomField(field, seed, DEFAULT_FIELD_SPEC);
+    initializeGameFromField(world, field, fireRate);
+}
+
+void initializeGameFromField(GameWorld& world, const MushroomField& field, int fireRate) {
+    // The world's own generator carries on from the field's
+    world.rngState = field.rngState;
+    world.tick = 0;
+    world.events = 0;
+    world.burstCount = 0;
+    world.records.count = 0;
+
+    // Reset player
+    PlayerData& player = world.player;
+    player.position[x] = toFixed((gameColumns / 2) * boxPixelsX);
+    player.position[y] = toFixed((gameColumns - 1) * boxPixelsY);
+    player.animation = Animation();
+    player.animation.totalFrames = 4;
+    player.lives = 3;
+    player.score = 0;
+    strcpy(player.name, "Player");
+    player.isMoving = false;
+    player.isInvulnerable = false;
+    player.invulnerabilityTimer = NO_TIMER;
+    timerReset(player.timers);
+    world.nextLifeScore = nextLifeThreshold(0);
+
+    // Reset bullets
+    world.bullets.count = 0;
+    timerReset(world.bullets.timers);
+    world.fireInterval = fireRate > 0 ? max(1, SIM_TICKS_PER_SECOND / fireRate) : 0;
+    world.fireCooldown = 0;
+
+    // Reset level
+    world.level = 1;
+
+    // Reset mushrooms
+    Fixed (*mush)[6] = world.mush;
+    world.nmush = field.count;
+    for (int i = 0; i < MAX_MUSHROOMS; i++) {
+        mush[i][0] = 0;
+        mush[i][1] = 0;
+        mush[i][2] = 0; // Hit counter
+        mush[i][3] = false; // No mushrooms exist
+        mush[i][4] = false; // mush eat
+        mush[i][5] = false; // poisonous?
+    }
+
+    world.startRow = field.startRow;
+    int startRow = world.startRow;
+
+    // Plant the field's mushrooms
+    for (int i = 0; i < world.nmush; i++) {
+        mush[i][0] = toFixed(field.cells[i] % FIELD_COLUMNS * boxPixelsX);
+        mush[i][1] = toFixed(field.cells[i] / FIELD_COLUMNS * boxPixelsY);
+        mush[i][3] = true; // Mushroom exists
+    }
+    for (int i = 0; i < MAX_MUSHROOMS; i++) {
+        world.mushBoxes.x[i] = mush[i][0];
+        world.mushBoxes.y[i] = mush[i][1];
+    }
+
+    // Reset centipede
+    Fixed (*centipede)[10] = world.centipede;
+    world.centipedeLength = CENTIPEDE_LENGTH;
+    memset(world.centipede, 0, sizeof(world.centipede));
+    for (int i = 0; i < world.centipedeLength; i++) {
+        centipede[i][2] = false; // head exists or no
+        centipede[i][3] = true; // direction left?
+        centipede[i][4] = true; // segment exists?
+    }
+    centipede[0][2] = true; // first segment is head
+    world.centipedeDown = true;
+
+    // Position centipede
+    world.startColumn = gameColumns - world.centipedeLength;
+    for (int i = 0; i < world.centipedeLength; i++) {
+        centipede[i][x] = toFixed((world.startColumn + i) * boxPixelsX);
+        centipede[i][y] = toFixed(startRow * boxPixelsY);
+    }
+
+    // Reset centipede heads
+    world.heads = 0;
+    timerReset(world.headTimers);
+    world.headTimer = timerStart(world.headTimers, HEAD_SPAWN_TICKS + 1, 0);
+    timerPause(world.headTimers, world.headTimer);
+    world.headsDown = true;
+    memset(world.centipedeheads, 0, sizeof(world.centipedeheads));
+    for (int p = 0; p < MAX_HEADS; p++) {
+        world.centipedeheads[p][x] = toFixed((gameColumns - 1) * boxPixelsX);
+        world.centipedeheads[p][y] = toFixed((gameRows - 3) * boxPixelsX);
+        world.centipedeheads[p][2] = false; // head doesn't exist
+        world.centipedeheads[p][3] = true; // direction left
+    }
+
+    // Reset fleas, spiders and scorpions, and the field they chase along
+    resetEnemies(world.enemies);
+    world.enemies.spiderBit = false;
+    memset(&world.flow, 0, sizeof(world.flow));
+    world.flow.target = -1;
+
+    // Count once; from here on the counters follow every change
+    world.stats = countWorldStats(world);
+}
+
+unsigned int nextRandom(unsigned int& state) {
+    // xorshift32: identical sequence on every platform, unlike rand()
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void parseOptions(int argc, char* argv[], GameOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--host") {
+            options.netHost = true;
+            options.netPort = NET_DEFAULT_PORT;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                options.netPort = atoi(argv[++i]);
+            }
+        }
+        else if (arg == "--join" && i + 1 < argc) {
+            // Accepts "address" or "address:port"
+            options.netJoin = true;
+            options.netAddress = argv[++i];
+            options.netPort = NET_DEFAULT_PORT;
+            size_t colon = options.netAddress.find(':');
+            if (colon != string::npos) {
+                options.netPort = atoi(options.netAddress.substr(colon + 1).c_str());
+                options.netAddress = options.netAddress.substr(0, colon);
+            }
+        }
+        else if (arg == "--leaderboard" && i + 1 < argc) {
+            // Accepts "address" or "address:port"
+            options.leaderboard = true;
+            options.leaderboardAddress = argv[++i];
+            size_t colon = options.leaderboardAddress.find(':');
+            if (colon != string::npos) {
+                options.leaderboardPort = atoi(options.leaderboardAddress.substr(colon + 1).c_str());
+                options.leaderboardAddress = options.leaderboardAddress.substr(0, colon);
+            }
+        }
+        else if (arg == "--name" && i + 1 < argc) {
+            options.playerName = argv[++i];
+        }
+        else if (arg == "--autopilot") {
+            options.autopilot = true;
+        }
+        else if (arg == "--bot-rollouts" && i + 1 < argc) {
+            // Rollouts per action per decision
+            options.botRollouts = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--bot-threads" && i + 1 < argc) {
+            options.botThreads = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--sim-threads" && i + 1 < argc) {
+            // Spread each tick's independent systems and large loops over threads
+            options.simThreads = min(MAX_JOB_THREADS, max(0, atoi(argv[++i])));
+        }
+        else if (arg == "--fire-rate" && i + 1 < argc) {
+            // Power-up mode: hold Space to fire this many shots per second
+            options.fireRate = max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--time-scale" && i + 1 < argc) {
+            // Slow the game down or speed it up, timers and all
+            options.timeScale = min(max((float) atof(argv[++i]), MIN_TIME_SCALE), MAX_TIME_SCALE);
+        }
+        else if (arg == "--render-scale" && i + 1 < argc) {
+            // Internal resolution relative to the default window, e.g. 0.5 to 2
+            options.renderScale = min(max((float) atof(argv[++i]), MIN_RENDER_SCALE), MAX_RENDER_SCALE);
+        }
+        else if (arg == "--dynamic-scale") {
+            // Lower the internal resolution while frames run over budget
+            options.dynamicScale = true;
+        }
+        else if (arg == "--resource-report") {
+            // Print what the asset cache loaded and how much memory it holds
+            options.resourceReport = true;
+        }
+        else if (arg == "--render-stats" && i + 1 < argc) {
+            // Write per-frame render counts to a CSV file
+            options.renderStatsFile = argv[++i];
+        }
+        else if (arg == "--record" && i + 1 < argc) {
+            // Record presented frames: a .y4m video, or a PNG sequence with this prefix
+            options.recordPath = argv[++i];
+        }
+        else if (arg == "--record-every" && i + 1 < argc) {
+            options.recordEvery = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--spectators") {
+            // Publish the world to spectator clients
+            options.spectators = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                options.spectatorPort = atoi(argv[++i]);
+            }
+        }
+        else if (arg == "--share-world") {
+            // Publish the world to shared memory every tick
+            options.shareWorld = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                options.shareWorldName = argv[++i];
+            }
+        }
+        else if (arg == "--analytics" && i + 1 < argc) {
+            // Append every game's events to a session log
+            options.analyticsPath = argv[++i];
+        }
+        else if (arg == "--alloc-report") {
+            // Print allocations per frame in each game state on exit
+            options.allocReport = true;
+        }
+        else if (arg == "--check-stats") {
+            options.checkStats = true;
+        }
+        else if (arg == "--check-systems") {
+            // Print the system schedule and verify each system's declared writes every tick
+            options.checkSystems = true;
+        }
+        else if (arg == "--rewind-budget" && i + 1 < argc) {
+            // Memory for rewind history, in megabytes
+            options.rewindBudgetMB = max(1, atoi(argv[++i]));
+        }
+        else {
+            cerr << "Unknown option: " << arg << endl;
+        }
+    }
+}
+
+void loadHighScores() {
+    highScores.clear();
+    ifstream file(HIGH_SCORE_FILE);
+    if (file.is_open()) {
+        string line;
+        while (getline(file, line)) {
+            stringstream ss(line);
+            string name;
+            int score;
+            ss >> name >> score;
+            highScores.push_back(HighScoreEntry(name, score));
+        }
+        file.close();
+        
+        // Sort high scores
+        sort(highScores.begin(), highScores.end());
+        
+        // Truncate to maximum number of scores if needed
+        if (highScores.size() > MAX_HIGH_SCORES) {
+            highScores.resize(MAX_HIGH_SCORES);
+        }
+    }
+}
+
+void saveHighScores(const string& playerName, int score) {
+    // Add new score
+    highScores.push_back(HighScoreEntry(playerName, score));
+    
+    // Sort scores
+    sort(highScores.begin(), highScores.end());
+    
+    // Truncate to maximum
+    if (highScores.size() > MAX_HIGH_SCORES) {
+        highScores.resize(MAX_HIGH_SCORES);
+    }
+    
+    // Save to file
+    ofstream file(HIGH_SCORE_FILE);
+    if (file.is_open()) {
+        for (const auto& entry : highScores) {
+            file << entry.name << " " << entry.score << endl;
+        }
+        file.close();
+    }
+}
+
+void checkForHighScore(PlayerData& player) {
+    // Check if score qualifies for high score
+    if (highScores.size() < MAX_HIGH_SCORES || player.score > highScores.back().score) {
+        saveHighScores(player.name, player.score);
+    }
+}
+
+void shutdownGame(Autopilot& bot, LeaderboardClient& board, VideoCapture& capture, sf::RenderTexture& scene, AnalyticsLog& analytics,
+                  const GameWorld& world, SpectatorStream& spectators, SharedWorldExport& share, JobSystem& jobs, const AllocStats& allocStats) {
+    // Every way out of main ends here, so each subsystem is let go of exactly once
+    autopilotStop(bot);
+    leaderboardStop(board);
+    captureStop(capture, scene);
+    analyticsStop(analytics, world);
+    spectatorStop(spectators);
+    sharedWorldStop(share);
+    jobsStop(jobs);
+    if (allocStats.report) {
+        printAllocReport(allocStats);
+    }
+}
+
+// Menu functions
+void drawMenu(Canvas& window, sf::Font& font, const vector<string>& menuOptions, int selectedOption) {
+    // Draw title
+    sf::Text titleText("CENTIPEDE", font, 60);
+    titleText.setStyle(sf::Text::Bold);
+    titleText.setFillColor(sf::Color::Green);
+    titleText.setPosition(resolutionX / 2 - titleText.getGlobalBounds().width / 2, 120);
+    window.draw(titleText);
+    
+    // Draw subtitle
+    sf::Text subtitleText("Enhanced Edition", font, 30);
+    subtitleText.setStyle(sf::Text::Italic);
+    subtitleText.setFillColor(sf::Color(255, 165, 0)); // Orange
+    subtitleText.setPosition(resolutionX / 2 - subtitleText.getGlobalBounds().width / 2, 200);
+    window.draw(subtitleText);
+    
+    // Draw menu options
+    for (size_t i = 0; i < menuOptions.size(); i++) {
+        sf::Text optionText(menuOptions[i], font, 40);
+        if (i == selectedOption) {
+            optionText.setFillColor(sf::Color::Red);
+        } else {
+            optionText.setFillColor(sf::Color::White);
+        }
+        optionText.setPosition(resolutionX / 2 - optionText.getGlobalBounds().width / 2, 300 + i * 60);
+        window.draw(optionText);
+    }
+}
+
+void drawInstructions(Canvas& window, sf::Font& font) {
+    // Draw instructions
+    sf::Text instructionsText("Instructions:\n\nUse arrow keys to move.\nPress Space to shoot.\nAvoid enemies and obstacles.\n\nF5 quick saves, F9 quick loads.\nHold R to rewind.\n\nPress ESC to return to menu.", font, 30);
+    instructionsText.setFillColor(sf::Color::White);
+    instructionsText.setPosition(50, 100);
+    window.draw(instructionsText);
+}
+
+void drawHighScores(Canvas& window, sf::Font& font) {
+    // Draw high scores
+    sf::Text highScoresText("High Scores:", font, 40);
+    highScoresText.setFillColor(sf::Color::White);
+    highScoresText.setPosition(50, 50);
+    window.draw(highScoresText);
+    
+    for (size_t i = 0; i < highScores.size(); i++) {
+        sf::Text scoreText(to_string(i + 1) + ". " + highScores[i].name + " - " + to_string(highScores[i].score), font, 30);
+        scoreText.setFillColor(sf::Color::White);
+        scoreText.setPosition(50, 100 + i * 40);
+        window.draw(scoreText);
+    }
+}
+
+void drawGameOver(Canvas& window, sf::Font& font, PlayerData& player) {
+    // Draw game over screen
+    sf::Text gameOverText("GAME OVER", font, 60);
+    gameOverText.setFillColor(sf::Color::Red);
+    gameOverText.setPosition(resolutionX / 2 - gameOverText.getGlobalBounds().width / 2, 200);
+    window.draw(gameOverText);
+    
+    sf::Text scoreText("Score: " + to_string(player.score), font, 40);
+    scoreText.setFillColor(sf::Color::White);
+    scoreText.setPosition(resolutionX / 2 - scoreText.getGlobalBounds().width / 2, 300);
+    window.draw(scoreText);
+    
+    sf::Text promptText("Press Enter to return to menu", font, 30);
+    promptText.setFillColor(sf::Color::White);
+    promptText.setPosition(resolutionX / 2 - promptText.getGlobalBounds().width / 2, 400);
+    window.draw(promptText);
+}
+
+void drawPauseMenu(Canvas& window, sf::Font& font) {
+    // Draw pause menu
+    sf::Text pauseText("PAUSED", font, 60);
+    pauseText.setFillColor(sf::Color::Yellow);
+    pauseText.setPosition(resolutionX / 2 - pauseText.getGlobalBounds().width / 2, 200);
+    window.draw(pauseText);
+    
+    sf::Text promptText("Press P or ESC to resume", font, 30);
+    promptText.setFillColor(sf::Color::White);
+    promptText.setPosition(resolutionX / 2 - promptText.getGlobalBounds().width / 2, 300);
+    window.draw(promptText);
+}
+
+// Animation functions
+void updateAnimation(Animation& anim, float deltaTime) {
+    if (anim.isPlaying) {
+        anim.elapsedTime += deltaTime;
+        if (anim.elapsedTime >= ANIMATION_FRAME_TIME) {
+            anim.elapsedTime = 0.0f;
+            anim.currentFrame = (anim.currentFrame + 1) % anim.totalFrames;
+        }
+    }
+}
+
+void setupAnimations(PlayerData& player) {
+    player.animation.totalFrames = 4;
+    player.animation.isPlaying = true;
+}
+
+// Simulation functions
+unsigned char readPlayerInput(bool fire) {
+    unsigned char input = 0;
+    if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left))
+        input |= INPUT_LEFT;
+    if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right))
+        input |= INPUT_RIGHT;
+    if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up))
+        input |= INPUT_UP;
+    if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down))
+        input |= INPUT_DOWN;
+    if (fire)
+        input |= INPUT_FIRE;
+    return input;
+}
+
+// Timer functions
+template <int N> void timerReset(TimerWheel<N>& wheel) {
+    wheel.now = 0;
+    wheel.count = 0;
+    for (int i = 0; i < TIMER_LEVELS * TIMER_SLOTS; i++) {
+        wheel.slots[i] = NO_TIMER;
+    }
+    for (int i = 0; i < N; i++) {
+        wheel.nodes[i] = TimerNode();
+        wheel.nodes[i].next = i + 1 < N ? i + 1 : NO_TIMER;
+        wheel.nodes[i].slot = TIMER_FREE;
+    }
+    wheel.firstFree = 0;
+}
+
+template <int N> unsigned short timerStart(TimerWheel<N>& wheel, unsigned int delay, int subject) {
+    // The wheel is fixed, so like the pools it holds no more once it is full
+    if (wheel.firstFree == NO_TIMER)
+        return NO_TIMER;
+    unsigned short timer = wheel.firstFree;
+    TimerNode& node = wheel.nodes[timer];
+    wheel.firstFree = node.next;
+    wheel.count++;
+    node.subject = subject;
+    node.due = wheel.now + min(max(delay, 1u), TIMER_MAX_DELAY);
+    timerLink(wheel, timer);
+    return timer;
+}
+
+template <int N> void timerRestart(TimerWheel<N>& wheel, unsigned short timer, unsigned int delay) {
+    // Works on a running, paused or expired timer
+    if (wheel.nodes[timer].slot < TIMER_FREE)
+        timerUnlink(wheel, timer);
+    wheel.nodes[timer].due = wheel.now + min(max(delay, 1u), TIMER_MAX_DELAY);
+    timerLink(wheel, timer);
+}
+
+template <int N> void timerStop(TimerWheel<N>& wheel, unsigned short timer) {
+    TimerNode& node = wheel.nodes[timer];
+    if (node.slot < TIMER_FREE)
+        timerUnlink(wheel, timer);
+    node.slot = TIMER_FREE;
+    node.next = wheel.firstFree;
+    wheel.firstFree = timer;
+    wheel.count--;
+}
+
+template <int N> void timerPause(TimerWheel<N>& wheel, unsigned short timer) {
+    TimerNode& node = wheel.nodes[timer];
+    if (node.slot >= TIMER_FREE)
+        return; // Not running
+    timerUnlink(wheel, timer);
+    node.due -= wheel.now;
+    node.slot = TIMER_PAUSED;
+}
+
+template <int N> void timerResume(TimerWheel<N>& wheel, unsigned short timer) {
+    TimerNode& node = wheel.nodes[timer];
+    if (node.slot != TIMER_PAUSED)
+        return;
+    node.due += wheel.now;
+    timerLink(wheel, timer);
+}
+
+template <int N> int timerAdvance(TimerWheel<N>& wheel, unsigned short expired[]) {
+    // Move the clock on one tick and list the timers that went off. They stay
+    // allocated until their owner restarts or stops them.
+    wheel.now++;
+
+    // Every ring that came round hands its current slot down; those timers
+    // are due within the turn starting now, so each lands in a lower ring
+    for (int level = 1; level < TIMER_LEVELS; level++) {
+        if (wheel.now & ((1u << (TIMER_SLOT_BITS * level)) - 1))
+            break;
+        int slot = level * TIMER_SLOTS + ((wheel.now >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1));
+        unsigned short timer = wheel.slots[slot];
+        wheel.slots[slot] = NO_TIMER;
+        while (timer != NO_TIMER) {
+            unsigned short next = wheel.nodes[timer].next;
+            timerLink(wheel, timer);
+            timer = next;
+        }
+    }
+
+    int count = 0;
+    unsigned short timer = wheel.slots[wheel.now & (TIMER_SLOTS - 1)];
+    wheel.slots[wheel.now & (TIMER_SLOTS - 1)] = NO_TIMER;
+    while (timer != NO_TIMER) {
+        expired[count++] = timer;
+        wheel.nodes[timer].slot = TIMER_EXPIRED;
+        timer = wheel.nodes[timer].next;
+    }
+    return count;
+}
+
+template <int N> void timerLink(TimerWheel<N>& wheel, unsigned short timer) {
+    // The lowest ring whose turn reaches the due tick; a timer due now goes in
+    // the bottom ring's current slot
+    TimerNode& node = wheel.nodes[timer];
+    unsigned int ahead = node.due - wheel.now;
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && (ahead >> (TIMER_SLOT_BITS * (level + 1))) != 0)
+        level++;
+    int slot = level * TIMER_SLOTS + ((node.due >> (TIMER_SLOT_BITS * level)) & (TIMER_SLOTS - 1));
+    node.slot = slot;
+    node.prev = NO_TIMER;
+    node.next = wheel.slots[slot];
+    if (node.next != NO_TIMER)
+        wheel.nodes[node.next].prev = timer;
+    wheel.slots[slot] = timer;
+}
+
+template <int N> void timerUnlink(TimerWheel<N>& wheel, unsigned short timer) {
+    TimerNode& node = wheel.nodes[timer];
+    if (node.prev != NO_TIMER)
+        wheel.nodes[node.prev].next = node.next;
+    else
+        wheel.slots[node.slot] = node.next;
+    if (node.next != NO_TIMER)
+        wheel.nodes[node.next].prev = node.prev;
+}
+
+// System functions
+const WorldSystem WORLD_SYSTEMS[] = {
+    {"invulnerability", systemInvulnerability, 0, COMP_PLAYER},
+    {"fire", systemFire, COMP_PLAYER, COMP_BULLETS | COMP_EVENTS},
+    {"move player", systemMovePlayer, COMP_MUSHROOMS, COMP_PLAYER},
+    {"move centipede", systemMoveCentipede, COMP_MUSHROOMS, COMP_CENTIPEDE},
+    {"heads", systemHeads, COMP_CENTIPEDE | COMP_MUSHROOMS, COMP_HEADS | COMP_STATS},
+    {"flow field", systemFlowField, COMP_PLAYER | COMP_MUSHROOMS, COMP_FLOW},
+    {"enemies", systemEnemies, COMP_FLOW, COMP_ENEMIES | COMP_MUSHROOMS | COMP_STATS | COMP_EVENTS},
+    {"move bullets", systemMoveBullets, 0, COMP_BULLETS},
+    {"collisions", systemCollisions, 0,
+     COMP_PLAYER | COMP_BULLETS | COMP_CENTIPEDE | COMP_HEADS | COMP_ENEMIES | COMP_MUSHROOMS | COMP_STATS | COMP_EVENTS},
+    {"poison", systemPoison, COMP_MUSHROOMS, COMP_PLAYER | COMP_EVENTS},
+    {"next level", systemNextLevel, 0,
+     COMP_PLAYER | COMP_CENTIPEDE | COMP_HEADS | COMP_MUSHROOMS | COMP_ENEMIES | COMP_LEVEL | COMP_STATS | COMP_EVENTS},
+    {"extra lives", systemExtraLives, 0, COMP_PLAYER | COMP_LEVEL | COMP_EVENTS}
+};
+const int WORLD_SYSTEM_COUNT = sizeof(WORLD_SYSTEMS) / sizeof(WORLD_SYSTEMS[0]);
+static_assert(WORLD_SYSTEM_COUNT <= MAX_SYSTEMS, "Raise MAX_SYSTEMS");
+
+void stepWorld(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    world.events = 0;
+    world.burstCount = 0;
+    world.records.count = 0;
+
+    // Nothing moves once the player is out of lives
+    if (world.player.lives <= 0)
+        return;
+    world.tick++;
+
+    const WorldSchedule& schedule = worldSchedule();
+    if (!jobs || jobs->threads == 1) {
+        for (int i = 0; i < schedule.systemCount; i++) {
+            WORLD_SYSTEMS[schedule.order[i]].run(world, input, nullptr);
+        }
+        return;
+    }
+
+    // Every system starts as soon as the ones it conflicts with are done. They
+    // never share a component one of them writes, so the world comes out the
+    // same as running them in order.
+    SystemGraphRun run;
+    run.world = &world;
+    run.input = input;
+    run.jobs = jobs;
+    run.pending = schedule.systemCount;
+    for (int i = 0; i < schedule.systemCount; i++) {
+        run.waiting[i] = __builtin_popcount(schedule.after[i]);
+    }
+    for (int i = 0; i < schedule.systemCount; i++) {
+        if (schedule.after[i] == 0)
+            jobsPush(*jobs, {runSystemJob, &run, i, i + 1, &run.pending});
+    }
+    jobsWait(*jobs, run.pending);
+}
+
+void systemInvulnerability(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    // Update invulnerability timer
+    PlayerData& player = world.player;
+    unsigned short expired[PLAYER_TIMERS];
+    if (timerAdvance(player.timers, expired) > 0) {
+        timerStop(player.timers, player.invulnerabilityTimer);
+        player.invulnerabilityTimer = NO_TIMER;
+        player.isInvulnerable = false;
+    }
+}
+
+void systemFire(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    // Classic rules fire only when no bullet exists, power-up rules on a cooldown
+    PlayerData& player = world.player;
+    if (world.fireCooldown > 0)
+        world.fireCooldown--;
+    bool gunReady = world.fireInterval > 0 ? world.fireCooldown == 0 : world.bullets.count == 0;
+    if ((input & INPUT_FIRE) && gunReady) {
+        // Center the bullet
+        if (spawnBullet(world.bullets, player.position[x] + toFixed(boxPixelsX/2 - 4), player.position[y] - toFixed(boxPixelsY/2))) {
+            world.fireCooldown = world.fireInterval;
+            world.events |= EVENT_FIRE;
+        }
+    }
+}
+
+void systemMovePlayer(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    movePlayer(world.player, input & INPUT_LEFT, input & INPUT_RIGHT, input & INPUT_UP, input & INPUT_DOWN, PLAYER_SPEED, world.mush, world.mushBoxes, world.nmush);
+}
+
+void systemMoveCentipede(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    moveCentipede(world.centipedeLength, world.centipede, world.mush, world.mushBoxes, world.nmush, world.centipedeDown);
+}
+
+void systemHeads(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    MakingHeads(world.heads, world.centipedeheads, world.centipede, world.headTimers, world.headTimer, world.mush, world.mushBoxes, world.nmush, world.stats, world.headsDown);
+}
+
+void systemFlowField(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    updateFlowField(world.flow, world.player, world.mush, world.nmush);
+}
+
+void systemEnemies(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    updateEnemies(world.enemies, world.flow, world.mush, world.mushBoxes, world.nmush, world.stats, world.records);
+}
+
+void systemMoveBullets(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    moveBullets(world.bullets);
+}
+
+void systemCollisions(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    // Collisions between moving entities are found in one sweep, bullets in one grid pass
+    CollisionStage stage;
+    gatherColliders(stage, world);
+    sweepAndPrune(stage);
+    collideBullets(stage, world, jobs);
+    resolveContacts(stage, world);
+}
+
+void systemPoison(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    // Check for collision with poisonous mushrooms
+    PlayerData& player = world.player;
+    if (!player.isInvulnerable) {
+        isPlayerhit(player, world.mush, world.mushBoxes, world.nmush, world.events, world.records);
+    }
+    if (world.events & EVENT_HIT) {
+        addBurst(world, player.position[x], player.position[y], BURST_DEATH);
+    }
+}
+
+void systemNextLevel(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    nextLevel(world.centipedeLength, world.centipede, world.mush, world.nmush, world.enemies, world.player.score,
+             world.startColumn, world.startRow, world.level, world.centipedeheads, world.stats, world.events);
+}
+
+void systemExtraLives(GameWorld& world, unsigned char input, JobSystem* jobs) {
+    PlayerData& player = world.player;
+
+    // Award extra lives at certain score thresholds
+    if (player.score >= world.nextLifeScore) {
+        player.lives++;
+        world.events |= EVENT_LEVEL_UP;
+        world.nextLifeScore = nextLifeThreshold(player.score);
+    }
+
+    // Cap maximum lives at 6
+    if (player.lives > 6) {
+        player.lives = 6;
+    }
+
+    // Cap maximum score
+    if (player.score > 999999) {
+        player.score = 999999;
+    }
+}
+
+void buildSchedule(const WorldSystem systems[], int count, WorldSchedule& schedule) {
+    // A system goes one stage after the latest earlier system it conflicts with,
+    // so conflicting systems keep their table order and the result matches
+    // running the table top to bottom
+    schedule.systemCount = count;
+    schedule.stageCount = 0;
+    for (int i = 0; i < count; i++) {
+        schedule.before[i] = 0;
+    }
+    for (int i = 0; i < count; i++) {
+        unsigned int touches = systems[i].reads | systems[i].writes;
+        schedule.stage[i] = 0;
+        schedule.after[i] = 0;
+        for (int j = 0; j < i; j++) {
+            if ((systems[j].writes & touches) || (systems[i].writes & systems[j].reads)) {
+                schedule.stage[i] = max(schedule.stage[i], schedule.stage[j] + 1);
+                schedule.after[i] |= 1u << j;
+                schedule.before[j] |= 1u << i;
+            }
+        }
+        schedule.stageCount = max(schedule.stageCount, schedule.stage[i] + 1);
+    }
+    int n = 0;
+    for (int stage = 0; stage < schedule.stageCount; stage++) {
+        for (int i = 0; i < count; i++) {
+            if (schedule.stage[i] == stage)
+                schedule.order[n++] = i;
+        }
+    }
+}
+
+const WorldSchedule& worldSchedule() {
+    static WorldSchedule schedule;
+    static bool built = (buildSchedule(WORLD_SYSTEMS, WORLD_SYSTEM_COUNT, schedule), true);
+    (void) built;
+    return schedule;
+}
+
+void runSystemJob(void* context, int system, int end) {
+    // Run one system, then release the systems that were only waiting for it
+    SystemGraphRun& run = *(SystemGraphRun*) context;
+    WORLD_SYSTEMS[system].run(*run.world, run.input, run.jobs);
+    const WorldSchedule& schedule = worldSchedule();
+    for (int next = 0; next < schedule.systemCount; next++) {
+        if ((schedule.before[system] & (1u << next)) && --run.waiting[next] == 0)
+            jobsPush(*run.jobs, {runSystemJob, context, next, next + 1, &run.pending});
+    }
+}
+
+void printSchedule() {
+    const WorldSchedule& schedule = worldSchedule();
+    cout << "World systems in " << schedule.stageCount << " stages:" << endl;
+    for (int i = 0; i < schedule.systemCount; i++) {
+        const WorldSystem& system = WORLD_SYSTEMS[schedule.order[i]];
+        cout << "  " << schedule.stage[schedule.order[i]] << "  " << system.name << "  writes";
+        for (int c = 0; c < COMPONENT_COUNT; c++) {
+            if (system.writes & (1 << c))
+                cout << " " << COMPONENT_NAMES[c];
+        }
+        cout << endl;
+    }
+}
+
+// Where each component lives in GameWorld, for the access check
+struct ComponentField {
+    unsigned int component;
+    size_t offset;
+    size_t size;
+};
+const ComponentField COMPONENT_FIELDS[] = {
+    {COMP_PLAYER, offsetof(GameWorld, player), sizeof(GameWorld::player)},
+    {COMP_BULLETS, offsetof(GameWorld, bullets), sizeof(GameWorld::bullets)},
+    {COMP_BULLETS, offsetof(GameWorld, fireInterval), sizeof(GameWorld::fireInterval)},
+    {COMP_BULLETS, offsetof(GameWorld, fireCooldown), sizeof(GameWorld::fireCooldown)},
+    {COMP_CENTIPEDE, offsetof(GameWorld, centipede), sizeof(GameWorld::centipede)},
+    {COMP_CENTIPEDE, offsetof(GameWorld, centipedeLength), sizeof(GameWorld::centipedeLength)},
+    {COMP_CENTIPEDE, offsetof(GameWorld, centipedeDown), sizeof(GameWorld::centipedeDown)},
+    {COMP_HEADS, offsetof(GameWorld, centipedeheads), sizeof(GameWorld::centipedeheads)},
+    {COMP_HEADS, offsetof(GameWorld, heads), sizeof(GameWorld::heads)},
+    {COMP_HEADS, offsetof(GameWorld, headTimer), sizeof(GameWorld::headTimer)},
+    {COMP_HEADS, offsetof(GameWorld, headTimers), sizeof(GameWorld::headTimers)},
+    {COMP_HEADS, offsetof(GameWorld, headsDown), sizeof(GameWorld::headsDown)},
+    {COMP_MUSHROOMS, offsetof(GameWorld, mush), sizeof(GameWorld::mush)},
+    {COMP_MUSHROOMS, offsetof(GameWorld, mushBoxes), sizeof(GameWorld::mushBoxes)},
+    {COMP_MUSHROOMS, offsetof(GameWorld, nmush), sizeof(GameWorld::nmush)},
+    {COMP_ENEMIES, offsetof(GameWorld, enemies), sizeof(GameWorld::enemies)},
+    {COMP_FLOW, offsetof(GameWorld, flow), sizeof(GameWorld::flow)},
+    {COMP_LEVEL, offsetof(GameWorld, level), sizeof(GameWorld::level)},
+    {COMP_LEVEL, offsetof(GameWorld, startColumn), sizeof(GameWorld::startColumn)},
+    {COMP_LEVEL, offsetof(GameWorld, startRow), sizeof(GameWorld::startRow)},
+    {COMP_LEVEL, offsetof(GameWorld, nextLifeScore), sizeof(GameWorld::nextLifeScore)},
+    {COMP_STATS, offsetof(GameWorld, stats), sizeof(GameWorld::stats)},
+    {COMP_EVENTS, offsetof(GameWorld, events), sizeof(GameWorld::events)},
+    {COMP_EVENTS, offsetof(GameWorld, bursts), sizeof(GameWorld::bursts)},
+    {COMP_EVENTS, offsetof(GameWorld, burstCount), sizeof(GameWorld::burstCount)},
+    {COMP_EVENTS, offsetof(GameWorld, records), sizeof(GameWorld::records)}
+};
+
+bool checkSystemAccess(const GameWorld& world, unsigned char input) {
+    // Debug check: step a copy one system at a time and flag any component a
+    // system changed without declaring the write
+    if (world.player.lives <= 0)
+        return true;
+    static GameWorld step, before; // Too big for comfort on the stack, and only used from the main thread
+    memcpy(&step, &world, sizeof(GameWorld));
+    step.events = 0;
+    step.burstCount = 0;
+    step.records.count = 0;
+    step.tick++;
+
+    bool ok = true;
+    const WorldSchedule& schedule = worldSchedule();
+    for (int i = 0; i < schedule.systemCount; i++) {
+        const WorldSystem& system = WORLD_SYSTEMS[schedule.order[i]];
+        memcpy(&before, &step, sizeof(GameWorld));
+        system.run(step, input, nullptr);
+        for (const ComponentField& field : COMPONENT_FIELDS) {
+            if (!(system.writes & field.component) &&
+                memcmp((const char*) &before + field.offset, (const char*) &step + field.offset, field.size) != 0) {
+                int c = 0;
+                while ((1u << c) != field.component)
+                    c++;
+                cerr << "System '" << system.name << "' wrote " << COMPONENT_NAMES[c] << " without declaring it (tick " << step.tick << ")" << endl;
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+void drawWorld(Canvas& window, GameWorld& world, GameSprites& sprites, sf::Texture& mushTexture, float deltaTime) {
+    for (int i = 0; i < world.centipedeLength; i++) {
+        drawCentipede(window, sprites.centipede, sprites.chead, world.centipedeLength, world.centipede, i, deltaTime);
+    }
+    drawHeads(window, world.centipedeheads, sprites.chead);
+    drawEnemies(window, world.enemies, sprites);
+    mushrooms(window, world.mush, sprites.mushroom, mushTexture, world.nmush);
+
+    drawBullets(window, world.bullets, sprites.bullet);
+
+    // Draw player
+    drawPlayer(window, world.player, sprites.player, deltaTime);
+}
+
+// World statistics functions
+bool inPlayerZone(Fixed posY) {
+    // The bottom rows the player can move in, where mushrooms summon the flea
+    return posY >= toFixed(resolutionY - 6 * boxPixelsY);
+}
+
+int nextLifeThreshold(int score) {
+    for (int threshold : EXTRA_LIFE_SCORES) {
+        if (threshold > score)
+            return threshold;
+    }
+    return INT_MAX;
+}
+
+WorldStats countWorldStats(const GameWorld& world) {
+    WorldStats stats = {};
+    for (int i = 0; i < world.centipedeLength; i++) {
+        stats.liveSegments += world.centipede[i][4] ? 1 : 0;
+    }
+    for (int i = 0; i < MAX_HEADS; i++) {
+        stats.liveHeads += world.centipedeheads[i][2] ? 1 : 0;
+    }
+    for (int i = 0; i < world.nmush; i++) {
+        if (world.mush[i][3]) {
+            stats.liveMushrooms++;
+            stats.zoneMushrooms += inPlayerZone(world.mush[i][1]);
+            stats.poisonedMushrooms += world.mush[i][5] ? 1 : 0;
+        }
+    }
+    return stats;
+}
+
+bool checkWorldStats(const GameWorld& world) {
+    // Debug check: the maintained counters must match a full scan
+    WorldStats scan = countWorldStats(world);
+    const WorldStats& kept = world.stats;
+    bool ok = scan.liveSegments == kept.liveSegments && scan.liveHeads == kept.liveHeads && scan.liveMushrooms == kept.liveMushrooms &&
+              scan.zoneMushrooms == kept.zoneMushrooms && scan.poisonedMushrooms == kept.poisonedMushrooms;
+    if (!ok) {
+        cerr << "World stats drifted at tick " << world.tick << ": segments " << kept.liveSegments << "/" << scan.liveSegments
+             << " heads " << kept.liveHeads << "/" << scan.liveHeads << " mushrooms " << kept.liveMushrooms << "/" << scan.liveMushrooms
+             << " zone " << kept.zoneMushrooms << "/" << scan.zoneMushrooms << " poisoned " << kept.poisonedMushrooms << "/" << scan.poisonedMushrooms
+             << " (kept/scanned)" << endl;
+    }
+    return ok;
+}
+
+// Collision functions
+void addCollider(CollisionStage& stage, Fixed posX, Fixed posY, unsigned int layer, unsigned int mask, int index) {
+    Collider& c = stage.colliders[stage.colliderCount++];
+    c.minX = posX;
+    c.minY = posY;
+    c.maxX = posX + toFixed(boxPixelsX);
+    c.maxY = posY + toFixed(boxPixelsY);
+    c.layer = layer;
+    c.mask = mask;
+    c.index = index;
+}
+
+void gatherColliders(CollisionStage& stage, GameWorld& world) {
+    stage.colliderCount = 0;
+    stage.contactCount = 0;
+
+    addCollider(stage, world.player.position[x], world.player.position[y], LAYER_PLAYER, LAYER_SEGMENT | LAYER_HEAD | LAYER_SPIDER, 0);
+
+    for (int i = 0; i < world.centipedeLength; i++) {
+        if (world.centipede[i][4])
+            addCollider(stage, world.centipede[i][x], world.centipede[i][y], LAYER_SEGMENT, 0, i);
+    }
+    for (int i = 0; i < MAX_HEADS; i++) {
+        if (world.centipedeheads[i][2])
+            addCollider(stage, world.centipedeheads[i][x], world.centipedeheads[i][y], LAYER_HEAD, 0, i);
+    }
+    // A shot spider only shows its points, nothing can touch it. Fleas are harmless
+    // to the player and cannot be shot, but they still take part in the sweep.
+    for (int i = 0; i < world.enemies.count; i++) {
+        const Enemy& e = world.enemies.items[i];
+        if (e.alive && !e.shot)
+            addCollider(stage, e.posX, e.posY, ENEMY_LAYERS[e.kind], 0, i);
+    }
+}
+
+void sweepAndPrune(CollisionStage& stage) {
+    // Sort the boxes along x so each one only has to look at its neighbours.
+    // Ties keep gathering order, so the contacts found never depend on the sort.
+    Collider* colliders = stage.colliders;
+    for (int i = 0; i < stage.colliderCount; i++)
+        stage.order[i] = i;
+    sort(stage.order, stage.order + stage.colliderCount, [colliders](int a, int b) {
+        if (colliders[a].minX != colliders[b].minX)
+            return colliders[a].minX < colliders[b].minX;
+        return a < b;
+    });
+
+    for (int i = 0; i < stage.colliderCount; i++) {
+        Collider& a = colliders[stage.order[i]];
+        for (int j = i + 1; j < stage.colliderCount; j++) {
+            Collider& b = colliders[stage.order[j]];
+            // Everything further along starts to the right of a
+            if (b.minX >= a.maxX)
+                break;
+            if (!(a.mask & b.layer) && !(b.mask & a.layer))
+                continue;
+            if (a.minY >= b.maxY || b.minY >= a.maxY)
+                continue;
+            if (stage.contactCount == MAX_CONTACTS)
+                return;
+
+            Contact& contact = stage.contacts[stage.contactCount++];
+            bool aFirst = a.layer < b.layer || (a.layer == b.layer && a.index < b.index);
+            contact.layerA = aFirst ? a.layer : b.layer;
+            contact.layerB = aFirst ? b.layer : a.layer;
+            contact.indexA = aFirst ? a.index : b.index;
+            contact.indexB = aFirst ? b.index : a.index;
+        }
+    }
+}
+
+void addGridTarget(CollisionStage& stage, Fixed posX, Fixed posY, unsigned int layer, int index) {
+    // File the target under the cell holding its top left corner
+    int column = min(max(fixedCell(posX, boxPixelsX), 0), GRID_COLUMNS - 1);
+    int row = min(max(fixedCell(posY, boxPixelsY), 0), GRID_ROWS - 1);
+    int cell = row * GRID_COLUMNS + column;
+
+    int t = stage.colliderCount; // Reused as the target count while the grid is built
+    Collider& target = stage.targets[t];
+    target.minX = posX;
+    target.minY = posY;
+    target.maxX = posX + toFixed(boxPixelsX);
+    target.maxY = posY + toFixed(boxPixelsY);
+    target.layer = layer;
+    target.mask = 0;
+    target.index = index;
+    stage.targetNext[t] = stage.cellHead[cell];
+    stage.cellHead[cell] = t;
+    stage.colliderCount++;
+}
+
+void collideBullets(CollisionStage& stage, GameWorld& world, JobSystem* jobs) {
+    BulletPool& bullets = world.bullets;
+    if (bullets.count == 0)
+        return;
+    for (int i = 0; i < bullets.count; i++)
+        stage.spent[i] = false;
+
+    // Build the grid from everything a bullet can hit
+    int colliderCount = stage.colliderCount;
+    stage.colliderCount = 0;
+    fill(stage.cellHead, stage.cellHead + GRID_ROWS * GRID_COLUMNS, -1);
+    for (int i = 0; i < world.centipedeLength; i++) {
+        if (world.centipede[i][4])
+            addGridTarget(stage, world.centipede[i][x], world.centipede[i][y], LAYER_SEGMENT, i);
+    }
+    for (int i = 0; i < MAX_HEADS; i++) {
+        if (world.centipedeheads[i][2])
+            addGridTarget(stage, world.centipedeheads[i][x], world.centipedeheads[i][y], LAYER_HEAD, i);
+    }
+    for (int i = 0; i < world.enemies.count; i++) {
+        const Enemy& e = world.enemies.items[i];
+        if (e.alive && !e.shot && e.kind != ENEMY_FLEA)
+            addGridTarget(stage, e.posX, e.posY, ENEMY_LAYERS[e.kind], i);
+    }
+    for (int i = 0; i < world.nmush; i++) {
+        if (world.mush[i][3])
+            addGridTarget(stage, world.mush[i][0], world.mush[i][1], LAYER_MUSHROOM, i);
+    }
+    stage.colliderCount = colliderCount;
+
+    if (!jobs || jobs->threads == 1 || bullets.count <= BULLET_CHUNK) {
+        for (int b = 0; b < bullets.count; b++) {
+            int room = MAX_CONTACTS - stage.contactCount;
+            int found = bulletContacts(stage, bullets, b, stage.contacts + stage.contactCount, room);
+            stage.contactCount += min(found, room);
+            if (found > room)
+                return;
+        }
+        return;
+    }
+
+    // Many bullets: count each one's contacts in parallel, lay them out in
+    // bullet order, then fill them in in parallel. The contacts, and where
+    // MAX_CONTACTS cuts them off, are the same as one bullet after another.
+    BulletQuery query = {&stage, &bullets};
+    parallelFor(jobs, bullets.count, BULLET_CHUNK, countBulletContacts, &query);
+    int first = stage.contactCount;
+    for (int b = 0; b < bullets.count; b++) {
+        int found = stage.bulletHits[b];
+        stage.bulletHits[b] = first;
+        first = min(first + found, MAX_CONTACTS);
+    }
+    parallelFor(jobs, bullets.count, BULLET_CHUNK, writeBulletContacts, &query);
+    stage.contactCount = first;
+}
+
+int bulletContacts(const CollisionStage& stage, const BulletPool& bullets, int b, Contact out[], int room) {
+    // A box one cell wide can only touch targets filed in the 3x3 cells around
+    // it. Writes the first room contacts and returns how many there are.
+    Fixed bx = bullets.posX[b];
+    Fixed by = bullets.posY[b];
+    int column = fixedCell(bx, boxPixelsX);
+    int row = fixedCell(by, boxPixelsY);
+    int firstColumn = max(column - 1, 0), lastColumn = min(column + 1, GRID_COLUMNS - 1);
+    int firstRow = max(row - 1, 0), lastRow = min(row + 1, GRID_ROWS - 1);
+
+    int found = 0;
+    for (int r = firstRow; r <= lastRow; r++) {
+        for (int col = firstColumn; col <= lastColumn; col++) {
+            for (int t = stage.cellHead[r * GRID_COLUMNS + col]; t >= 0; t = stage.targetNext[t]) {
+                const Collider& target = stage.targets[t];
+                if (bx < target.maxX && bx + toFixed(boxPixelsX) > target.minX && by < target.maxY && by + toFixed(boxPixelsY) > target.minY) {
+                    if (found < room) {
+                        Contact& contact = out[found];
+                        contact.layerA = LAYER_BULLET;
+                        contact.layerB = target.layer;
+                        contact.indexA = b;
+                        contact.indexB = target.index;
+                    }
+                    found++;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+void countBulletContacts(void* context, int begin, int end) {
+    BulletQuery& query = *(BulletQuery*) context;
+    for (int b = begin; b < end; b++) {
+        query.stage->bulletHits[b] = bulletContacts(*query.stage, *query.bullets, b, nullptr, 0);
+    }
+}
+
+void writeBulletContacts(void* context, int begin, int end) {
+    // bulletHits now holds where each bullet's contacts start
+    BulletQuery& query = *(BulletQuery*) context;
+    CollisionStage& stage = *query.stage;
+    for (int b = begin; b < end; b++) {
+        int first = stage.bulletHits[b];
+        int last = b + 1 < query.bullets->count ? stage.bulletHits[b + 1] : MAX_CONTACTS;
+        bulletContacts(stage, *query.bullets, b, stage.contacts + first, min(last, MAX_CONTACTS) - first);
+    }
+}
+
+void resolveContacts(CollisionStage& stage, GameWorld& world) {
+    PlayerData& player = world.player;
+
+    // Resolve in a fixed order so the outcome never depends on where things sat along x
+    // or which pass found them
+    sort(stage.contacts, stage.contacts + stage.contactCount, [](const Contact& a, const Contact& b) {
+        if (a.layerA != b.layerA)
+            return a.layerA < b.layerA;
+        if (a.layerB != b.layerB)
+            return a.layerB < b.layerB;
+        if (a.indexA != b.indexA)
+            return a.indexA < b.indexA;
+        return a.indexB < b.indexB;
+    });
+
+    // Each bullet is spent on the first thing it hits: segments, then heads, spider, scorpion, mushrooms
+    for (int i = 0; i < stage.contactCount; i++) {
+        Contact& c = stage.contacts[i];
+        if (c.layerA != LAYER_BULLET || stage.spent[c.indexA])
+            continue;
+        if (c.layerB == LAYER_SEGMENT && world.centipede[c.indexB][4]) {
+            addBurst(world, world.centipede[c.indexB][x], world.centipede[c.indexB][y], BURST_EXPLOSION);
+            addRecord(world.records, AE_KILL, AS_SEGMENT, world.centipede[c.indexB][x], world.centipede[c.indexB][y]);
+            bulletxcentipede(c.indexB, world.centipedeLength, world.centipede, world.mush, world.mushBoxes, world.nmush, world.stats, world.events, player.score);
+        } else if (c.layerB == LAYER_HEAD && world.centipedeheads[c.indexB][2]) {
+            addBurst(world, world.centipedeheads[c.indexB][x], world.centipedeheads[c.indexB][y], BURST_EXPLOSION);
+            addRecord(world.records, AE_KILL, AS_HEAD, world.centipedeheads[c.indexB][x], world.centipedeheads[c.indexB][y]);
+            bulletxhead(c.indexB, world.centipedeheads, world.mush, world.mushBoxes, world.nmush, world.stats, world.events, player.score);
+        } else if (c.layerB == LAYER_SPIDER && !world.enemies.items[c.indexB].shot) {
+            Enemy& spider = world.enemies.items[c.indexB];
+            addBurst(world, spider.posX, spider.posY, BURST_EXPLOSION);
+            addRecord(world.records, AE_KILL, AS_SPIDER, spider.posX, spider.posY);
+            bulletxspider(spider, player);
+        } else if (c.layerB == LAYER_SCORPION && world.enemies.items[c.indexB].alive) {
+            Enemy& scorpion = world.enemies.items[c.indexB];
+            addBurst(world, scorpion.posX, scorpion.posY, BURST_EXPLOSION);
+            addRecord(world.records, AE_KILL, AS_SCORPION, scorpion.posX, scorpion.posY);
+            bulletxscorpion(scorpion, player);
+        } else if (c.layerB == LAYER_MUSHROOM && world.mush[c.indexB][3]) {
+            bulletxmushroom(c.indexB, world.mush, world.stats, player.score);
+            if (!world.mush[c.indexB][3]) {
+                addBurst(world, world.mush[c.indexB][0], world.mush[c.indexB][1], BURST_SPORES);
+                addRecord(world.records, AE_KILL, world.mush[c.indexB][5] ? AS_POISON_MUSHROOM : AS_MUSHROOM, world.mush[c.indexB][0], world.mush[c.indexB][1]);
+            }
+        } else {
+            continue; // Already destroyed by an earlier bullet
+        }
+        stage.spent[c.indexA] = true;
+    }
+
+    // Walk down so the bullet moved into a hole has already been looked at
+    for (int i = world.bullets.count - 1; i >= 0; i--) {
+        if (stage.spent[i])
+            despawnBullet(world.bullets, i);
+    }
+
+    // The spider bites regardless of invulnerability, the centipede only when the player is open
+    for (int i = 0; i < stage.contactCount; i++) {
+        Contact& c = stage.contacts[i];
+        if (c.layerA == LAYER_PLAYER && c.layerB == LAYER_SPIDER) {
+            Enemy& spider = world.enemies.items[c.indexB];
+            if (!spider.shot && !world.enemies.spiderBit)
+                playerxspider(world.enemies, player, world.events, world.records);
+        }
+    }
+    if (player.isInvulnerable)
+        return;
+    for (int i = 0; i < stage.contactCount; i++) {
+        Contact& c = stage.contacts[i];
+        if (c.layerA != LAYER_PLAYER)
+            continue;
+        // Segments and heads shot this tick are gone
+        if ((c.layerB == LAYER_SEGMENT && world.centipede[c.indexB][4]) ||
+            (c.layerB == LAYER_HEAD && world.centipedeheads[c.indexB][2])) {
+            playerHit(player, world.events, world.records, c.layerB == LAYER_SEGMENT ? AS_SEGMENT : AS_HEAD);
+        }
+    }
+}
+
+// Overlap functions
+int overlapScanScalar(Fixed boxX, Fixed boxY, const Fixed xs[], const Fixed ys[], int from, int count, unsigned int mask[]) {
+    // The same test the game always used for two tile-sized boxes
+    const Fixed width = toFixed(boxPixelsX), height = toFixed(boxPixelsY);
+    int first = count;
+    for (int i = from; i < count; i++) {
+        if (boxX < xs[i] + width && boxX + width > xs[i] && boxY < ys[i] + height && boxY + height > ys[i]) {
+            if (!mask)
+                return i;
+            mask[i / 32] |= 1u << (i % 32);
+            first = min(first, i);
+        }
+    }
+    return first;
+}
+
+#ifdef OVERLAP_X86
+int overlapScanSSE2(Fixed boxX, Fixed boxY, const Fixed xs[], const Fixed ys[], int from, int count, unsigned int mask[]) {
+    // Four boxes per step. The lanes do exactly the scalar arithmetic, so both
+    // always agree, right down to boxes that only touch.
+    const __m128i left = _mm_set1_epi32(boxX), right = _mm_set1_epi32(boxX + toFixed(boxPixelsX));
+    const __m128i top = _mm_set1_epi32(boxY), bottom = _mm_set1_epi32(boxY + toFixed(boxPixelsY));
+    const __m128i width = _mm_set1_epi32(toFixed(boxPixelsX)), height = _mm_set1_epi32(toFixed(boxPixelsY));
+    int first = count;
+    int i = from;
+    for (; i + 4 <= count; i += 4) {
+        __m128i bx = _mm_loadu_si128((const __m128i*) (xs + i));
+        __m128i by = _mm_loadu_si128((const __m128i*) (ys + i));
+        __m128i inX = _mm_and_si128(_mm_cmplt_epi32(left, _mm_add_epi32(bx, width)), _mm_cmpgt_epi32(right, bx));
+        __m128i inY = _mm_and_si128(_mm_cmplt_epi32(top, _mm_add_epi32(by, height)), _mm_cmpgt_epi32(bottom, by));
+        unsigned int bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(inX, inY)));
+        if (!bits)
+            continue;
+        if (!mask)
+            return i + __builtin_ctz(bits);
+        first = min(first, i + __builtin_ctz(bits));
+        mask[i / 32] |= bits << (i % 32); // A mask scan starts at 0, so 4 bits never straddle words
+    }
+    return min(first, overlapScanScalar(boxX, boxY, xs, ys, i, count, mask));
+}
+
+__attribute__((target("avx2")))
+int overlapScanAVX2(Fixed boxX, Fixed boxY, const Fixed xs[], const Fixed ys[], int from, int count, unsigned int mask[]) {
+    // Eight boxes per step, otherwise the same as the SSE2 kernel
+    const __m256i left = _mm256_set1_epi32(boxX), right = _mm256_set1_epi32(boxX + toFixed(boxPixelsX));
+    const __m256i top = _mm256_set1_epi32(boxY), bottom = _mm256_set1_epi32(boxY + toFixed(boxPixelsY));
+    const __m256i width = _mm256_set1_epi32(toFixed(boxPixelsX)), height = _mm256_set1_epi32(toFixed(boxPixelsY));
+    int first = count;
+    int i = from;
+    for (; i + 8 <= count; i += 8) {
+        __m256i bx = _mm256_loadu_si256((const __m256i*) (xs + i));
+        __m256i by = _mm256_loadu_si256((const __m256i*) (ys + i));
+        __m256i inX = _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_add_epi32(bx, width), left), _mm256_cmpgt_epi32(right, bx));
+        __m256i inY = _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_add_epi32(by, height), top), _mm256_cmpgt_epi32(bottom, by));
+        unsigned int bits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(inX, inY)));
+        if (!bits)
+            continue;
+        if (!mask)
+            return i + __builtin_ctz(bits);
+        first = min(first, i + __builtin_ctz(bits));
+        mask[i / 32] |= bits << (i % 32);
+    }
+    _mm256_zeroupper(); // The scalar tail is SSE code, which stalls on dirty upper halves
+    return min(first, overlapScanScalar(boxX, boxY, xs, ys, i, count, mask));
+}
+
+bool cpuHasAVX2() {
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+bool cpuAlways() {
+    return true;
+}
+
+// Every overlap kernel, fastest first. The scalar one runs anywhere.
+const OverlapKernel OVERLAP_KERNELS[] = {
+#ifdef OVERLAP_X86
+    {"avx2", overlapScanAVX2, cpuHasAVX2},
+    {"sse2", overlapScanSSE2, cpuAlways},
+#endif
+    {"scalar", overlapScanScalar, cpuAlways}
+};
+const int OVERLAP_KERNEL_COUNT = sizeof(OVERLAP_KERNELS) / sizeof(OVERLAP_KERNELS[0]);
+
+const OverlapKernel& overlapKernel() {
+    // Picked once, the first time anything asks
+    static const OverlapKernel& kernel = [] () -> const OverlapKernel& {
+        for (int k = 0; k < OVERLAP_KERNEL_COUNT; k++) {
+            if (OVERLAP_KERNELS[k].supported())
+                return OVERLAP_KERNELS[k];
+        }
+        return OVERLAP_KERNELS[OVERLAP_KERNEL_COUNT - 1];
+    }();
+    return kernel;
+}
+
+int firstOverlap(Fixed boxX, Fixed boxY, const Fixed xs[], const Fixed ys[], int from, int count) {
+    // Index of the first box from 'from' on that overlaps, count if none
+    return overlapKernel().scan(boxX, boxY, xs, ys, from, count, nullptr);
+}
+
+int overlapMask(Fixed boxX, Fixed boxY, const Fixed xs[], const Fixed ys[], int count, unsigned int mask[]) {
+    // Sets bit i of mask (count / 32 + 1 words) for every box that overlaps; returns how many did
+    memset(mask, 0, (count + 31) / 32 * sizeof(unsigned int));
+    overlapKernel().scan(boxX, boxY, xs, ys, 0, count, mask);
+    int hits = 0;
+    for (int w = 0; w < (count + 31) / 32; w++) {
+        hits += __builtin_popcount(mask[w]);
+    }
+    return hits;
+}
+
+// Gameplay functions
+void drawPlayer(Canvas& window, PlayerData& player, sf::Sprite& playerSprite, float deltaTime) {
+    updateAnimation(player.animation, deltaTime);
+    playerSprite.setTextureRect(sf::IntRect(player.animation.currentFrame * boxPixelsX, 0, boxPixelsX, boxPixelsY));
+    playerSprite.setPosition(fixedToFloat(player.position[x]), fixedToFloat(player.position[y]));
+    window.draw(playerSprite);
+}
+
+bool spawnBullet(BulletPool& bullets, Fixed posX, Fixed posY) {
+    if (bullets.count == MAX_BULLETS)
+        return false;
+    int i = bullets.count++;
+    bullets.posX[i] = posX;
+    bullets.posY[i] = posY;
+    bullets.stepTimer[i] = timerStart(bullets.timers, BULLET_STEP_TICKS, i);
+    return true;
+}
+
+void despawnBullet(BulletPool& bullets, int i) {
+    // Move the last live bullet into the freed slot
+    timerStop(bullets.timers, bullets.stepTimer[i]);
+    int last = --bullets.count;
+    bullets.posX[i] = bullets.posX[last];
+    bullets.posY[i] = bullets.posY[last];
+    bullets.stepTimer[i] = bullets.stepTimer[last];
+    bullets.timers.nodes[bullets.stepTimer[i]].subject = i;
+}
+
+void moveBullets(BulletPool& bullets) {
+    unsigned short expired[MAX_BULLETS];
+    int count = timerAdvance(bullets.timers, expired);
+
+    // Jump in the order of a walk down the pool, so a bullet moved into a hole
+    // is one that has already jumped or was not due
+    for (int i = 1; i < count; i++) {
+        unsigned short timer = expired[i];
+        int j = i;
+        for (; j > 0 && bullets.timers.nodes[expired[j - 1]].subject < bullets.timers.nodes[timer].subject; j--)
+            expired[j] = expired[j - 1];
+        expired[j] = timer;
+    }
+    for (int k = 0; k < count; k++) {
+        int i = bullets.timers.nodes[expired[k]].subject;
+        timerRestart(bullets.timers, expired[k], BULLET_STEP_TICKS);
+        bullets.posY[i] -= toFixed(20); //changed to 20 from 10
+        if (bullets.posY[i] < toFixed(-32))
+            despawnBullet(bullets, i);
+    }
+}
+
+void bulletxmushroom(int i, Fixed mush[][6], WorldStats& stats, int& score) {
+    mush[i][2]++; // Increment the hit counter
+
+    if (mush[i][2] >= 2) {
+        // Destroing the mushroom if it has been hit twice
+        removeMushroom(mush, i, stats);
+        score += 1;
+    }
+}
+
+void drawBullets(Canvas& window, BulletPool& bullets, sf::Sprite& bulletSprite) {
+    for (int i = 0; i < bullets.count; i++) {
+        bulletSprite.setPosition(fixedToFloat(bullets.posX[i]), fixedToFloat(bullets.posY[i]));
+        window.draw(bulletSprite);
+    }
+}
+
+void movePlayer(PlayerData& player, bool moveLeft, bool moveRight, bool moveUp, bool moveDown, Fixed playerSpeed, Fixed mush[][6], const MushroomBoxes& boxes, int nmush) {
+    Fixed prevPlayerX = player.position[x];
+    Fixed prevPlayerY = player.position[y];
+
+    if (moveLeft)
+        player.position[x] -= playerSpeed;
+    if (moveRight)
+        player.position[x] += playerSpeed;
+    if (moveUp)
+        player.position[y] -= playerSpeed;
+    if (moveDown)
+        player.position[y] += playerSpeed;
+
+    // Ensure the player stays within the game window
+    const Fixed top = fixedRatio((gameColumns - 5) * (resolutionY - boxPixelsY), gameColumns);
+    if (player.position[x] < 0)
+        player.position[x] = 0;
+    if (player.position[x] > toFixed(resolutionX - boxPixelsX))
+        player.position[x] = toFixed(resolutionX - boxPixelsX);
+    if (player.position[y] < 0)
+        player.position[y] = 0;
+    if (player.position[y] < top)
+        player.position[y] = top;
+    if (player.position[y] > toFixed(resolutionY - boxPixelsY))
+        player.position[y] = toFixed(resolutionY - boxPixelsY);
+
+    // Check for collisions with mushrooms
+    for (int i = firstOverlap(player.position[x], player.position[y], boxes.x, boxes.y, 0, nmush); i < nmush;
+         i = firstOverlap(player.position[x], player.position[y], boxes.x, boxes.y, i + 1, nmush)) {
+        if (mush[i][3] && !mush[i][5]) {
+            // Restore the original position in case of collision with mushrooms
+            player.position[x] = prevPlayerX;
+            player.position[y] = prevPlayerY;
+            break; // Break the loop after handling one collision
+        }
+    }
+}
+
+bool addMushroom(Fixed mush[][6], MushroomBoxes& boxes, int& nmush, WorldStats& stats, Fixed posX, Fixed posY, bool poisonous) {
+    // The field is a fixed array, so new mushrooms are dropped once it is full
+    if (nmush >= MAX_MUSHROOMS)
+        return false;
+
+    mush[nmush][0] = posX; // X position
+    mush[nmush][1] = posY; // Y position
+    mush[nmush][2] = 0; // Hit counter
+    mush[nmush][3] = true; // Mushroom exists
+    mush[nmush][4] = false; // Mush eat
+    mush[nmush][5] = poisonous; //Poisonous?
+    boxes.x[nmush] = posX;
+    boxes.y[nmush] = posY;
+    nmush++;
+
+    stats.liveMushrooms++;
+    stats.zoneMushrooms += inPlayerZone(posY);
+    stats.poisonedMushrooms += poisonous;
+    return true;
+}
+
+void removeMushroom(Fixed mush[][6], int i, WorldStats& stats) {
+    if (!mush[i][3])
+        return;
+    mush[i][3] = false; // Set mushroom existence to false
+    stats.liveMushrooms--;
+    stats.zoneMushrooms -= inPlayerZone(mush[i][1]);
+    stats.poisonedMushrooms -= mush[i][5] ? 1 : 0;
+}
+
+void mushrooms(Canvas& window, Fixed mush[][6], sf::Sprite& mushSprite, sf::Texture& mushTexture, int nmush) {
+
+    for (int i = 0; i < nmush; i++) {
+
+        if (mush[i][3]) {
+
+            if ((int) mush[i][2] == 0 && mush[i][5]) {
+                mushSprite.setTextureRect(sf::IntRect(0, boxPixelsY, boxPixelsX, boxPixelsY));
+            } else if ((int) mush[i][2] == 1 && mush[i][5]) {
+                mushSprite.setTextureRect(sf::IntRect(3 * boxPixelsX, boxPixelsY, boxPixelsX, boxPixelsY));
+            } else if ((int) mush[i][2] == 0) {
+                mushSprite.setTextureRect(sf::IntRect(0, 0, boxPixelsX, boxPixelsY));
+            } else if ((int) mush[i][2] == 1) {
+                mushSprite.setTextureRect(sf::IntRect(3 * boxPixelsX, 0, boxPixelsX, boxPixelsY));
+            }
+            mushSprite.setPosition(fixedToFloat(mush[i][0]), fixedToFloat(mush[i][1]));
+            window.draw(mushSprite);
+
+        }
+    }
+}
+
+void MakingHeads(int& h, Fixed centipedeheads[][10], Fixed centipede[][10], TimerWheel<HEAD_TIMERS>& timers, unsigned short headTimer, Fixed mush[][6], const MushroomBoxes& boxes, int nmush, WorldStats& stats, bool& hdown) {
+
+    // A new head comes once the centipede has spent more than HEAD_SPAWN_TICKS
+    // in the player zone; the timer holds still while it is out
+    if (centipede[0][y] >= toFixed(resolutionY - 6 * boxPixelsY))
+        timerResume(timers, headTimer);
+    else
+        timerPause(timers, headTimer);
+    unsigned short expired[HEAD_TIMERS];
+    if (timerAdvance(timers, expired) > 0) {
+        if (h < MAX_HEADS) {
+            stats.liveHeads += centipedeheads[h][2] ? 0 : 1;
+            centipedeheads[h++][2] = true;
+        }
+        timerRestart(timers, headTimer, HEAD_SPAWN_TICKS + 1);
+    }
+    for (int i = 0; i < MAX_HEADS; i++) {
+
+        if (centipedeheads[i][2]) {
+            bool mushexists = mushroomxcentipede(h, centipedeheads, mush, boxes, nmush, i);
+            // Check if the centipede hits the screen edge or mushrooms
+            if (centipedeheads[i][x] < 0 || centipedeheads[i][x] > toFixed(resolutionX - boxPixelsX) || mushexists) {
+                centipedeheads[i][3] = !centipedeheads[i][3]; //Changing the direction
+
+                if (centipedeheads[i][y] >= toFixed(resolutionY - boxPixelsY)) //Checking for player box boundaries
+                    hdown = false;
+                if (centipedeheads[i][y] <= toFixed(resolutionY - 6 * boxPixelsY))
+                    hdown = true;
+                // Move hdown a row if hitting the edges
+                if (hdown == true)
+                    centipedeheads[i][y] += toFixed(boxPixelsY);
+                else
+                    centipedeheads[i][y] -= toFixed(boxPixelsY);
+
+            }
+            if (centipedeheads[i][3] == true) {
+                centipedeheads[i][x] = centipedeheads[i][x] - HEAD_SPEED; //Speed of centipedeheads
+            } else
+                centipedeheads[i][x] = centipedeheads[i][x] + HEAD_SPEED;
+        }
+    }
+
+}
+
+void drawHeads(Canvas& window, Fixed centipedeheads[][10], sf::Sprite& cheadSprite) {
+    for (int i = 0; i < MAX_HEADS; i++) {
+        if (centipedeheads[i][2]) {
+            cheadSprite.setTextureRect(sf::IntRect(0, 0, boxPixelsX, boxPixelsY));
+            cheadSprite.setPosition(fixedToFloat(centipedeheads[i][x]), fixedToFloat(centipedeheads[i][y]));
+            window.draw(cheadSprite);
+        }
+    }
+}
+
+void moveCentipede(int centipedeLength, Fixed centipede[][10], Fixed mush[][6], const MushroomBoxes& boxes, int nmush, bool& down) {
+
+    for (int i = 0; i < centipedeLength; i++) {
+        bool mushexists = mushroomxcentipede(centipedeLength, centipede, mush, boxes, nmush, i);
+        // Check if the centipede hits the screen edge or mushrooms
+        if (centipede[i][x] < 0 || centipede[i][x] > toFixed(resolutionX - boxPixelsX) || mushexists) {
+            centipede[i][3] = !centipede[i][3]; //Changing the direction
+
+            if (centipede[i][y] >= toFixed(resolutionY - boxPixelsY)) //Checking for player box boundaries
+                down = false;
+            if (centipede[i][y] <= toFixed(resolutionY - 6 * boxPixelsY))
+                down = true;
+            // Move down a row if hitting the edges
+            if (down == true)
+                centipede[i][y] += toFixed(boxPixelsY);
+            else
+                centipede[i][y] -= toFixed(boxPixelsY);
+
+        }
+        if (centipede[i][3] == true) {
+            centipede[i][x] = centipede[i][x] - CENTIPEDE_SPEED; //Speed of centipede
+        } else
+            centipede[i][x] = centipede[i][x] + CENTIPEDE_SPEED;
+    }
+
+}
+
+void drawCentipede(Canvas& window, sf::Sprite& centipedeSprite, sf::Sprite& cheadSprite, int centipedeLength, Fixed centipede[][10], int i, float deltaTime) {
+    if (centipede[i][2] == true && centipede[i][4]) {
+        cheadSprite.setTextureRect(sf::IntRect(0, 0, boxPixelsX, boxPixelsY));
+        cheadSprite.setPosition(fixedToFloat(centipede[i][x]), fixedToFloat(centipede[i][y]));
+        window.draw(cheadSprite);
+    } else if (centipede[i][4]) {
+        centipedeSprite.setTextureRect(sf::IntRect(0, 0, boxPixelsX, boxPixelsY));
+        centipedeSprite.setPosition(fixedToFloat(centipede[i][x]), fixedToFloat(centipede[i][y]));
+        window.draw(centipedeSprite);
+    }
+}
+
+bool mushroomxcentipede(int centipedeLength, Fixed centipede[][10], Fixed mush[][6], const MushroomBoxes& boxes, int nmush, int i) {
+
+    if (!centipede[i][4])
+        return false;
+    for (int j = firstOverlap(centipede[i][x], centipede[i][y], boxes.x, boxes.y, 0, nmush); j < nmush;
+         j = firstOverlap(centipede[i][x], centipede[i][y], boxes.x, boxes.y, j + 1, nmush)) {
+        if (mush[j][3]) {
+            // ^if Centipede segment collided with a mushroom, move down a row,Perimeters logic same as bullet hits mush
+            return true;
+        }
+    }
+    return false;
+}
+
+void bulletxcentipede(int i, int centipedeLength, Fixed centipede[][10], Fixed mush[][6], MushroomBoxes& boxes, int& nmush, WorldStats& stats, unsigned int& events, int& score) {
+
+    if (centipede[i][y] >= toFixed(resolutionY - 6 * boxPixelsY)) {
+        // Add a new mushroom where the bullet hit
+        addMushroom(mush, boxes, nmush, stats, centipede[i][x], centipede[i][y], true);
+    }
+    if (centipede[i][2]) {
+        score += 20;
+    } else {
+        score += 10;
+    }
+    // ^if Bullet hit a centipede segment, v split the centipede
+    centipede[i][4] = false;
+    stats.liveSegments--;
+    if (i + 1 < centipedeLength)
+        centipede[i + 1][2] = true; //new head
+
+    if (centipede[i][2]) //only when earlier levels to get rid of all segments of one centipede
+    {
+        events |= EVENT_KILL;
+        int j = i + 1;
+        while (j < centipedeLength && centipede[j][4]) {
+            centipede[j][4] = false;
+            stats.liveSegments--;
+            j++;
+        }
+
+    }
+}
+
+void bulletxhead(int i, Fixed centipedeheads[][10], Fixed mush[][6], MushroomBoxes& boxes, int& nmush, WorldStats& stats, unsigned int& events, int& score) {
+    // Add a new mushroom where the bullet hit
+    addMushroom(mush, boxes, nmush, stats, centipedeheads[i][x], centipedeheads[i][y], true);
+    score += 20;
+    centipedeheads[i][2] = false;
+    stats.liveHeads--;
+    events |= EVENT_KILL;
+}
+
+void isPlayerhit(PlayerData& player, Fixed mush[][6], const MushroomBoxes& boxes, int nmush, unsigned int& events, TickRecords& records) {
+
+    // Check for collisions with poisonous mushrooms
+    for (int i = firstOverlap(player.position[x], player.position[y], boxes.x, boxes.y, 0, nmush); i < nmush;
+         i = firstOverlap(player.position[x], player.position[y], boxes.x, boxes.y, i + 1, nmush)) {
+        if (mush[i][3] && mush[i][5]) {
+            playerHit(player, events, records, AS_POISON_MUSHROOM);
+        }
+    }
+
+}
+
+void playerHit(PlayerData& player, unsigned int& events, TickRecords& records, int killer) {
+    player.lives--;
+    player.isInvulnerable = true; // 2 seconds of invulnerability
+    if (player.invulnerabilityTimer == NO_TIMER)
+        player.invulnerabilityTimer = timerStart(player.timers, INVULNERABILITY_TICKS, 0);
+    else
+        timerRestart(player.timers, player.invulnerabilityTimer, INVULNERABILITY_TICKS);
+    events |= EVENT_HIT;
+    addRecord(records, AE_DEATH, killer, player.position[x], player.position[y]);
+}
+
+void nextLevel(int& centipedeLength, Fixed centipede[][10], Fixed mush[][6], int nmush, EnemyPool& enemies, int& score,
+              int startColumn, int startRow, int& level, Fixed centipedeheads[][10], WorldStats& stats, unsigned int& events) {
+
+    bool LevelCheck = stats.liveSegments == 0 && stats.liveHeads == 0;
+    if (LevelCheck) {
+    events |= EVENT_LEVEL_UP;
+        level++;
+        for (int i = 0; i < centipedeLength; i++) {
+            centipede[i][2] = false; //head exists or no
+            centipede[i][3] = true; //direction left?
+            centipede[i][4] = true; //segment exists?
+        }
+        centipede[0][2] = true; //head
+        for (int i = 0; i < centipedeLength; i++) {
+            centipede[i][x] = toFixed((startColumn + i) * boxPixelsX); // Increase x position for each segment
+            centipede[i][y] = toFixed(startRow * boxPixelsY);
+        }
+        for (int p = 0; p < MAX_HEADS; p++) {
+            centipedeheads[p][x] = toFixed((gameColumns - 1) * boxPixelsX);
+            centipedeheads[p][y] = toFixed((gameRows - 3) * boxPixelsX);
+            centipedeheads[p][2] = false;
+            centipedeheads[p][3] = true;
+        }
+        stats.zoneMushrooms = 0;
+        for (int i = 0; i < nmush; i++) {
+            if (!mush[i][3])
+                score += 5; //Regenerating score
+            mush[i][3] = true;
+            mush[i][5] = false;
+            mush[i][2] = 0;
+            stats.zoneMushrooms += inPlayerZone(mush[i][1]);
+        }
+        stats.liveSegments = centipedeLength;
+        stats.liveHeads = 0;
+        stats.liveMushrooms = nmush;
+        stats.poisonedMushrooms = 0;
+        resetEnemies(enemies);
+
+    }
+}
+
+void hudInit(HudText& hud, sf::Font& font) {
+    // Lay out every printable character once at each size a line is drawn
+    // at, so the font already has their glyphs and the strings and vertex
+    // arrays are already as long as any line will be
+    char all[HUD_LINE_LENGTH] = {};
+    for (int i = 0; i < HUD_LINE_LENGTH - 1 && ' ' + i <= '~'; i++)
+        all[i] = ' ' + i;
+    hud.line = all;
+    sf::Text* texts[6] = {&hud.score, &hud.lives, &hud.level, &hud.status, &hud.message, &hud.opponent};
+    for (sf::Text* text : texts) {
+        text->setFont(font);
+        text->setCharacterSize(24);
+        text->setString(hud.line);
+        text->getLocalBounds();
+    }
+    hud.status.setCharacterSize(20);
+    hud.status.getLocalBounds();
+    hud.opponent.setCharacterSize(20);
+    hud.opponent.getLocalBounds();
+
+    hud.score.setFillColor(sf::Color::Red);
+    hud.score.setPosition(10, 9);
+    hud.lives.setFillColor(sf::Color::Green);
+    hud.lives.setPosition(10, 35);
+    hud.level.setFillColor(sf::Color::White);
+    hud.level.setPosition(10, 61);
+    hud.message.setFillColor(sf::Color::Yellow);
+    hud.messageShown = false;
+    hud.opponent.setFillColor(sf::Color::Cyan);
+    hud.opponent.setPosition(10, resolutionY - 30);
+    hud.inset.setSize(sf::Vector2f(resolutionX, resolutionY));
+    hud.inset.setFillColor(sf::Color(0, 0, 0, 200));
+    hud.inset.setOutlineColor(sf::Color::White);
+    hud.inset.setOutlineThickness(-8);
+    hud.shownScore = -1;
+    hud.shownLives = -1;
+    hud.shownLevel = -1;
+}
+
+void setTextLine(sf::Text& text, sf::String& line, const char* chars) {
+    // Refill the scratch string a character at a time: clearing keeps its
+    // capacity, and setString copies it into the text's string, which keeps
+    // its own, so neither allocates
+    line.clear();
+    for (const char* c = chars; *c; c++)
+        line += sf::String((sf::Uint32) (unsigned char) *c);
+    text.setString(line);
+}
+
+void drawHUD(Canvas& window, HudText& hud, PlayerData& player, int level) {
+    // Lines are only rewritten when their value changes
+    char chars[HUD_LINE_LENGTH];
+
+    // Draw score
+    if (player.score != hud.shownScore) {
+        snprintf(chars, sizeof(chars), "Score: %d", player.score);
+        setTextLine(hud.score, hud.line, chars);
+        hud.shownScore = player.score;
+    }
+    window.draw(hud.score);
+
+    // Draw lives
+    if (player.lives != hud.shownLives) {
+        snprintf(chars, sizeof(chars), "Lives: %d", player.lives);
+        setTextLine(hud.lives, hud.line, chars);
+        hud.shownLives = player.lives;
+    }
+    window.draw(hud.lives);
+
+    // Draw level
+    if (level != hud.shownLevel) {
+        snprintf(chars, sizeof(chars), "Level: %d", level);
+        setTextLine(hud.level, hud.line, chars);
+        hud.shownLevel = level;
+    }
+    window.draw(hud.level);
+}
+
+void showHudMessage(HudText& hud, const char* chars) {
+    // Right-aligned at the top, until HUD_MESSAGE_SECONDS have passed
+    setTextLine(hud.message, hud.line, chars);
+    hud.message.setPosition(resolutionX - hud.message.getGlobalBounds().width - 10, 9);
+    hud.messageClock.restart();
+    hud.messageShown = true;
+}
+
+void drawHudMessage(Canvas& window, HudText& hud) {
+    if (hud.messageShown && hud.messageClock.getElapsedTime().asSeconds() >= HUD_MESSAGE_SECONDS)
+        hud.messageShown = false;
+    if (hud.messageShown)
+        window.draw(hud.message);
+}
+
+// Render statistics functions
+void Canvas::draw(const sf::Sprite& sprite, const sf::RenderStates& states) {
+    count(sprite.getTexture(), states.blendMode, 4);
+    target.draw(sprite, states);
+}
+
+void Canvas::draw(const sf::Text& text, const sf::RenderStates& states) {
+    // Six vertices per glyph, drawn from the font's page for that size
+    const void* texture = text.getFont() ? &text.getFont()->getTexture(text.getCharacterSize()) : nullptr;
+    count(texture, states.blendMode, 6LL * text.getString().getSize());
+    target.draw(text, states);
+}
+
+void Canvas::draw(const sf::Shape& shape, const sf::RenderStates& states) {
+    // A fan for the fill plus a strip for the outline
+    long long points = shape.getPointCount();
+    long long vertices = points + 2;
+    if (shape.getOutlineThickness() != 0)
+        vertices += 2 * (points + 1);
+    count(shape.getTexture(), states.blendMode, vertices);
+    target.draw(shape, states);
+}
+
+void Canvas::draw(const sf::Vertex* vertices, size_t vertexCount, sf::PrimitiveType type, const sf::RenderStates& states) {
+    count(states.texture, states.blendMode, vertexCount);
+    target.draw(vertices, vertexCount, type, states);
+}
+
+void Canvas::count(const void* texture, const sf::BlendMode& blend, long long vertices) {
+    RenderCounts& counts = frame[subsystem];
+    counts.drawCalls++;
+    counts.vertices += vertices;
+    if (texture != lastTexture) {
+        counts.textureSwitches++;
+        lastTexture = texture;
+    }
+    if (blend != lastBlend) {
+        counts.blendChanges++;
+        lastBlend = blend;
+    }
+}
+
+void beginRenderFrame(Canvas& canvas) {
+    // Keep the finished frame for the overlay and start counting a new one
+    if (canvas.frames > 0) {
+        copy(canvas.frame, canvas.frame + STATS_SUBSYSTEMS, canvas.last);
+    }
+    fill(canvas.frame, canvas.frame + STATS_SUBSYSTEMS, RenderCounts());
+    canvas.frames++;
+    canvas.lastTexture = nullptr;
+    canvas.lastBlend = sf::BlendMode();
+}
+
+RenderCounts totalCounts(const RenderCounts counts[STATS_SUBSYSTEMS]) {
+    RenderCounts total = {};
+    for (int i = 0; i < STATS_SUBSYSTEMS; i++) {
+        total.drawCalls += counts[i].drawCalls;
+        total.vertices += counts[i].vertices;
+        total.textureSwitches += counts[i].textureSwitches;
+        total.blendChanges += counts[i].blendChanges;
+    }
+    return total;
+}
+
+const char* const RENDER_SUBSYSTEM_NAMES[STATS_SUBSYSTEMS] = {"world", "particles", "hud", "menu", "overlay"};
+
+void writeRenderStats(ofstream& file, Canvas& canvas) {
+    // One row per subsystem that drew anything this frame
+    for (int i = 0; i < STATS_SUBSYSTEMS; i++) {
+        RenderCounts& c = canvas.frame[i];
+        if (c.drawCalls == 0)
+            continue;
+        file << canvas.frames << ',' << RENDER_SUBSYSTEM_NAMES[i] << ',' << c.drawCalls << ',' << c.vertices << ','
+             << c.textureSwitches << ',' << c.blendChanges << '\n';
+    }
+}
+
+void drawRenderStats(Canvas& window, sf::Font& font) {
+    RenderCounts total = totalCounts(window.last);
+    string lines = "draws " + to_string(total.drawCalls) + "  verts " + to_string(total.vertices) +
+                   "  tex " + to_string(total.textureSwitches) + "  blend " + to_string(total.blendChanges);
+    for (int i = 0; i < STATS_SUBSYSTEMS; i++) {
+        RenderCounts& c = window.last[i];
+        if (c.drawCalls > 0) {
+            lines += "\n" + string(RENDER_SUBSYSTEM_NAMES[i]) + ": " + to_string(c.drawCalls) + " draws, " +
+                     to_string(c.vertices) + " verts, " + to_string(c.textureSwitches) + " tex";
+        }
+    }
+    sf::Text statsText(lines, font, 18);
+    statsText.setFillColor(sf::Color::Cyan);
+    statsText.setPosition(10, 90);
+    window.draw(statsText);
+}
+
+// Resource functions
+shared_ptr<sf::Texture> cachedTexture(ResourceCache& cache, const string& path) {
+    shared_ptr<sf::Texture>& entry = cache.textures[path];
+    if (entry) {
+        cache.hits++;
+        return entry;
+    }
+    // A failed load stays cached too, so a missing file is only reported once
+    entry = make_shared<sf::Texture>();
+    entry->loadFromFile(path);
+    cache.loads++;
+    return entry;
+}
+
+shared_ptr<sf::SoundBuffer> cachedSound(ResourceCache& cache, const string& path) {
+    shared_ptr<sf::SoundBuffer>& entry = cache.sounds[path];
+    if (entry) {
+        cache.hits++;
+        return entry;
+    }
+    entry = make_shared<sf::SoundBuffer>();
+    entry->loadFromFile(path);
+    cache.loads++;
+    return entry;
+}
+
+shared_ptr<sf::Music> cachedMusic(ResourceCache& cache, const string& path) {
+    shared_ptr<sf::Music>& entry = cache.music[path];
+    if (entry) {
+        cache.hits++;
+        return entry;
+    }
+    entry = make_shared<sf::Music>();
+    entry->openFromFile(path);
+    cache.loads++;
+    return entry;
+}
+
+shared_ptr<sf::Font> cachedFont(ResourceCache& cache, const string& path) {
+    shared_ptr<sf::Font>& entry = cache.fonts[path];
+    if (entry) {
+        cache.hits++;
+        return entry;
+    }
+    entry = make_shared<sf::Font>();
+    entry->loadFromFile(path);
+    cache.loads++;
+    return entry;
+}
+
+shared_ptr<sf::Texture> loadSprites(ResourceCache& cache, GameSprites& sprites) {
+    // Initializing Player Sprites.
+    sprites.player.setTexture(*cachedTexture(cache, "Textures/player.png"));
+    sprites.player.setTextureRect(sf::IntRect(0, 0, boxPixelsX, boxPixelsY));
+
+    // Initializing mushroom Sprites. The caller keeps the texture to pick damage frames from.
+    shared_ptr<sf::Texture> mushTexture = cachedTexture(cache, "Textures/mushroom.png");
+    sprites.mushroom.setTexture(*mushTexture);
+
+    // Initializing Bullet Sprites.
+    sprites.bullet.setTexture(*cachedTexture(cache, "Textures/bullet.png"));
+
+    // Initialize Centipede Sprites.
+    sprites.centipede.setTexture(*cachedTexture(cache, "Textures/c_body_left_walk.png"));
+    sprites.chead.setTexture(*cachedTexture(cache, "Textures/c_head_left_walk.png"));
+
+    // Initialize enemies
+    sprites.flea.setTexture(*cachedTexture(cache, "Textures/flea.png"));
+    sprites.spider.setTexture(*cachedTexture(cache, "Textures/spider_and_score.png"));
+    sprites.scorpion.setTexture(*cachedTexture(cache, "Textures/scorpion.png"));
+    return mushTexture;
+}
+
+long long fileSize(const string& path) {
+    ifstream file(path, ios::binary | ios::ate);
+    return file ? (long long) file.tellg() : 0;
+}
+
+void printResourceReport(const ResourceCache& cache) {
+    // Decoded textures and sounds live in memory; music and fonts are read from disk as needed
+    long long textureBytes = 0, soundBytes = 0, musicBytes = 0, fontBytes = 0;
+    for (auto& entry : cache.textures)
+        textureBytes += 4LL * entry.second->getSize().x * entry.second->getSize().y;
+    for (auto& entry : cache.sounds)
+        soundBytes += entry.second->getSampleCount() * sizeof(sf::Int16);
+    for (auto& entry : cache.music)
+        musicBytes += fileSize(entry.first);
+    for (auto& entry : cache.fonts)
+        fontBytes += fileSize(entry.first);
+
+    cout << "Resources: " << cache.loads << " files loaded, " << cache.hits << " requests shared" << endl;
+    cout << "  textures: " << cache.textures.size() << ", " << textureBytes / 1024 << " KB decoded" << endl;
+    cout << "  sounds:   " << cache.sounds.size() << ", " << soundBytes / 1024 << " KB decoded" << endl;
+    cout << "  music:    " << cache.music.size() << ", " << musicBytes / 1024 << " KB streamed from disk" << endl;
+    cout << "  fonts:    " << cache.fonts.size() << ", " << fontBytes / 1024 << " KB read on demand" << endl;
+}
+
+void playMusic(sf::Music& music, bool& onMenu, bool menu) {
+    // Switching between menu and game restarts the song at that screen's volume
+    if (menu != onMenu || music.getStatus() == sf::Music::Stopped) {
+        music.stop();
+        music.setVolume(menu ? 50 : 40);
+        onMenu = menu;
+    }
+    // Resumes after a pause; play() on a playing stream would restart it
+    if (music.getStatus() != sf::Music::Playing) {
+        music.play();
+    }
+}
+
+// Render scale functions
+bool renderScalerInit(RenderScaler& scaler, float scale, bool dynamic) {
+    scaler.maxScale = scale;
+    scaler.scale = scale;
+    scaler.dynamic = dynamic;
+    scaler.textureSize = (unsigned int) ceil(WINDOW_SIZE * scale);
+    if (!scaler.scene.create(scaler.textureSize, scaler.textureSize))
+        return false;
+    scaler.scene.setSmooth(true);
+    applyRenderScale(scaler);
+    return true;
+}
+
+void applyRenderScale(RenderScaler& scaler) {
+    // The game still draws in its own 960x960 coordinates, squeezed into the used corner
+    float used = WINDOW_SIZE * scaler.scale / scaler.textureSize;
+    sf::View view(sf::FloatRect(0, 0, resolutionX, resolutionY));
+    view.setViewport(sf::FloatRect(0, 0, used, used));
+    scaler.scene.setView(view);
+}
+
+void presentScene(sf::RenderWindow& window, RenderScaler& scaler, VideoCapture& capture) {
+    scaler.scene.display();
+    if (capture.enabled) {
+        captureFrame(capture, scaler.scene, (unsigned int) (WINDOW_SIZE * scaler.scale));
+    }
+
+    // Fit the used part of the scene into the window, letterboxed to stay square
+    int used = (int) (WINDOW_SIZE * scaler.scale);
+    sf::Vector2u size = window.getSize();
+    float side = min(size.x, size.y);
+    sf::Sprite blit(scaler.scene.getTexture(), sf::IntRect(0, 0, used, used));
+    blit.setScale(side / used, side / used);
+    blit.setPosition((size.x - side) / 2, (size.y - side) / 2);
+    window.setView(sf::View(sf::FloatRect(0, 0, size.x, size.y)));
+    window.clear(sf::Color(0, 0, 0));
+    window.draw(blit);
+    window.display();
+
+    if (!scaler.dynamic)
+        return;
+
+    // Every few frames, step the scale down when over budget and back up when there is room
+    scaler.frameTimeSum += scaler.frameClock.restart().asSeconds();
+    if (++scaler.frameCount < SCALE_SAMPLE_FRAMES)
+        return;
+    float average = scaler.frameTimeSum / scaler.frameCount;
+    scaler.frameTimeSum = 0.0f;
+    scaler.frameCount = 0;
+    float scale = scaler.scale;
+    if (average > FRAME_BUDGET) {
+        scale = max(scale * 0.85f, MIN_RENDER_SCALE);
+    } else if (average < FRAME_BUDGET * 0.6f) {
+        scale = min(scale * 1.1f, scaler.maxScale);
+    }
+    if (scale != scaler.scale) {
+        scaler.scale = scale;
+        applyRenderScale(scaler);
+    }
+}
+
+// Particle functions
+void addBurst(GameWorld& world, Fixed posX, Fixed posY, int kind) {
+    if (world.burstCount == MAX_BURSTS)
+        return;
+    Burst& burst = world.bursts[world.burstCount++];
+    burst.posX = fixedToFloat(posX);
+    burst.posY = fixedToFloat(posY);
+    burst.kind = kind;
+}
+
+bool buildParticleAtlas(sf::Texture& atlas) {
+    // One texture for every particle, so they all go out in a single draw
+    sf::Image explosion, death, image;
+    if (!explosion.loadFromFile("Textures/explosion.png") || !death.loadFromFile("Textures/death.png"))
+        return false;
+    image.create(DEATH_FRAMES * PARTICLE_FRAME_SIZE, 2 * PARTICLE_FRAME_SIZE, sf::Color::Transparent);
+    image.copy(explosion, 0, 0, sf::IntRect(0, 0, EXPLOSION_FRAMES * PARTICLE_FRAME_SIZE, PARTICLE_FRAME_SIZE));
+    image.copy(death, 0, PARTICLE_FRAME_SIZE, sf::IntRect(0, 0, DEATH_FRAMES * PARTICLE_FRAME_SIZE, PARTICLE_FRAME_SIZE));
+    return atlas.loadFromImage(image);
+}
+
+void particlesInit(ParticleSystem& particles, unsigned int seed) {
+    particles.posX.assign(MAX_PARTICLES, 0.0f);
+    particles.posY.assign(MAX_PARTICLES, 0.0f);
+    particles.velX.assign(MAX_PARTICLES, 0.0f);
+    particles.velY.assign(MAX_PARTICLES, 0.0f);
+    particles.life.assign(MAX_PARTICLES, 0.0f);
+    particles.lifetime.assign(MAX_PARTICLES, 1.0f);
+    particles.size.assign(MAX_PARTICLES, 0.0f);
+    particles.row.assign(MAX_PARTICLES, 0);
+    particles.vertices.assign(4 * MAX_PARTICLES, sf::Vertex());
+    particles.count = 0;
+    particles.rngState = seed | 1;
+}
+
+void emitBurst(ParticleSystem& particles, float posX, float posY, int kind) {
+    int amount = 64;
+    float speed = 160.0f;
+    float lifetime = 0.6f;
+    float size = 8.0f;
+    int row = 0;
+    if (kind == BURST_DEATH) {
+        amount = 512;
+        speed = 260.0f;
+        lifetime = 1.2f;
+        size = 12.0f;
+        row = 1;
+    } else if (kind == BURST_SPORES) {
+        amount = 16;
+        speed = 60.0f;
+        lifetime = 0.4f;
+        size = 6.0f;
+    }
+
+    for (int n = 0; n < amount && particles.count < MAX_PARTICLES; n++) {
+        int i = particles.count++;
+        // Random direction and speed, spread around the middle of the box
+        float angle = (nextRandom(particles.rngState) % 6283) / 1000.0f;
+        float v = speed * (0.3f + (nextRandom(particles.rngState) % 700) / 1000.0f);
+        particles.posX[i] = posX + boxPixelsX / 2;
+        particles.posY[i] = posY + boxPixelsY / 2;
+        particles.velX[i] = cos(angle) * v;
+        particles.velY[i] = sin(angle) * v;
+        particles.lifetime[i] = lifetime * (0.5f + (nextRandom(particles.rngState) % 500) / 1000.0f);
+        particles.life[i] = particles.lifetime[i];
+        particles.size[i] = size;
+        particles.row[i] = row;
+    }
+}
+
+void emitWorldBursts(ParticleSystem& particles, const GameWorld& world) {
+    for (int i = 0; i < world.burstCount; i++) {
+        emitBurst(particles, world.bursts[i].posX, world.bursts[i].posY, world.bursts[i].kind);
+    }
+}
+
+void updateParticles(ParticleSystem& particles, float deltaTime) {
+    int count = particles.count;
+    float* posX = particles.posX.data();
+    float* posY = particles.posY.data();
+    float* velX = particles.velX.data();
+    float* velY = particles.velY.data();
+    float* life = particles.life.data();
+
+    // Plain loops over the arrays, no branches, so the compiler can vectorize them
+    for (int i = 0; i < count; i++) {
+        velY[i] += PARTICLE_GRAVITY * deltaTime;
+        posX[i] += velX[i] * deltaTime;
+        posY[i] += velY[i] * deltaTime;
+        life[i] -= deltaTime;
+    }
+
+    // Drop the dead by moving the last live particle into their slot
+    for (int i = count - 1; i >= 0; i--) {
+        if (life[i] > 0)
+            continue;
+        int last = --count;
+        posX[i] = posX[last];
+        posY[i] = posY[last];
+        velX[i] = velX[last];
+        velY[i] = velY[last];
+        life[i] = life[last];
+        particles.lifetime[i] = particles.lifetime[last];
+        particles.size[i] = particles.size[last];
+        particles.row[i] = particles.row[last];
+    }
+    particles.count = count;
+}
+
+void drawParticles(Canvas& window, ParticleSystem& particles, sf::Texture& atlas) {
+    if (particles.count == 0)
+        return;
+
+    // Each particle is a shrinking quad showing the frame for its age
+    for (int i = 0; i < particles.count; i++) {
+        float age = 1.0f - particles.life[i] / particles.lifetime[i];
+        int frames = particles.row[i] == 0 ? EXPLOSION_FRAMES : DEATH_FRAMES;
+        int frame = min((int) (age * frames), frames - 1);
+        float half = particles.size[i] * (1.0f - 0.5f * age);
+        float left = particles.posX[i] - half, right = particles.posX[i] + half;
+        float top = particles.posY[i] - half, bottom = particles.posY[i] + half;
+        float u = frame * PARTICLE_FRAME_SIZE, v = particles.row[i] * PARTICLE_FRAME_SIZE;
+        sf::Color color(255, 255, 255, (sf::Uint8) (255 * (1.0f - age)));
+
+        sf::Vertex* quad = &particles.vertices[4 * i];
+        quad[0].position = sf::Vector2f(left, top);
+        quad[1].position = sf::Vector2f(right, top);
+        quad[2].position = sf::Vector2f(right, bottom);
+        quad[3].position = sf::Vector2f(left, bottom);
+        quad[0].texCoords = sf::Vector2f(u, v);
+        quad[1].texCoords = sf::Vector2f(u + PARTICLE_FRAME_SIZE, v);
+        quad[2].texCoords = sf::Vector2f(u + PARTICLE_FRAME_SIZE, v + PARTICLE_FRAME_SIZE);
+        quad[3].texCoords = sf::Vector2f(u, v + PARTICLE_FRAME_SIZE);
+        quad[0].color = quad[1].color = quad[2].color = quad[3].color = color;
+    }
+    window.draw(particles.vertices.data(), 4 * particles.count, sf::Quads, sf::RenderStates(&atlas));
+}
+
+// Allocation functions
+AllocThread allocThreads[MAX_ALLOC_THREADS];
+atomic<int> allocThreadCount{0};
+thread_local AllocThread* allocSlot = nullptr;
+thread_local const char* allocTag = nullptr;
+
+void* operator new(size_t bytes) {
+    void* block = malloc(bytes ? bytes : 1);
+    if (!block)
+        throw bad_alloc();
+    countAllocation(bytes);
+    return block;
+}
+
+void* operator new[](size_t bytes) {
+    return operator new(bytes);
+}
+
+void operator delete(void* block) noexcept {
+    if (!block)
+        return;
+    allocThread().frees.fetch_add(1, memory_order_relaxed);
+    free(block);
+}
+
+void operator delete[](void* block) noexcept {
+    operator delete(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    operator delete(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+    operator delete(block);
+}
+
+AllocScope::AllocScope(const char* tag) : previous(allocTag) {
+#ifndef NDEBUG
+    allocTag = tag;
+#endif
+}
+
+AllocScope::~AllocScope() {
+    allocTag = previous;
+}
+
+AllocThread& allocThread() {
+    // Claim a slot the first time this thread allocates
+    if (!allocSlot) {
+        int slot = allocThreadCount.fetch_add(1, memory_order_relaxed);
+        allocSlot = &allocThreads[min(slot, MAX_ALLOC_THREADS - 1)];
+    }
+    return *allocSlot;
+}
+
+void countAllocation(size_t bytes) {
+    AllocThread& slot = allocThread();
+    slot.allocations.fetch_add(1, memory_order_relaxed);
+    slot.bytes.fetch_add(bytes, memory_order_relaxed);
+#ifndef NDEBUG
+    // Tags are string literals, so compare the pointers
+    const char* tag = allocTag ? allocTag : "untagged";
+    int count = min(slot.siteCount.load(memory_order_acquire), MAX_ALLOC_SITES);
+    AllocSite* site = nullptr;
+    for (int i = 0; i < count && !site; i++) {
+        if (slot.sites[i].tag.load(memory_order_relaxed) == tag)
+            site = &slot.sites[i];
+    }
+    if (!site) {
+        int i = slot.siteCount.fetch_add(1, memory_order_acq_rel);
+        site = &slot.sites[min(i, MAX_ALLOC_SITES - 1)];
+        if (i < MAX_ALLOC_SITES)
+            site->tag.store(tag, memory_order_release);
+    }
+    site->allocations.fetch_add(1, memory_order_relaxed);
+    site->bytes.fetch_add(bytes, memory_order_relaxed);
+#endif
+}
+
+AllocCounts allocTotals() {
+    AllocCounts totals;
+    int threads = min(allocThreadCount.load(memory_order_relaxed), MAX_ALLOC_THREADS);
+    for (int i = 0; i < threads; i++) {
+        totals.allocations += allocThreads[i].allocations.load(memory_order_relaxed);
+        totals.frees += allocThreads[i].frees.load(memory_order_relaxed);
+        totals.bytes += allocThreads[i].bytes.load(memory_order_relaxed);
+    }
+    return totals;
+}
+
+void allocFrameBegin(AllocStats& stats, int state) {
+    stats.frameState = state;
+    stats.frameStart = allocTotals();
+}
+
+long long allocFrameEnd(AllocStats& stats) {
+    // Everything allocated since the frame began, on any thread
+    AllocCounts now = allocTotals();
+    long long allocations = now.allocations - stats.frameStart.allocations;
+    AllocFrameStats& frame = stats.states[stats.frameState];
+    frame.frames++;
+    frame.allocations += allocations;
+    frame.bytes += now.bytes - stats.frameStart.bytes;
+    if (allocations > 0)
+        frame.allocatingFrames++;
+    frame.maxAllocations = max(frame.maxAllocations, allocations);
+    return allocations;
+}
+
+void resetAllocSites() {
+#ifndef NDEBUG
+    int threads = min(allocThreadCount.load(memory_order_relaxed), MAX_ALLOC_THREADS);
+    for (int t = 0; t < threads; t++) {
+        for (AllocSite& site : allocThreads[t].sites) {
+            site.allocations.store(0, memory_order_relaxed);
+            site.bytes.store(0, memory_order_relaxed);
+        }
+    }
+#endif
+}
+
+void printAllocSites() {
+#ifndef NDEBUG
+    // The same tag can have a site on several threads; add them up
+    struct SiteTotal {
+        const char* tag;
+        long long allocations;
+        long long bytes;
+    };
+    vector<SiteTotal> totals;
+    int threads = min(allocThreadCount.load(memory_order_relaxed), MAX_ALLOC_THREADS);
+    for (int t = 0; t < threads; t++) {
+        for (AllocSite& site : allocThreads[t].sites) {
+            const char* tag = site.tag.load(memory_order_acquire);
+            long long allocations = site.allocations.load(memory_order_relaxed);
+            if (!tag || allocations == 0)
+                continue;
+            auto same = find_if(totals.begin(), totals.end(), [&](const SiteTotal& total) { return strcmp(total.tag, tag) == 0; });
+            if (same == totals.end())
+                same = totals.insert(totals.end(), {tag, 0, 0});
+            same->allocations += allocations;
+            same->bytes += site.bytes.load(memory_order_relaxed);
+        }
+    }
+    sort(totals.begin(), totals.end(), [](const SiteTotal& a, const SiteTotal& b) { return a.allocations > b.allocations; });
+    cout << "Allocations by call site:" << endl;
+    for (const SiteTotal& total : totals) {
+        cout << "  " << total.tag << ": " << total.allocations << " allocations, " << total.bytes << " bytes" << endl;
+    }
+#endif
+}
+
+const char* const GAME_STATE_NAMES[GAME_STATES] = {"menu", "playing", "paused", "game over", "instructions", "high scores", "connecting"};
+
+void printAllocReport(const AllocStats& stats) {
+    cout << "Allocations per frame:" << endl;
+    for (int i = 0; i < GAME_STATES; i++) {
+        const AllocFrameStats& frame = stats.states[i];
+        if (frame.frames == 0)
+            continue;
+        cout << "  " << GAME_STATE_NAMES[i] << ": " << frame.frames << " frames, "
+             << (double) frame.allocations / frame.frames << " allocations (max " << frame.maxAllocations << ") and "
+             << frame.bytes / frame.frames << " bytes per frame, " << frame.allocatingFrames << " frames allocated" << endl;
+    }
+    printAllocSites();
+}
+
+// Snapshot and rewind functions
+bool saveSnapshot(const GameWorld& world, const string& path) {
+    ofstream file(path, ios::binary);
+    if (!file.is_open())
+        return false;
+
+    // Header: magic, version and world size, so stale saves are refused rather than misread
+    sf::Uint32 header[3] = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, (sf::Uint32) sizeof(GameWorld)};
+    file.write((const char*) header, sizeof(header));
+    file.write((const char*) &world, sizeof(GameWorld));
+    return file.good();
+}
+
+bool loadSnapshot(GameWorld& world, const string& path) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open())
+        return false;
+
+    sf::Uint32 header[3];
+    if (!file.read((char*) header, sizeof(header)))
+        return false;
+    if (header[0] != SNAPSHOT_MAGIC || header[1] != SNAPSHOT_VERSION || header[2] != sizeof(GameWorld)) {
+        cerr << "Snapshot " << path << " was written by a different version" << endl;
+        return false;
+    }
+    GameWorld loaded;
+    if (!file.read((char*) &loaded, sizeof(GameWorld)))
+        return false;
+    world = loaded;
+    return true;
+}
+
+void rewindInit(RewindBuffer& rewind, int budgetMB) {
+    // A record is at least its top-level mask plus one block mask
+    size_t words = (size_t) budgetMB * 1024 * 1024 / 4;
+    size_t maxEntries = words / (WORLD_TOP_WORDS + 1);
+    if (maxEntries > (size_t) REWIND_MAX_SECONDS * SIM_TICKS_PER_SECOND)
+        maxEntries = (size_t) REWIND_MAX_SECONDS * SIM_TICKS_PER_SECOND;
+    rewind.data.assign(words, 0);
+    rewind.entries.assign(maxEntries, RewindEntry());
+}
+
+void rewindReset(RewindBuffer& rewind, const GameWorld& world) {
+    rewind.firstEntry = 0;
+    rewind.entryCount = 0;
+    rewind.writeOffset = 0;
+    memcpy(rewind.previous, &world, sizeof(GameWorld));
+}
+
+void rewindCapture(RewindBuffer& rewind, const GameWorld& world) {
+    if (rewind.entries.empty())
+        return;
+    sf::Clock captureClock;
+
+    // Mark changed words, one bit per word and one bit per block of 32 words
+    sf::Uint32* current = rewind.scratch;
+    memcpy(current, &world, sizeof(GameWorld));
+    sf::Uint32 top[WORLD_TOP_WORDS] = {};
+    sf::Uint32 blockMasks[WORLD_BLOCKS];
+    int dirtyBlocks = 0;
+    int dirtyWords = 0;
+    for (int block = 0; block < WORLD_BLOCKS; block++) {
+        sf::Uint32 mask = 0;
+        int end = min(WORLD_WORDS, (block + 1) * 32);
+        for (int i = block * 32; i < end; i++) {
+            if (current[i] != rewind.previous[i])
+                mask |= 1u << (i & 31);
+        }
+        blockMasks[block] = mask;
+        if (mask) {
+            top[block / 32] |= 1u << (block & 31);
+            dirtyBlocks++;
+            dirtyWords += __builtin_popcount(mask);
+        }
+    }
+
+    // Make room, dropping the oldest history first. Records never straddle the
+    // end of the ring; when one does not fit, everything past the write position goes.
+    unsigned int size = WORLD_TOP_WORDS + dirtyBlocks + dirtyWords;
+    unsigned int capacity = rewind.data.size();
+    int maxEntries = rewind.entries.size();
+    if (size > capacity)
+        return;
+    if (rewind.writeOffset + size > capacity) {
+        while (rewind.entryCount > 0 && rewind.entries[rewind.firstEntry].offset >= rewind.writeOffset) {
+            rewind.firstEntry = (rewind.firstEntry + 1) % maxEntries;
+            rewind.entryCount--;
+        }
+        rewind.writeOffset = 0;
+    }
+    while (rewind.entryCount > 0) {
+        RewindEntry& oldest = rewind.entries[rewind.firstEntry];
+        bool overlaps = oldest.offset < rewind.writeOffset + size && rewind.writeOffset < oldest.offset + oldest.size;
+        if (!overlaps && rewind.entryCount < maxEntries)
+            break;
+        rewind.firstEntry = (rewind.firstEntry + 1) % maxEntries;
+        rewind.entryCount--;
+    }
+
+    // Write the record: top mask, dirty block masks, then the XOR of each changed word
+    sf::Uint32* out = &rewind.data[rewind.writeOffset];
+    for (int i = 0; i < WORLD_TOP_WORDS; i++)
+        *out++ = top[i];
+    for (int block = 0; block < WORLD_BLOCKS; block++) {
+        if (blockMasks[block])
+            *out++ = blockMasks[block];
+    }
+    for (int block = 0; block < WORLD_BLOCKS; block++) {
+        for (sf::Uint32 mask = blockMasks[block]; mask; mask &= mask - 1) {
+            int i = block * 32 + __builtin_ctz(mask);
+            *out++ = current[i] ^ rewind.previous[i];
+            rewind.previous[i] = current[i];
+        }
+    }
+
+    RewindEntry& entry = rewind.entries[(rewind.firstEntry + rewind.entryCount) % maxEntries];
+    entry.offset = rewind.writeOffset;
+    entry.size = size;
+    rewind.entryCount++;
+    rewind.writeOffset += size;
+
+    rewind.capturedTicks++;
+    rewind.capturedBytes += size * 4;
+    rewind.captureMicros += captureClock.getElapsedTime().asMicroseconds();
+}
+
+bool rewindStep(RewindBuffer& rewind, GameWorld& world) {
+    if (rewind.entryCount == 0)
+        return false;
+
+    // Undo the newest record and hand its space back to the ring
+    int maxEntries = rewind.entries.size();
+    RewindEntry entry = rewind.entries[(rewind.firstEntry + rewind.entryCount - 1) % maxEntries];
+    const sf::Uint32* in = &rewind.data[entry.offset];
+    const sf::Uint32* top = in;
+    const sf::Uint32* masks = in + WORLD_TOP_WORDS;
+    int dirtyBlocks = 0;
+    for (int i = 0; i < WORLD_TOP_WORDS; i++)
+        dirtyBlocks += __builtin_popcount(top[i]);
+    const sf::Uint32* values = masks + dirtyBlocks;
+
+    for (int t = 0; t < WORLD_TOP_WORDS; t++) {
+        for (sf::Uint32 topMask = top[t]; topMask; topMask &= topMask - 1) {
+            int block = t * 32 + __builtin_ctz(topMask);
+            for (sf::Uint32 mask = *masks++; mask; mask &= mask - 1) {
+                rewind.previous[block * 32 + __builtin_ctz(mask)] ^= *values++;
+            }
+        }
+    }
+    memcpy(&world, rewind.previous, sizeof(GameWorld));
+
+    rewind.entryCount--;
+    rewind.writeOffset = entry.offset;
+    return true;
+}
+
+void drawRewindStatus(Canvas& window, HudText& hud, RewindBuffer& rewind) {
+    long long ticks = rewind.capturedTicks > 0 ? rewind.capturedTicks : 1;
+    char status[HUD_LINE_LENGTH];
+    snprintf(status, sizeof(status), "<< REWIND  %.1f s left  (%lld B, %.2f us per tick)",
+             (float) rewind.entryCount / SIM_TICKS_PER_SECOND, rewind.capturedBytes / ticks, (float) rewind.captureMicros / ticks);
+    hud.status.setCharacterSize(24);
+    setTextLine(hud.status, hud.line, status);
+    hud.status.setFillColor(sf::Color::Yellow);
+    hud.status.setPosition(resolutionX / 2 - hud.status.getGlobalBounds().width / 2, 90);
+    window.draw(hud.status);
+}
+
+// Autopilot functions
+void autopilotStart(Autopilot& bot, int rolloutsPerAction, int threads) {
+    bot.enabled = true;
+    bot.rolloutsPerAction = max(1, rolloutsPerAction);
+    bot.ticksLeft = 0;
+    bot.rngState = time(0) | 1;
+    bot.results.assign(bot.rolloutsPerAction * BOT_ACTIONS, 0.0f);
+
+    // The main thread works too, so start one worker fewer than the thread count
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    if (bot.workers.empty()) {
+        bot.quit = false;
+        for (int i = 1; i < threads; i++) {
+            bot.workers.push_back(thread(autopilotWorker, &bot));
+        }
+    }
+}
+
+void autopilotStop(Autopilot& bot) {
+    {
+        lock_guard<mutex> guard(bot.lock);
+        bot.quit = true;
+    }
+    bot.wake.notify_all();
+    for (size_t i = 0; i < bot.workers.size(); i++) {
+        bot.workers[i].join();
+    }
+    bot.workers.clear();
+    bot.enabled = false;
+}
+
+unsigned char autopilotInput(Autopilot& bot, const GameWorld& world) {
+    // Hold each chosen action for a few ticks, then think again
+    if (bot.ticksLeft <= 0) {
+        autopilotDecide(bot, world);
+        bot.ticksLeft = BOT_DECISION_TICKS;
+    }
+    bot.ticksLeft--;
+    return bot.input;
+}
+
+void autopilotDecide(Autopilot& bot, const GameWorld& world) {
+    sf::Clock thinkClock;
+
+    // Publish the jobs, wake the workers and help out until every rollout is done
+    {
+        lock_guard<mutex> guard(bot.lock);
+        bot.root = &world;
+        bot.seed = nextRandom(bot.rngState);
+        bot.jobCount = bot.rolloutsPerAction * BOT_ACTIONS;
+        bot.doneJobs = 0;
+        bot.nextJob = 0;
+        bot.generation++;
+    }
+    bot.wake.notify_all();
+    autopilotRunJobs(bot);
+    {
+        unique_lock<mutex> guard(bot.lock);
+        bot.finished.wait(guard, [&bot] { return bot.doneJobs.load() >= bot.jobCount; });
+    }
+
+    // Pick the action with the best average outcome
+    int best = 0;
+    float bestValue = 0.0f;
+    for (int action = 0; action < BOT_ACTIONS; action++) {
+        float value = 0.0f;
+        for (int i = 0; i < bot.rolloutsPerAction; i++) {
+            value += bot.results[i * BOT_ACTIONS + action];
+        }
+        if (action == 0 || value > bestValue) {
+            best = action;
+            bestValue = value;
+        }
+    }
+    bot.input = autopilotActionInput(best);
+
+    bot.rollouts += bot.jobCount;
+    bot.thinkMicros += thinkClock.getElapsedTime().asMicroseconds();
+}
+
+void autopilotWorker(Autopilot* bot) {
+    long long seen = 0;
+    while (true) {
+        {
+            unique_lock<mutex> guard(bot->lock);
+            bot->wake.wait(guard, [&] { return bot->quit || bot->generation != seen; });
+            if (bot->quit)
+                return;
+            seen = bot->generation;
+        }
+        autopilotRunJobs(*bot);
+    }
+}
+
+void autopilotRunJobs(Autopilot& bot) {
+    GameWorld world;
+    int job;
+    while ((job = bot.nextJob++) < bot.jobCount) {
+        // Each rollout gets its own copy of the world and its own random stream
+        world = *bot.root;
+        unsigned int rng = (bot.seed ^ (job * 2654435761u)) | 1;
+        bot.results[job] = autopilotRollout(world, job % BOT_ACTIONS, rng);
+        if (++bot.doneJobs == bot.jobCount) {
+            lock_guard<mutex> guard(bot.lock);
+            bot.finished.notify_all();
+        }
+    }
+}
+
+float autopilotRollout(GameWorld& world, int action, unsigned int& rng) {
+    int startScore = world.player.score;
+    int startLives = world.player.lives;
+    unsigned char input = autopilotActionInput(action);
+
+    for (int t = 0; t < BOT_HORIZON_TICKS; t++) {
+        // The action under test first, random play after that
+        if (t > 0 && t % BOT_DECISION_TICKS == 0) {
+            input = autopilotActionInput(nextRandom(rng) % BOT_ACTIONS);
+        }
+        stepWorld(world, input, nullptr);
+        if (world.player.lives < startLives) {
+            // Dying sooner is worse than dying later
+            return world.player.score - startScore - BOT_LIFE_PENALTY - (BOT_HORIZON_TICKS - t) * 10.0f;
+        }
+    }
+    return world.player.score - startScore;
+}
+
+unsigned char autopilotActionInput(int action) {
+    const unsigned char moves[5] = {0, INPUT_LEFT, INPUT_RIGHT, INPUT_UP, INPUT_DOWN};
+    return moves[action % 5] | (action >= 5 ? INPUT_FIRE : 0);
+}
+
+void drawAutopilotStatus(Canvas& window, HudText& hud, Autopilot& bot, bool attractMode) {
+    float thinkSeconds = bot.thinkMicros / 1e6f;
+    long long rate = thinkSeconds > 0 ? (long long) (bot.rollouts / thinkSeconds) : 0;
+    char status[HUD_LINE_LENGTH];
+    snprintf(status, sizeof(status), "%s  %lld rollouts/s", attractMode ? "DEMO - press any key" : "AUTOPILOT", rate);
+    hud.status.setCharacterSize(20);
+    setTextLine(hud.status, hud.line, status);
+    hud.status.setFillColor(sf::Color::Magenta);
+    hud.status.setPosition(resolutionX / 2 - hud.status.getGlobalBounds().width / 2, 9);
+    window.draw(hud.status);
+}
+
+// Enemy functions
+Enemy* spawnEnemy(EnemyPool& enemies, int kind, Fixed posX, Fixed posY) {
+    // The pool is fixed, so new enemies are dropped once it is full
+    if (enemies.count >= MAX_ENEMIES)
+        return nullptr;
+    Enemy& e = enemies.items[enemies.count++];
+    e = Enemy();
+    e.posX = posX;
+    e.posY = posY;
+    e.kind = kind;
+    e.heading = FLOW_STILL;
+    e.right = true;
+    e.down = true;
+    e.alive = true;
+    e.timer = NO_TIMER;
+    return &e;
+}
+
+void resetEnemies(EnemyPool& enemies) {
+    // Every level starts with one spider and one scorpion; the flea waits for its cue
+    enemies.count = 0;
+    enemies.fleaReleased = false;
+    timerReset(enemies.timers);
+    spawnEnemy(enemies, ENEMY_SPIDER, 0, toFixed(20 * boxPixelsY));
+    spawnEnemy(enemies, ENEMY_SCORPION, 0, toFixed(26 * boxPixelsY));
+}
+
+void updateEnemies(EnemyPool& enemies, const FlowField& flow, Fixed mush[][6], MushroomBoxes& boxes, int& nmush, WorldStats& stats, TickRecords& records) {
+    // The flea drops in when exactly three mushrooms crowd the player zone
+    if (stats.zoneMushrooms == 3 && !enemies.fleaReleased) {
+        spawnEnemy(enemies, ENEMY_FLEA, toFixed(15 * boxPixelsX), 0);
+        enemies.fleaReleased = true;
+    }
+
+    // Wake the enemies whose CO_WAIT is over
+    unsigned short expired[MAX_ENEMIES];
+    int woken = timerAdvance(enemies.timers, expired);
+    for (int i = 0; i < woken; i++) {
+        Enemy& e = enemies.items[enemies.timers.nodes[expired[i]].subject];
+        timerStop(enemies.timers, e.timer);
+        e.timer = NO_TIMER;
+    }
+
+    // Resume every waking behavior in spawn order, packing the survivors down as we go
+    int live = 0;
+    for (int i = 0; i < enemies.count; i++) {
+        Enemy& e = enemies.items[i];
+        if (!e.alive) {
+            // Removed since the last update
+            if (e.timer != NO_TIMER)
+                timerStop(enemies.timers, e.timer);
+            continue;
+        }
+        bool running = true;
+        if (e.timer == NO_TIMER) {
+            switch (e.kind) {
+                case ENEMY_FLEA:
+                    running = fleaBehavior(e, mush, boxes, nmush, stats);
+                    break;
+                case ENEMY_SPIDER:
+                    running = spiderBehavior(e, flow, mush, boxes, nmush, stats);
+                    break;
+                case ENEMY_SCORPION:
+                    running = scorpionBehavior(e, mush, boxes, nmush, stats, records);
+                    break;
+            }
+            if (running && e.wait > 0) {
+                e.timer = timerStart(enemies.timers, e.wait, live);
+                e.wait = 0;
+            }
+        }
+        if (running) {
+            if (e.timer != NO_TIMER)
+                enemies.timers.nodes[e.timer].subject = live;
+            enemies.items[live++] = e;
+        }
+    }
+    enemies.count = live;
+}
+
+bool fleaBehavior(Enemy& e, Fixed mush[][6], MushroomBoxes& boxes, int& nmush, WorldStats& stats) {
+    CO_BEGIN(e);
+
+    // Fall to the middle of the field...
+    while (true) {
+        e.posY += FLEA_SPEED;
+        if (fixedToInt(e.posY) == 15 * boxPixelsY)
+            break;
+        CO_YIELD(e);
+    }
+
+    // ...leave a trail of three mushrooms...
+    for (int i = 0; i < 3; i++) {
+        addMushroom(mush, boxes, nmush, stats, e.posX, e.posY + toFixed((boxPixelsY + 2) * i), false);
+    }
+
+    // ...and drop off the bottom
+    while (e.posY <= toFixed(resolutionY - boxPixelsY)) {
+        CO_YIELD(e);
+        e.posY += FLEA_SPEED;
+    }
+
+    CO_END(e);
+}
+
+bool spiderBehavior(Enemy& e, const FlowField& flow, Fixed mush[][6], const MushroomBoxes& boxes, int nmush, WorldStats& stats) {
+    CO_BEGIN(e);
+
+    // Chase the player along the flow field, eating mushrooms on the way,
+    // until shot. Each step runs from one cell to the next, so the field is
+    // read once a cell; a spider caught between cells finishes its step.
+    while (!e.shot) {
+        if (e.heading == FLOW_STILL || (e.posX % toFixed(boxPixelsX) == 0 && e.posY % toFixed(boxPixelsY) == 0)) {
+            e.heading = flowStep(flow, e.posX, e.posY);
+            e.right = FLOW_DX[e.heading] ? FLOW_DX[e.heading] > 0 : e.right;
+            e.down = FLOW_DY[e.heading] ? FLOW_DY[e.heading] > 0 : e.down;
+        }
+        e.posX += FLOW_DX[e.heading] * SPIDER_SPEED;
+        e.posY += FLOW_DY[e.heading] * SPIDER_SPEED;
+
+        //Eating mushrooms
+        for (int i = firstOverlap(e.posX, e.posY, boxes.x, boxes.y, 0, nmush); i < nmush; i = firstOverlap(e.posX, e.posY, boxes.x, boxes.y, i + 1, nmush)) {
+            removeMushroom(mush, i, stats);
+        }
+        CO_YIELD(e);
+    }
+
+    // Show the points it was worth for a moment, then go
+    CO_WAIT(e, SPIDER_DEATH_TICKS);
+
+    CO_END(e);
+}
+
+bool scorpionBehavior(Enemy& e, Fixed mush[][6], const MushroomBoxes& boxes, int nmush, WorldStats& stats, TickRecords& records) {
+    CO_BEGIN(e);
+
+    // Pace the row, poisoning every mushroom it crosses, until shot
+    while (true) {
+        if (e.posX < 0 || e.posX > toFixed(resolutionX - 2 * boxPixelsX)) {
+            e.right = !e.right;
+        }
+        e.posX += e.right ? SCORPION_SPEED : -SCORPION_SPEED;
+
+        //Poisonous mushrooms
+        for (int i = firstOverlap(e.posX, e.posY, boxes.x, boxes.y, 0, nmush); i < nmush; i = firstOverlap(e.posX, e.posY, boxes.x, boxes.y, i + 1, nmush)) {
+            if (mush[i][3] && !mush[i][5]) {
+                mush[i][5] = true;
+                stats.poisonedMushrooms++;
+                addRecord(records, AE_POISON, AS_SCORPION, mush[i][0], mush[i][1]);
+            }
+        }
+        CO_YIELD(e);
+    }
+
+    CO_END(e);
+}
+
+void bulletxspider(Enemy& spider, PlayerData& player) {
+    // The spider is worth more the closer it was to the player
+    if (player.position[y] - spider.posY < toFixed(100)) {
+        spider.points = 900;
+    } else if (player.position[y] - spider.posY < toFixed(150)) {
+        spider.points = 600;
+    } else {
+        spider.points = 300;
+    }
+    player.score += spider.points;
+    spider.shot = true;
+}
+
+void playerxspider(EnemyPool& enemies, PlayerData& player, unsigned int& events, TickRecords& records) {
+    // A spider only bites once
+    playerHit(player, events, records, AS_SPIDER);
+    enemies.spiderBit = true;
+}
+
+void bulletxscorpion(Enemy& scorpion, PlayerData& player) {
+    //Killing scorpion
+    scorpion.alive = false;
+    player.score += 1000;
+}
+
+void drawEnemies(Canvas& window, EnemyPool& enemies, GameSprites& sprites) {
+    for (int i = 0; i < enemies.count; i++) {
+        const Enemy& e = enemies.items[i];
+        if (!e.alive)
+            continue;
+        if (e.kind == ENEMY_FLEA) {
+            drawFlea(window, e, sprites.flea);
+        } else if (e.kind == ENEMY_SPIDER) {
+            drawSpider(window, e, sprites.spider);
+        } else {
+            drawScorpion(window, e, sprites.scorpion);
+        }
+    }
+}
+
+void drawFlea(Canvas& window, const Enemy& flea, sf::Sprite& fleaSprite) {
+    fleaSprite.setTextureRect(sf::IntRect(0, 0, boxPixelsX, boxPixelsY));
+    fleaSprite.setPosition(fixedToFloat(flea.posX), fixedToFloat(flea.posY));
+    window.draw(fleaSprite);
+}
+
+void drawSpider(Canvas& window, const Enemy& spider, sf::Sprite& spiderSprite) {
+    // A shot spider shows the points it was worth
+    if (spider.shot && spider.points == 900) {
+        spiderSprite.setTextureRect(sf::IntRect(3.9 * boxPixelsX, 0, 1.9 * boxPixelsX, 2 * boxPixelsY));
+    } else if (spider.shot && spider.points == 600) {
+        spiderSprite.setTextureRect(sf::IntRect(1.9 * boxPixelsX, 0, 1.9 * boxPixelsX, 2 * boxPixelsY));
+    } else if (spider.shot) {
+        spiderSprite.setTextureRect(sf::IntRect(0, 0, 1.9 * boxPixelsX, 2 * boxPixelsY));
+    } else {
+        spiderSprite.setTextureRect(sf::IntRect(7.5 * boxPixelsX, 0, 1.9 * boxPixelsX, boxPixelsY));
+    }
+    spiderSprite.setPosition(fixedToFloat(spider.posX), fixedToFloat(spider.posY));
+    window.draw(spiderSprite);
+}
+
+void drawScorpion(Canvas& window, const Enemy& scorpion, sf::Sprite& scorpionSprite) {
+    scorpionSprite.setTextureRect(sf::IntRect(0, 0, 2 * boxPixelsX, boxPixelsY));
+    scorpionSprite.setPosition(fixedToFloat(scorpion.posX), fixedToFloat(scorpion.posY));
+    window.draw(scorpionSprite);
+}
+
+// Netplay functions
+bool netplayStart(NetSession& net, const GameOptions& options) {
+    net.isHost = options.netHost;
+    net.connected = false;
+    net.disconnected = false;
+    net.localTick = 0;
+    net.remoteReceived = 0;
+    net.remoteAcked = 0;
+    net.rollbackFrom = -1;
+    net.rollbacks = 0;
+    net.resimulatedTicks = 0;
+
+    // The host listens on the agreed port, the guest on any free one
+    unsigned short port = net.isHost ? options.netPort : (unsigned short) sf::Socket::AnyPort;
+    if (net.socket.bind(port) != sf::Socket::Done) {
+        cerr << "Netplay: could not bind UDP port " << port << endl;
+        return false;
+    }
+    net.socket.setBlocking(false);
+
+    if (!net.isHost) {
+        net.remoteAddress = sf::IpAddress(options.netAddress);
+        net.remotePort = options.netPort;
+    }
+    net.seed = time(0);
+    net.fireRate = options.fireRate;
+    net.active = true;
+    net.helloClock.restart();
+    return true;
+}
+
+void netplayStop(NetSession& net) {
+    if (net.active) {
+        net.socket.unbind();
+    }
+    net.active = false;
+    net.connected = false;
+}
+
+void netplayPoll(NetSession& net) {
+    // Guests keep knocking until the host answers
+    if (!net.connected && !net.isHost && net.helloClock.getElapsedTime().asSeconds() > 0.25f) {
+        sf::Packet hello;
+        hello << NET_MAGIC << (sf::Uint8) NET_HELLO;
+        net.socket.send(hello, net.remoteAddress, net.remotePort);
+        net.helloClock.restart();
+    }
+
+    sf::Packet packet;
+    sf::IpAddress sender;
+    unsigned short senderPort;
+    while (net.socket.receive(packet, sender, senderPort) == sf::Socket::Done) {
+        sf::Uint32 magic;
+        sf::Uint8 type;
+        if (!(packet >> magic >> type) || magic != NET_MAGIC)
+            continue;
+
+        // Only a host still waiting takes packets from a new address; after
+        // that, and always for a guest, anyone but the peer is ignored
+        bool fromPeer = sender == net.remoteAddress && senderPort == net.remotePort;
+        if (!fromPeer && !(type == NET_HELLO && net.isHost && !net.connected))
+            continue;
+
+        if (type == NET_HELLO && net.isHost) {
+            // Accept the first guest, and answer their retries with the same seed
+            if (!net.connected) {
+                net.remoteAddress = sender;
+                net.remotePort = senderPort;
+                net.connected = true;
+                net.lastHeard.restart();
+            }
+            sf::Packet welcome;
+            welcome << NET_MAGIC << (sf::Uint8) NET_WELCOME << (sf::Uint32) net.seed << (sf::Uint16) net.fireRate;
+            net.socket.send(welcome, net.remoteAddress, net.remotePort);
+        }
+        else if (type == NET_WELCOME && !net.isHost && !net.connected) {
+            sf::Uint32 seed;
+            sf::Uint16 fireRate;
+            if (packet >> seed >> fireRate) {
+                net.seed = seed;
+                net.fireRate = fireRate;
+                net.connected = true;
+                net.lastHeard.restart();
+            }
+        }
+        else if (type == NET_INPUTS && net.connected && !net.disconnected) {
+            sf::Uint32 ack, start;
+            sf::Uint8 count;
+            if (!(packet >> ack >> start >> count))
+                continue;
+            net.lastHeard.restart();
+            // The peer cannot have confirmed ticks we have not sent yet
+            int acked = (int) min(ack, (sf::Uint32) net.localTick);
+            if (acked > net.remoteAcked)
+                net.remoteAcked = acked;
+
+            for (int i = 0; i < count; i++) {
+                sf::Uint8 input;
+                if (!(packet >> input))
+                    break;
+                int tick = start + i;
+                if (tick != net.remoteReceived)
+                    continue; // Already have it, or a gap we cannot use yet
+
+                // Ticks already simulated with a wrong guess must be replayed
+                int slot = tick % NET_INPUT_HISTORY;
+                if (tick < net.localTick && net.remoteInputs[slot] != input) {
+                    if (net.rollbackFrom < 0 || tick < net.rollbackFrom)
+                        net.rollbackFrom = tick;
+                }
+                net.remoteInputs[slot] = input;
+                net.remoteReceived++;
+            }
+        }
+    }
+
+    if (net.connected && !net.disconnected && net.lastHeard.getElapsedTime().asSeconds() > NET_TIMEOUT) {
+        // Carry on alone rather than waiting forever
+        cerr << "Netplay: opponent timed out" << endl;
+        net.disconnected = true;
+    }
+}
+
+void netplaySend(NetSession& net) {
+    if (!net.connected || net.disconnected)
+        return;
+
+    // Resend everything the peer has not confirmed yet, so lost packets heal themselves
+    int start = net.remoteAcked;
+    if (start < net.localTick - NET_MAX_INPUTS_PER_PACKET)
+        start = net.localTick - NET_MAX_INPUTS_PER_PACKET;
+    int count = net.localTick - start;
+    if (count == 0 && net.sendClock.getElapsedTime().asSeconds() < 0.1f)
+        return;
+
+    sf::Packet packet;
+    packet << NET_MAGIC << (sf::Uint8) NET_INPUTS << (sf::Uint32) net.remoteReceived << (sf::Uint32) start << (sf::Uint8) count;
+    for (int tick = start; tick < net.localTick; tick++) {
+        packet << (sf::Uint8) net.localInputs[tick % NET_INPUT_HISTORY];
+    }
+    net.socket.send(packet, net.remoteAddress, net.remotePort);
+    net.sendClock.restart();
+}
+
+bool netplayCanAdvance(const NetSession& net) {
+    if (!net.connected)
+        return false;
+    if (net.disconnected)
+        return true;
+    // Every unconfirmed remote tick must still have a snapshot to roll back to,
+    // and the peer must not fall so far behind that our unacked inputs stop fitting in a packet
+    return net.localTick - net.remoteReceived < NET_MAX_ROLLBACK &&
+           net.localTick - net.remoteAcked < NET_MAX_INPUTS_PER_PACKET;
+}
+
+void netplayAdvance(NetSession& net, unsigned char localInput) {
+    int tick = net.localTick;
+    net.localInputs[tick % NET_INPUT_HISTORY] = localInput;
+
+    if (!net.disconnected) {
+        // Predict a missing input by holding the last known direction, without firing
+        int slot = tick % NET_INPUT_HISTORY;
+        if (tick >= net.remoteReceived) {
+            unsigned char last = net.remoteReceived > 0 ? net.remoteInputs[(net.remoteReceived - 1) % NET_INPUT_HISTORY] : 0;
+            net.remoteInputs[slot] = last & ~INPUT_FIRE;
+        }
+        net.snapshots[tick % NET_MAX_ROLLBACK] = net.remoteWorld;
+        stepWorld(net.remoteWorld, net.remoteInputs[slot], nullptr);
+    }
+    net.localTick++;
+}
+
+void netplayRollback(NetSession& net) {
+    if (net.rollbackFrom < 0)
+        return;
+
+    sf::Clock rollbackClock;
+    int from = net.rollbackFrom;
+    net.rollbackFrom = -1;
+
+    // Restore the world as it was before the first wrong guess and replay up to now
+    net.remoteWorld = net.snapshots[from % NET_MAX_ROLLBACK];
+    for (int tick = from; tick < net.localTick; tick++) {
+        int slot = tick % NET_INPUT_HISTORY;
+        if (tick >= net.remoteReceived) {
+            unsigned char last = net.remoteInputs[(net.remoteReceived - 1) % NET_INPUT_HISTORY];
+            net.remoteInputs[slot] = last & ~INPUT_FIRE;
+        }
+        net.snapshots[tick % NET_MAX_ROLLBACK] = net.remoteWorld;
+        stepWorld(net.remoteWorld, net.remoteInputs[slot], nullptr);
+    }
+
+    net.rollbacks++;
+    net.resimulatedTicks += net.localTick - from;
+    net.lastRollbackMicros = rollbackClock.getElapsedTime().asMicroseconds();
+}
+
+void drawNetplayStatus(Canvas& window, HudText& hud, NetSession& net, GameSprites& sprites, sf::Texture& mushTexture) {
+    // Draw the opponent's field as a small inset in the top right corner
+    sf::View inset(sf::FloatRect(0, 0, resolutionX, resolutionY));
+    inset.setViewport(sf::FloatRect(0.74f, 0.01f, 0.25f, 0.25f));
+    sf::View previous = window.getView();
+    window.setView(inset);
+    window.draw(hud.inset);
+    drawWorld(window, net.remoteWorld, sprites, mushTexture, 0.0f);
+    window.setView(previous);
+
+    char status[HUD_LINE_LENGTH];
+    if (net.disconnected) {
+        snprintf(status, sizeof(status), "Opponent: %d (disconnected)", net.remoteWorld.player.score);
+    } else {
+        snprintf(status, sizeof(status), "Opponent: %d  Rollbacks: %d (%d us)", net.remoteWorld.player.score, net.rollbacks, (int) net.lastRollbackMicros);
+    }
+    setTextLine(hud.opponent, hud.line, status);
+    window.draw(hud.opponent);
+}
+
+// Leaderboard functions
+void leaderboardStart(LeaderboardClient& board, const GameOptions& options) {
+    board.enabled = true;
+    board.address = options.leaderboardAddress;
+    board.port = options.leaderboardPort;
+    board.name = options.playerName;
+    board.quit = false;
+    board.worker = thread(leaderboardWorker, &board);
+}
+
+void leaderboardStop(LeaderboardClient& board) {
+    if (!board.enabled)
+        return;
+    {
+        lock_guard<mutex> guard(board.lock);
+        board.quit = true;
+    }
+    board.wake.notify_all();
+    board.worker.join();
+    board.enabled = false;
+}
+
+void leaderboardSubmit(LeaderboardClient& board, int score) {
+    // Queue the score and return; the worker sends it
+    {
+        lock_guard<mutex> guard(board.lock);
+        board.pending.push_back(score);
+    }
+    board.rank = 0;
+    board.wake.notify_one();
+}
+
+void leaderboardWorker(LeaderboardClient* board) {
+    sf::TcpSocket socket;
+    bool connected = false;
+    while (true) {
+        int score;
+        {
+            unique_lock<mutex> guard(board->lock);
+            board->wake.wait(guard, [&] { return board->quit || !board->pending.empty(); });
+            if (board->quit)
+                break;
+            score = board->pending.front();
+            board->pending.erase(board->pending.begin());
+        }
+
+        // Keep the connection between games, and reconnect once if the daemon dropped it
+        sf::Packet request;
+        request << LEADERBOARD_MAGIC << (sf::Uint8) LB_SUBMIT << (sf::Uint32) score << board->name;
+        sf::Packet reply;
+        bool sent = false;
+        for (int attempt = 0; attempt < 2 && !sent; attempt++) {
+            if (!connected) {
+                socket.disconnect();
+                connected = socket.connect(board->address, board->port, sf::seconds(2)) == sf::Socket::Done;
+            }
+            sent = connected && socket.send(request) == sf::Socket::Done && socket.receive(reply) == sf::Socket::Done;
+            connected = sent;
+        }
+
+        sf::Uint32 magic, rank, best;
+        sf::Uint8 type;
+        if (sent && reply >> magic >> type >> rank >> best && magic == LEADERBOARD_MAGIC) {
+            board->rank = rank;
+        } else {
+            cerr << "Leaderboard: could not submit to " << board->address << ":" << board->port << endl;
+            board->rank = -1;
+        }
+    }
+    socket.disconnect();
+}
+
+void drawLeaderboardStatus(Canvas& window, sf::Font& font, LeaderboardClient& board) {
+    int rank = board.rank;
+    string status = rank > 0 ? "Leaderboard rank: " + to_string(rank) : rank < 0 ? "Leaderboard unavailable" : "Submitting score...";
+    sf::Text statusText(status, font, 30);
+    statusText.setFillColor(rank > 0 ? sf::Color::Yellow : sf::Color(160, 160, 160));
+    statusText.setPosition(resolutionX / 2 - statusText.getGlobalBounds().width / 2, 350);
+    window.draw(statusText);
+}
+
+// Capture functions
+bool captureStart(VideoCapture& capture, sf::RenderTexture& source, const string& path, int every) {
+    capture.path = path;
+    capture.y4m = path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+    capture.every = every;
+    capture.presented = 0;
+
+    // Every buffer is sized for the whole source up front, so capturing never allocates
+    unsigned int maxSize = source.getSize().x;
+    capture.freeFrames.clear();
+    capture.queued.clear();
+    for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+        capture.frames[i].pixels.assign(maxSize * maxSize * 4, 0);
+        capture.freeFrames.push_back(i);
+    }
+    for (int i = 0; i < CAPTURE_READBACKS; i++) {
+        capture.readbackFrame[i] = -1;
+    }
+
+    // Pixel buffer objects need OpenGL 2.1; without them each readback waits for the GPU
+    capture.asyncReadback = false;
+#ifdef CAPTURE_ASYNC_READBACK
+    source.setActive(true);
+    const char* version = (const char*) glGetString(GL_VERSION);
+    int major = 0, minor = 0;
+    if (version && sscanf(version, "%d.%d", &major, &minor) == 2 && (major > 2 || (major == 2 && minor >= 1))) {
+        glGenBuffers(CAPTURE_READBACKS, capture.readbacks);
+        capture.asyncReadback = true;
+    }
+#endif
+
+    if (capture.y4m) {
+        // The writer opens the stream itself; check now that it can
+        FILE* video = fopen(path.c_str(), "wb");
+        if (!video)
+            return false;
+        fclose(video);
+    }
+    capture.quit = false;
+    capture.enabled = true;
+    capture.writer = thread(captureWriter, &capture);
+    return true;
+}
+
+void captureStop(VideoCapture& capture, sf::RenderTexture& source) {
+    if (!capture.enabled)
+        return;
+
+    // Collect the readbacks still in flight, oldest first, then let the writer drain
+    source.setActive(true);
+    for (int i = 0; i < CAPTURE_READBACKS; i++) {
+        int slot = (capture.nextReadback + i) % CAPTURE_READBACKS;
+        if (capture.readbackFrame[slot] >= 0)
+            captureCollect(capture, slot);
+    }
+#ifdef CAPTURE_ASYNC_READBACK
+    if (capture.asyncReadback)
+        glDeleteBuffers(CAPTURE_READBACKS, capture.readbacks);
+#endif
+    {
+        lock_guard<mutex> guard(capture.lock);
+        capture.quit = true;
+    }
+    capture.wake.notify_all();
+    capture.writer.join();
+    capture.enabled = false;
+    printCaptureReport(capture);
+}
+
+void captureFrame(VideoCapture& capture, sf::RenderTexture& source, unsigned int size) {
+    long long number = capture.presented++;
+    if (number % capture.every != 0)
+        return;
+    sf::Clock captureClock;
+
+    // The scene is drawn into its top-left corner, which OpenGL counts from the bottom
+    source.setActive(true);
+    int bottom = source.getSize().y - size;
+
+#ifdef CAPTURE_ASYNC_READBACK
+    if (capture.asyncReadback) {
+        // Reuse the oldest readback; it has had a frame or more to finish
+        int slot = capture.nextReadback;
+        if (capture.readbackFrame[slot] >= 0)
+            captureCollect(capture, slot);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.readbacks[slot]);
+        if (capture.readbackCapacity[slot] < size) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, size * size * 4, nullptr, GL_STREAM_READ);
+            capture.readbackCapacity[slot] = size;
+        }
+        glReadPixels(0, bottom, size, size, GL_RGBA, GL_UNSIGNED_BYTE, nullptr); // Returns before the copy is done
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        capture.readbackFrame[slot] = number;
+        capture.readbackSize[slot] = size;
+        capture.nextReadback = (slot + 1) % CAPTURE_READBACKS;
+        capture.mainMicros += captureClock.getElapsedTime().asMicroseconds();
+        return;
+    }
+#endif
+
+    // Synchronous fallback: read straight into a free buffer
+    int buffer = captureTakeBuffer(capture);
+    if (buffer >= 0) {
+        glReadPixels(0, bottom, size, size, GL_RGBA, GL_UNSIGNED_BYTE, capture.frames[buffer].pixels.data());
+        captureQueue(capture, buffer, size, number);
+    }
+    capture.mainMicros += captureClock.getElapsedTime().asMicroseconds();
+}
+
+void captureCollect(VideoCapture& capture, int slot) {
+    // Copy a finished readback into a free buffer and hand it to the writer
+#ifdef CAPTURE_ASYNC_READBACK
+    int buffer = captureTakeBuffer(capture);
+    if (buffer >= 0) {
+        unsigned int size = capture.readbackSize[slot];
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.readbacks[slot]);
+        const void* pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        if (pixels) {
+            memcpy(capture.frames[buffer].pixels.data(), pixels, size * size * 4);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            captureQueue(capture, buffer, size, capture.readbackFrame[slot]);
+        } else {
+            lock_guard<mutex> guard(capture.lock);
+            capture.freeFrames.push_back(buffer);
+            capture.dropped++;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+#endif
+    capture.readbackFrame[slot] = -1;
+}
+
+int captureTakeBuffer(VideoCapture& capture) {
+    // A free buffer, or -1 (and a dropped frame) if the writer has them all
+    lock_guard<mutex> guard(capture.lock);
+    if (capture.freeFrames.empty()) {
+        capture.dropped++;
+        return -1;
+    }
+    int buffer = capture.freeFrames.back();
+    capture.freeFrames.pop_back();
+    return buffer;
+}
+
+void captureQueue(VideoCapture& capture, int buffer, unsigned int size, long long number) {
+    capture.frames[buffer].size = size;
+    capture.frames[buffer].number = number;
+    {
+        lock_guard<mutex> guard(capture.lock);
+        capture.queued.push_back(buffer);
+    }
+    capture.captured++;
+    capture.wake.notify_one();
+}
+
+void captureWriter(VideoCapture* capture) {
+    // The video keeps the size of its first frame; frames of another size
+    // (the dynamic scale moved) are skipped
+    FILE* video = nullptr;
+    unsigned int videoSize = 0;
+    vector<sf::Uint8> scratch;
+    while (true) {
+        int buffer;
+        {
+            unique_lock<mutex> guard(capture->lock);
+            capture->wake.wait(guard, [&] { return capture->quit || !capture->queued.empty(); });
+            if (capture->queued.empty())
+                break; // Quitting, and everything has been written
+            buffer = capture->queued.front();
+            capture->queued.erase(capture->queued.begin());
+        }
+
+        sf::Clock writeClock;
+        const CaptureFrame& frame = capture->frames[buffer];
+        bool written = false;
+        if (!capture->y4m) {
+            written = writeCapturePNG(frame, capture->path, scratch);
+        } else {
+            if (!video) {
+                // 4:2:0 chroma needs even dimensions
+                videoSize = frame.size & ~1u;
+                video = fopen(capture->path.c_str(), "wb");
+                if (video)
+                    fprintf(video, "YUV4MPEG2 W%u H%u F%d:%d Ip A1:1 C420jpeg\n", videoSize, videoSize, CAPTURE_FPS, capture->every);
+            }
+            written = video && (frame.size & ~1u) == videoSize;
+            if (written)
+                writeCaptureY4M(frame, video, videoSize, scratch);
+        }
+        capture->writeMicros += writeClock.getElapsedTime().asMicroseconds();
+        if (written) {
+            capture->written++;
+        } else {
+            capture->skipped++;
+        }
+
+        lock_guard<mutex> guard(capture->lock);
+        capture->freeFrames.push_back(buffer);
+    }
+    if (video)
+        fclose(video);
+}
+
+bool writeCapturePNG(const CaptureFrame& frame, const string& prefix, vector<sf::Uint8>& scratch) {
+    // Flip to top row first, then number the file by the frame it came from
+    size_t row = frame.size * 4;
+    scratch.resize(row * frame.size);
+    for (unsigned int r = 0; r < frame.size; r++) {
+        memcpy(&scratch[r * row], &frame.pixels[(frame.size - 1 - r) * row], row);
+    }
+    sf::Image image;
+    image.create(frame.size, frame.size, scratch.data());
+    char number[16];
+    snprintf(number, sizeof(number), "%06lld", frame.number);
+    return image.saveToFile(prefix + number + ".png");
+}
+
+void writeCaptureY4M(const CaptureFrame& frame, FILE* video, unsigned int videoSize, vector<sf::Uint8>& scratch) {
+    // Full-range BT.601 (what C420jpeg means), in 16.16 fixed point, with each
+    // chroma sample the average of a 2x2 block. Rows are flipped on the way.
+    unsigned int half = videoSize / 2;
+    scratch.resize(videoSize * videoSize + 2 * half * half);
+    sf::Uint8* luma = scratch.data();
+    sf::Uint8* cb = luma + videoSize * videoSize;
+    sf::Uint8* cr = cb + half * half;
+    for (unsigned int r = 0; r < videoSize; r++) {
+        const sf::Uint8* src = &frame.pixels[(size_t) (frame.size - 1 - r) * frame.size * 4];
+        for (unsigned int c = 0; c < videoSize; c++) {
+            int red = src[c * 4], green = src[c * 4 + 1], blue = src[c * 4 + 2];
+            luma[r * videoSize + c] = (19595 * red + 38470 * green + 7471 * blue + 32768) >> 16;
+        }
+    }
+    for (unsigned int r = 0; r < half; r++) {
+        const sf::Uint8* top = &frame.pixels[(size_t) (frame.size - 1 - 2 * r) * frame.size * 4];
+        const sf::Uint8* bottom = top - frame.size * 4;
+        for (unsigned int c = 0; c < half; c++) {
+            int red = top[c * 8] + top[c * 8 + 4] + bottom[c * 8] + bottom[c * 8 + 4];
+            int green = top[c * 8 + 1] + top[c * 8 + 5] + bottom[c * 8 + 1] + bottom[c * 8 + 5];
+            int blue = top[c * 8 + 2] + top[c * 8 + 6] + bottom[c * 8 + 2] + bottom[c * 8 + 6];
+            cb[r * half + c] = min(255, (-11059 * red - 21709 * green + 32768 * blue + (128 << 18) + (1 << 17)) >> 18);
+            cr[r * half + c] = min(255, (32768 * red - 27439 * green - 5329 * blue + (128 << 18) + (1 << 17)) >> 18);
+        }
+    }
+    fputs("FRAME\n", video);
+    fwrite(scratch.data(), 1, scratch.size(), video);
+}
+
+void printCaptureReport(const VideoCapture& capture) {
+    long long captured = max(1LL, capture.captured);
+    long long written = max(1LL, capture.written.load());
+    cout << "Recording " << capture.path << (capture.asyncReadback ? " (async readback)" : " (sync readback)") << endl;
+    cout << "  frames: " << capture.presented << " presented, " << capture.captured << " captured, "
+         << capture.written.load() << " written, " << capture.dropped << " dropped, " << capture.skipped.load() << " skipped" << endl;
+    cout << "  main thread: " << (float) capture.mainMicros / captured << " us per captured frame" << endl;
+    cout << "  writer: " << (float) capture.writeMicros.load() / written / 1000.0f << " ms per frame" << endl;
+}
+
+// Job functions
+thread_local int jobThread = 0; // This thread's queue; the main thread and any other caller use the first
+
+void jobsStart(JobSystem& jobs, int threads) {
+    // The caller works too, so start one worker fewer than the thread count
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    jobs.threads = min(threads, MAX_JOB_THREADS);
+    jobs.queues.reset(new JobQueue[jobs.threads]);
+    jobs.quit = false;
+    for (int i = 1; i < jobs.threads; i++) {
+        jobs.workers.push_back(thread(jobsWorker, &jobs, i));
+    }
+}
+
+void jobsStop(JobSystem& jobs) {
+    {
+        lock_guard<mutex> guard(jobs.sleepLock);
+        jobs.quit = true;
+    }
+    jobs.wake.notify_all();
+    for (thread& worker : jobs.workers) {
+        worker.join();
+    }
+    jobs.workers.clear();
+}
+
+void jobsPush(JobSystem& jobs, const Job& job) {
+    bool queued = false;
+    {
+        JobQueue& queue = jobs.queues[jobThread];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.count < MAX_QUEUED_JOBS) {
+            queue.jobs[(queue.first + queue.count) % MAX_QUEUED_JOBS] = job;
+            queue.count++;
+            queued = true;
+        }
+    }
+    if (!queued) {
+        // Our queue is full: do it now rather than wait for room
+        job.run(job.context, job.begin, job.end);
+        (*job.pending)--;
+        return;
+    }
+    jobs.queued++;
+    // Taking the lock means a worker deciding to sleep has either seen the job or is already waiting
+    {
+        lock_guard<mutex> guard(jobs.sleepLock);
+    }
+    jobs.wake.notify_one();
+}
+
+bool jobsRunOne(JobSystem& jobs, int self) {
+    // Newest of our own first, then the oldest of anyone else's
+    Job job;
+    bool found = false;
+    {
+        JobQueue& queue = jobs.queues[self];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.count > 0) {
+            queue.count--;
+            job = queue.jobs[(queue.first + queue.count) % MAX_QUEUED_JOBS];
+            found = true;
+        }
+    }
+    for (int i = 1; i < jobs.threads && !found; i++) {
+        JobQueue& queue = jobs.queues[(self + i) % jobs.threads];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.count > 0) {
+            job = queue.jobs[queue.first];
+            queue.first = (queue.first + 1) % MAX_QUEUED_JOBS;
+            queue.count--;
+            found = true;
+            jobs.steals++;
+        }
+    }
+    if (!found)
+        return false;
+    jobs.queued--;
+    job.run(job.context, job.begin, job.end);
+    jobs.jobsRun++;
+    (*job.pending)--;
+    return true;
+}
+
+void jobsWait(JobSystem& jobs, atomic<int>& pending) {
+    // Help out until everything we are waiting for is done. The last jobs may
+    // be running elsewhere, and only take microseconds, so spin rather than sleep.
+    while (pending > 0) {
+        if (!jobsRunOne(jobs, jobThread))
+            this_thread::yield();
+    }
+}
+
+void jobsWorker(JobSystem* jobs, int self) {
+    jobThread = self;
+    while (true) {
+        if (jobsRunOne(*jobs, self))
+            continue;
+        unique_lock<mutex> guard(jobs->sleepLock);
+        jobs->wake.wait(guard, [&] { return jobs->quit || jobs->queued > 0; });
+        if (jobs->quit)
+            return;
+    }
+}
+
+void parallelFor(JobSystem* jobs, int count, int grain, void (*run)(void* context, int begin, int end), void* context) {
+    // Split 0..count-1 into chunks of grain; the caller takes the first chunk itself
+    if (!jobs || jobs->threads == 1 || count <= grain) {
+        run(context, 0, count);
+        return;
+    }
+    int chunks = (count + grain - 1) / grain;
+    atomic<int> pending{chunks - 1};
+    for (int c = 1; c < chunks; c++) {
+        jobsPush(*jobs, {run, context, c * grain, min(count, (c + 1) * grain), &pending});
+    }
+    run(context, 0, grain);
+    jobsWait(*jobs, pending);
+}
+
+// Analytics functions
+void addRecord(TickRecords& records, int kind, int subject, Fixed posX, Fixed posY) {
+    if (records.count == MAX_TICK_RECORDS)
+        return;
+    TickRecord& record = records.items[records.count++];
+    record.posX = fixedToFloat(posX);
+    record.posY = fixedToFloat(posY);
+    record.kind = kind;
+    record.subject = subject;
+}
+
+bool analyticsStart(AnalyticsLog& log, const string& path) {
+    // Logs are appended to, so one file can collect any number of runs
+    log.file = fopen(path.c_str(), "ab");
+    if (!log.file)
+        return false;
+    if (ftell(log.file) == 0) {
+        AnalyticsFileHeader header = {ANALYTICS_MAGIC, ANALYTICS_VERSION};
+        fwrite(&header, sizeof(header), 1, log.file);
+    }
+    log.path = path;
+
+    // Every block is allocated up front, so logging never allocates
+    log.blocks.reset(new AnalyticsEvents[ANALYTICS_BUFFERS]);
+    log.freeBlocks.clear();
+    log.queued.clear();
+    for (int i = 0; i < ANALYTICS_BUFFERS; i++) {
+        log.blocks[i].count = 0;
+        log.blocks[i].endsSession = false;
+        if (i > 0)
+            log.freeBlocks.push_back(i);
+    }
+    log.current = 0;
+    log.quit = false;
+    log.enabled = true;
+    log.writer = thread(analyticsWriter, &log);
+    return true;
+}
+
+void analyticsStop(AnalyticsLog& log, const GameWorld& world) {
+    if (!log.enabled)
+        return;
+
+    // A game still running ends here; anything else gathered goes out with it
+    if (log.inSession) {
+        analyticsEndSession(log, world);
+    } else if (log.blocks[log.current].count > 0) {
+        analyticsHandOff(log);
+    }
+    {
+        lock_guard<mutex> guard(log.lock);
+        log.quit = true;
+    }
+    log.wake.notify_all();
+    log.writer.join();
+    fclose(log.file);
+    log.file = nullptr;
+    log.enabled = false;
+    printAnalyticsReport(log);
+}
+
+void analyticsBeginSession(AnalyticsLog& log, const GameWorld& world, bool autopilot) {
+    if (!log.enabled)
+        return;
+    log.inSession = true;
+    log.level = world.level;
+    log.levelStartTick = world.tick;
+    memset(log.frames, 0, sizeof(log.frames));
+    log.sessions++;
+    analyticsAppend(log, world, AE_START, AS_NONE, 0, autopilot ? 1 : 0);
+}
+
+void analyticsEndSession(AnalyticsLog& log, const GameWorld& world) {
+    if (!log.inSession)
+        return;
+    log.inSession = false;
+    analyticsAppend(log, world, AE_END, AS_NONE, analyticsCell(fixedToFloat(world.player.position[x]), fixedToFloat(world.player.position[y])), world.player.score);
+
+    // The frame times travel with the block that ends the session, which goes out now
+    AnalyticsEvents& block = log.blocks[log.current];
+    memcpy(block.frames, log.frames, sizeof(log.frames));
+    block.endsSession = true;
+    analyticsHandOff(log);
+}
+
+void analyticsTick(AnalyticsLog& log, const GameWorld& world) {
+    if (!log.inSession)
+        return;
+    for (int i = 0; i < world.records.count; i++) {
+        const TickRecord& record = world.records.items[i];
+        analyticsAppend(log, world, record.kind, record.subject, analyticsCell(record.posX, record.posY), 0);
+    }
+
+    // A level is timed from the tick the last one was cleared. Rewinding or
+    // quick loading moves the world back, and the clock starts again from there.
+    if (world.level > log.level) {
+        analyticsAppend(log, world, AE_LEVEL, AS_NONE, 0, world.tick - log.levelStartTick);
+    }
+    if (world.level != log.level || world.tick < log.levelStartTick) {
+        log.level = world.level;
+        log.levelStartTick = world.tick;
+    }
+}
+
+void analyticsFrame(AnalyticsLog& log, float deltaTime) {
+    if (log.inSession)
+        log.frames[analyticsFrameBucket(deltaTime * 1000000.0f)]++;
+}
+
+void analyticsAppend(AnalyticsLog& log, const GameWorld& world, int kind, int subject, int cell, uint32_t value) {
+    // Events are filed under the level being played, so a level's last kills count towards it
+    AnalyticsEvents& block = log.blocks[log.current];
+    int i = block.count++;
+    block.tick[i] = world.tick;
+    block.value[i] = value;
+    block.level[i] = log.level;
+    block.cell[i] = cell;
+    block.kind[i] = kind;
+    block.subject[i] = subject;
+    log.events++;
+    if (block.count == ANALYTICS_BLOCK_EVENTS)
+        analyticsHandOff(log);
+}
+
+void analyticsHandOff(AnalyticsLog& log) {
+    // Queue the block being filled and carry on in a free one. With none free
+    // the writer is behind, and the block's events are dropped instead.
+    {
+        lock_guard<mutex> guard(log.lock);
+        if (log.freeBlocks.empty()) {
+            AnalyticsEvents& block = log.blocks[log.current];
+            log.dropped += block.count;
+            block.count = 0;
+            block.endsSession = false;
+            return;
+        }
+        log.queued.push_back(log.current);
+        log.current = log.freeBlocks.back();
+        log.freeBlocks.pop_back();
+    }
+    log.wake.notify_one();
+}
+
+void analyticsWriter(AnalyticsLog* log) {
+    while (true) {
+        int buffer;
+        {
+            unique_lock<mutex> guard(log->lock);
+            log->wake.wait(guard, [&] { return log->quit || !log->queued.empty(); });
+            if (log->queued.empty())
+                break; // Quitting, and everything has been written
+            buffer = log->queued.front();
+            log->queued.erase(log->queued.begin());
+        }
+
+        sf::Clock writeClock;
+        AnalyticsEvents& block = log->blocks[buffer];
+        log->written += writeAnalyticsBlocks(block, log->file);
+        if (block.endsSession)
+            fflush(log->file); // A finished game is on disk even if the game later crashes
+        log->writeMicros += writeClock.getElapsedTime().asMicroseconds();
+        block.count = 0;
+        block.endsSession = false;
+
+        lock_guard<mutex> guard(log->lock);
+        log->freeBlocks.push_back(buffer);
+    }
+}
+
+size_t writeAnalyticsBlocks(const AnalyticsEvents& block, FILE* file) {
+    // The events block, one padded column after another, then the frame times
+    // if the block ends a session. Returns the bytes written.
+    static const uint8_t padding[4] = {};
+    size_t bytes = 0;
+    uint32_t count = block.count;
+    if (count > 0) {
+        AnalyticsBlockHeader header = {AB_EVENTS, count};
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(block.tick, sizeof(uint32_t), count, file);
+        fwrite(block.value, sizeof(uint32_t), count, file);
+        fwrite(block.level, sizeof(uint16_t), count, file);
+        fwrite(padding, 1, analyticsPad(2 * count) - 2 * count, file);
+        fwrite(block.cell, sizeof(uint16_t), count, file);
+        fwrite(padding, 1, analyticsPad(2 * count) - 2 * count, file);
+        fwrite(block.kind, sizeof(uint8_t), count, file);
+        fwrite(padding, 1, analyticsPad(count) - count, file);
+        fwrite(block.subject, sizeof(uint8_t), count, file);
+        fwrite(padding, 1, analyticsPad(count) - count, file);
+        bytes += sizeof(header) + analyticsBlockBytes(AB_EVENTS, count);
+    }
+    if (block.endsSession) {
+        AnalyticsBlockHeader header = {AB_FRAMES, ANALYTICS_FRAME_BUCKETS};
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(block.frames, sizeof(uint32_t), ANALYTICS_FRAME_BUCKETS, file);
+        bytes += sizeof(header) + analyticsBlockBytes(AB_FRAMES, ANALYTICS_FRAME_BUCKETS);
+    }
+    return bytes;
+}
+
+void printAnalyticsReport(const AnalyticsLog& log) {
+    cout << "Session log " << log.path << endl;
+    cout << "  " << log.sessions << " sessions, " << log.events << " events, " << log.dropped << " dropped" << endl;
+    cout << "  writer: " << log.written.load() << " bytes in " << log.writeMicros.load() / 1000.0f << " ms" << endl;
+}
+
+// Spectator functions
+bool spectatorStart(SpectatorStream& stream, unsigned short port) {
+    if (stream.listener.listen(port) != sf::Socket::Done)
+        return false;
+    stream.listener.setBlocking(false);
+    stream.port = port;
+    stream.ring.reset(new unsigned char[SPECTATOR_RING_BYTES]);
+    stream.head = 0;
+    stream.tail = 0;
+    stream.resync = true;
+    stream.quit = false;
+    stream.enabled = true;
+    stream.sender = thread(spectatorSender, &stream);
+    cout << "Spectators can connect on port " << port << endl;
+    return true;
+}
+
+void spectatorStop(SpectatorStream& stream) {
+    if (!stream.enabled)
+        return;
+    stream.quit = true;
+    stream.sender.join();
+    for (SpectatorConnection& spectator : stream.spectators) {
+        stream.finished.push_back(spectatorReportLine(spectator));
+    }
+    stream.spectators.clear();
+    stream.listener.close();
+    stream.enabled = false;
+    printSpectatorReport(stream);
+}
+
+void buildSpectatorView(const GameWorld& world, SpectatorView& view) {
+    view.tick = world.tick;
+    view.score = max(0, world.player.score);
+    view.lives = min(max(0, world.player.lives), 255);
+    view.level = min(max(0, world.level), 65535);
+    for (SpectatorSlot& slot : view.slots) {
+        slot = {0, 0, SS_NONE};
+    }
+    auto place = [&](int slot, Fixed posX, Fixed posY, uint8_t look) {
+        view.slots[slot] = {spectatorPixel(fixedToFloat(posX)), spectatorPixel(fixedToFloat(posY)), look};
+    };
+
+    if (world.player.lives > 0) {
+        place(0, world.player.position[x], world.player.position[y], spectatorLook(SS_PLAYER, world.player.animation.currentFrame & 15));
+    }
+    for (int i = 0; i < world.bullets.count; i++) {
+        place(SPECTATOR_FIRST_BULLET + i, world.bullets.posX[i], world.bullets.posY[i], SS_BULLET);
+    }
+    for (int i = 0; i < world.centipedeLength; i++) {
+        if (world.centipede[i][4])
+            place(SPECTATOR_FIRST_SEGMENT + i, world.centipede[i][x], world.centipede[i][y], world.centipede[i][2] ? SS_HEAD : SS_SEGMENT);
+    }
+    for (int i = 0; i < MAX_HEADS; i++) {
+        if (world.centipedeheads[i][2])
+            place(SPECTATOR_FIRST_HEAD + i, world.centipedeheads[i][x], world.centipedeheads[i][y], SS_HEAD);
+    }
+    for (int i = 0; i < world.enemies.count; i++) {
+        const Enemy& e = world.enemies.items[i];
+        if (!e.alive)
+            continue;
+        uint8_t look = e.kind == ENEMY_FLEA ? SS_FLEA : e.kind == ENEMY_SCORPION ? SS_SCORPION
+                     : spectatorLook(SS_SPIDER, !e.shot ? 0 : e.points == 900 ? 3 : e.points == 600 ? 2 : 1);
+        place(SPECTATOR_FIRST_ENEMY + i, e.posX, e.posY, look);
+    }
+    for (int i = 0; i < world.nmush; i++) {
+        if (world.mush[i][3]) {
+            int frame = min((int) world.mush[i][2], 3) | (world.mush[i][5] ? 4 : 0);
+            place(SPECTATOR_FIRST_MUSHROOM + i, world.mush[i][0], world.mush[i][1], spectatorLook(SS_MUSHROOM, frame));
+        }
+    }
+}
+
+unsigned char* putSlotUpdate(unsigned char* out, int slot, const SpectatorSlot& from, const SpectatorSlot& to) {
+    // The cheapest operation that turns from into to
+    int dx = to.x - from.x;
+    int dy = to.y - from.y;
+    int op;
+    if (to.look == SS_NONE)
+        op = SO_REMOVE;
+    else if (from.look == SS_NONE)
+        op = SO_SET;
+    else if (dx == 0 && dy == 0)
+        op = SO_LOOK;
+    else if (from.look == to.look && dx >= -128 && dx <= 127 && dy >= -128 && dy <= 127)
+        op = SO_MOVE;
+    else
+        op = SO_SET;
+
+    spectatorPut16(out, slot | op << 14);
+    if (op == SO_MOVE) {
+        *out++ = (uint8_t) (int8_t) dx;
+        *out++ = (uint8_t) (int8_t) dy;
+    } else if (op == SO_SET) {
+        *out++ = to.look;
+        spectatorPut16(out, (uint16_t) to.x);
+        spectatorPut16(out, (uint16_t) to.y);
+    } else if (op == SO_LOOK) {
+        *out++ = to.look;
+    }
+    return out;
+}
+
+size_t encodeSpectatorKeyframe(const SpectatorView& view, unsigned char* out) {
+    unsigned char* start = out;
+    out += 2; // Length, filled in last
+    *out++ = SM_KEYFRAME;
+    spectatorPut32(out, view.tick);
+    spectatorPut32(out, view.score);
+    *out++ = view.lives;
+    spectatorPut16(out, view.level);
+    unsigned char* countAt = out;
+    out += 2;
+    int count = 0;
+    const SpectatorSlot empty = {0, 0, SS_NONE};
+    for (int i = 0; i < SPECTATOR_SLOTS; i++) {
+        if (view.slots[i].look != SS_NONE) {
+            out = putSlotUpdate(out, i, empty, view.slots[i]);
+            count++;
+        }
+    }
+    spectatorPut16(countAt, count);
+    unsigned char* lengthAt = start;
+    spectatorPut16(lengthAt, out - start - 2);
+    return out - start;
+}
+
+size_t encodeSpectatorDelta(const SpectatorView& from, const SpectatorView& to, unsigned char* out) {
+    // Nothing at all when nothing a spectator sees has changed
+    unsigned char* start = out;
+    out += 2; // Length, filled in last
+    *out++ = SM_DELTA;
+    spectatorPut32(out, to.tick);
+    int fields = (to.score != from.score ? SF_SCORE : 0) | (to.lives != from.lives ? SF_LIVES : 0) | (to.level != from.level ? SF_LEVEL : 0);
+    *out++ = fields;
+    if (fields & SF_SCORE)
+        spectatorPut32(out, to.score);
+    if (fields & SF_LIVES)
+        *out++ = to.lives;
+    if (fields & SF_LEVEL)
+        spectatorPut16(out, to.level);
+    unsigned char* countAt = out;
+    out += 2;
+    int count = 0;
+    for (int i = 0; i < SPECTATOR_SLOTS; i++) {
+        const SpectatorSlot& a = from.slots[i];
+        const SpectatorSlot& b = to.slots[i];
+        if (a.look == b.look && (b.look == SS_NONE || (a.x == b.x && a.y == b.y)))
+            continue;
+        out = putSlotUpdate(out, i, a, b);
+        count++;
+    }
+    if (count == 0 && fields == 0)
+        return 0;
+    spectatorPut16(countAt, count);
+    unsigned char* lengthAt = start;
+    spectatorPut16(lengthAt, out - start - 2);
+    return out - start;
+}
+
+void spectatorPublish(SpectatorStream& stream, const GameWorld& world) {
+    if (!stream.enabled)
+        return;
+    buildSpectatorView(world, stream.next);
+    if (stream.keyframeWanted.exchange(false, memory_order_relaxed))
+        stream.resync = true;
+    bool keyframe = stream.resync || ++stream.sinceKeyframe >= SPECTATOR_KEYFRAME_TICKS;
+    size_t size = keyframe ? encodeSpectatorKeyframe(stream.next, stream.message)
+                           : encodeSpectatorDelta(stream.sent, stream.next, stream.message);
+    if (size == 0)
+        return;
+    if (!spectatorRingPush(stream, stream.message, size)) {
+        // The network thread is behind: spectators miss this, so catch them up with a keyframe
+        stream.dropped++;
+        stream.resync = true;
+        return;
+    }
+    if (keyframe) {
+        stream.keyframes++;
+        stream.sinceKeyframe = 0;
+        stream.resync = false;
+    }
+    stream.sent = stream.next;
+    stream.messages++;
+    stream.published += size;
+}
+
+bool spectatorRingPush(SpectatorStream& stream, const unsigned char* data, size_t size) {
+    // Only the main thread moves head and only the network thread moves tail
+    size_t head = stream.head.load(memory_order_relaxed);
+    size_t tail = stream.tail.load(memory_order_acquire);
+    if (SPECTATOR_RING_BYTES - (head - tail) < size)
+        return false;
+    size_t at = head & (SPECTATOR_RING_BYTES - 1);
+    size_t first = min(size, SPECTATOR_RING_BYTES - at);
+    memcpy(&stream.ring[at], data, first);
+    memcpy(&stream.ring[0], data + first, size - first);
+    stream.head.store(head + size, memory_order_release);
+    return true;
+}
+
+void spectatorSender(SpectatorStream* stream) {
+    vector<unsigned char> message(SPECTATOR_MAX_MESSAGE);
+    unique_ptr<sf::TcpSocket> incoming(new sf::TcpSocket);
+    while (!stream->quit) {
+        bool busy = false;
+
+        // Take in new spectators; they start with the hello and wait for a keyframe
+        if (stream->spectators.size() < MAX_SPECTATORS && stream->listener.accept(*incoming) == sf::Socket::Done) {
+            incoming->setBlocking(false);
+            SpectatorConnection spectator;
+            spectator.address = incoming->getRemoteAddress().toString();
+            spectator.socket = move(incoming);
+            incoming.reset(new sf::TcpSocket);
+            unsigned char hello[11];
+            unsigned char* out = hello;
+            spectatorPut16(out, 9);
+            *out++ = SM_HELLO;
+            spectatorPut32(out, SPECTATOR_MAGIC);
+            spectatorPut32(out, SPECTATOR_VERSION);
+            spectator.queue.assign(hello, out);
+            cout << "Spectator " << spectator.address << " joined" << endl;
+            stream->spectators.push_back(move(spectator));
+            stream->keyframeWanted = true;
+            busy = true;
+        }
+
+        // Hand every message in the ring to every spectator
+        size_t head = stream->head.load(memory_order_acquire);
+        size_t tail = stream->tail.load(memory_order_relaxed);
+        while (tail != head) {
+            unsigned char length[2];
+            for (int i = 0; i < 2; i++)
+                length[i] = stream->ring[(tail + i) & (SPECTATOR_RING_BYTES - 1)];
+            const unsigned char* in = length;
+            size_t size = 2 + spectatorGet16(in);
+            for (size_t i = 0; i < size; i++)
+                message[i] = stream->ring[(tail + i) & (SPECTATOR_RING_BYTES - 1)];
+            tail += size;
+            for (SpectatorConnection& spectator : stream->spectators) {
+                queueSpectatorMessage(*stream, spectator, message.data(), size);
+            }
+            busy = true;
+        }
+        stream->tail.store(tail, memory_order_release);
+
+        // Send what each socket takes without waiting
+        for (size_t i = 0; i < stream->spectators.size();) {
+            SpectatorConnection& spectator = stream->spectators[i];
+            size_t before = spectator.sent;
+            if (!sendToSpectator(spectator)) {
+                cout << "Spectator " << spectator.address << " left" << endl;
+                stream->finished.push_back(spectatorReportLine(spectator));
+                stream->spectators.erase(stream->spectators.begin() + i);
+                continue;
+            }
+            busy |= spectator.sent != before;
+            i++;
+        }
+
+        if (!busy) {
+            this_thread::sleep_for(chrono::milliseconds(2));
+        }
+    }
+}
+
+void queueSpectatorMessage(SpectatorStream& stream, SpectatorConnection& spectator, const unsigned char* data, size_t size) {
+    bool keyframe = data[2] == SM_KEYFRAME;
+    if (!spectator.synced && !keyframe)
+        return; // Deltas are useless until it has a keyframe to apply them to
+    if (spectator.queue.size() - spectator.sent + size > SPECTATOR_BACKLOG) {
+        // Too far behind: keep the message on the wire, drop the rest and
+        // pick up again at the next keyframe
+        spectator.queue.resize(spectator.messageEnd);
+        spectator.synced = false;
+        spectator.resyncs++;
+        stream.keyframeWanted = true;
+        return;
+    }
+    spectator.queue.insert(spectator.queue.end(), data, data + size);
+    spectator.synced = true;
+}
+
+bool sendToSpectator(SpectatorConnection& spectator) {
+    // False once the spectator has gone
+    if (spectator.sent < spectator.queue.size()) {
+        size_t sent = 0;
+        sf::Socket::Status status = spectator.socket->send(&spectator.queue[spectator.sent], spectator.queue.size() - spectator.sent, sent);
+        if (status == sf::Socket::Disconnected || status == sf::Socket::Error)
+            return false;
+        spectator.sent += sent;
+        spectator.bytes += sent;
+    }
+
+    // Track the boundary after the message on the wire, and drop what has
+    // been sent once the queue is empty or at a boundary far in
+    const unsigned char* queue = spectator.queue.data();
+    while (spectator.messageEnd < spectator.sent) {
+        spectator.messageEnd += 2 + (queue[spectator.messageEnd] | queue[spectator.messageEnd + 1] << 8);
+    }
+    if (spectator.sent == spectator.messageEnd && (spectator.sent == spectator.queue.size() || spectator.sent >= SPECTATOR_BACKLOG)) {
+        spectator.queue.erase(spectator.queue.begin(), spectator.queue.begin() + spectator.sent);
+        spectator.sent = 0;
+        spectator.messageEnd = 0;
+    }
+    return true;
+}
+
+string spectatorReportLine(const SpectatorConnection& spectator) {
+    float seconds = max(spectator.connected.getElapsedTime().asSeconds(), 0.001f);
+    char line[160];
+    snprintf(line, sizeof(line), "%s: %lld bytes in %.1f s (%.1f KB/s), %d resyncs", spectator.address.c_str(), spectator.bytes,
+             seconds, spectator.bytes / seconds / 1024, spectator.resyncs);
+    return line;
+}
+
+void printSpectatorReport(const SpectatorStream& stream) {
+    cout << "Spectator stream on port " << stream.port << endl;
+    cout << "  " << stream.messages << " messages (" << stream.keyframes << " keyframes), " << stream.published << " bytes, "
+         << stream.dropped << " dropped" << endl;
+    for (const string& line : stream.finished) {
+        cout << "  " << line << endl;
+    }
+}
+
+// Mushroom field functions
+void generateMushroomField(MushroomField& field, unsigned int seed, const FieldSpec& spec) {
+    // Every cell is looked at a bounded number of times, however dense the
+    // field, so drawing one costs the same whatever the spec asks for
+    unsigned int rng = seed ? seed : 1;
+    field.seed = seed;
+    int count = min(spec.minMushrooms + (int) (nextRandom(rng) % (spec.maxMushrooms - spec.minMushrooms + 1)), MAX_MUSHROOMS);
+    field.startRow = nextRandom(rng) % FIELD_START_ROWS;
+
+    // Sort the cells left open by the centipede's start and the player's into bands
+    unsigned short cells[FIELD_CELLS];
+    int bandStart[FIELD_BANDS + 1];
+    long long weight[FIELD_BANDS], totalWeight = 0;
+    int open = 0;
+    for (int band = 0; band < FIELD_BANDS; band++) {
+        bandStart[band] = open;
+        for (int row = FIELD_BAND_ROWS[band]; row < FIELD_BAND_ROWS[band + 1]; row++) {
+            if (abs(row - field.startRow) <= 1)
+                continue;
+            for (int column = 0; column < FIELD_COLUMNS; column++) {
+                if (band == FIELD_BANDS - 1 && abs(column - gameColumns / 2) <= FIELD_PLAYER_CLEARANCE)
+                    continue;
+                cells[open++] = row * FIELD_COLUMNS + column;
+            }
+        }
+        weight[band] = (long long) max(0, spec.bandWeight[band]) * (open - bandStart[band]);
+        totalWeight += weight[band];
+    }
+    bandStart[FIELD_BANDS] = open;
+    if (totalWeight == 0)
+        count = 0;
+
+    // Share the mushrooms out by weight, and what rounding leaves over one at a time from the top
+    int quota[FIELD_BANDS];
+    int shared = 0;
+    for (int band = 0; band < FIELD_BANDS; band++) {
+        quota[band] = totalWeight ? count * weight[band] / totalWeight : 0;
+        shared += quota[band];
+    }
+    for (int band = 0; shared < count; band = (band + 1) % FIELD_BANDS) {
+        if (weight[band]) {
+            quota[band]++;
+            shared++;
+        }
+    }
+
+    // Draw each band's cells without replacement (a partial Fisher-Yates
+    // shuffle). Spread fields turn down cells next to a mushroom, and a band
+    // too full for its quota hands the rest to the band below.
+    bool blocked[FIELD_CELLS] = {};
+    field.count = 0;
+    int carried = 0;
+    for (int band = 0; band < FIELD_BANDS; band++) {
+        int wanted = quota[band] + carried;
+        int first = bandStart[band], last = bandStart[band + 1];
+        while (wanted > 0 && first < last) {
+            int pick = first + nextRandom(rng) % (last - first);
+            unsigned short cell = cells[pick];
+            cells[pick] = cells[first++];
+            if (blocked[cell])
+                continue;
+            field.cells[field.count++] = cell;
+            wanted--;
+            if (!spec.spread)
+                continue;
+            int row = cell / FIELD_COLUMNS, column = cell % FIELD_COLUMNS;
+            for (int r = max(0, row - 1); r <= min(FIELD_ROWS - 1, row + 1); r++) {
+                for (int c = max(0, column - 1); c <= min(FIELD_COLUMNS - 1, column + 1); c++) {
+                    blocked[r * FIELD_COLUMNS + c] = true;
+                }
+            }
+        }
+        carried = wanted;
+    }
+    field.rngState = rng;
+}
+
+void buildFieldLibrary(FieldLibrary& library, unsigned int firstSeed, const FieldSpec& spec) {
+    library.spec = spec;
+    library.firstSeed = firstSeed;
+    library.nextSeed = firstSeed;
+    for (int i = 0; i < FIELD_LIBRARY_SIZE; i++) {
+        generateMushroomField(library.fields[i], firstSeed + i, spec);
+    }
+}
+
+const MushroomField& fieldForSeed(FieldLibrary& library, unsigned int seed) {
+    // Drawn the same either way; the library only saves the time
+    unsigned int index = seed - library.firstSeed;
+    if (index < (unsigned int) FIELD_LIBRARY_SIZE)
+        return library.fields[index];
+    generateMushroomField(library.scratch, seed, library.spec);
+    return library.scratch;
+}
+
+const MushroomField& nextLibraryField(FieldLibrary& library) {
+    return fieldForSeed(library, library.nextSeed++);
+}
+
+int checkMushroomField(const MushroomField& field, const FieldSpec& spec) {
+    // Count the mushrooms that break a rule: off the field, sharing a cell,
+    // in a kept-clear cell, or next to another in a spread field
+    bool taken[FIELD_CELLS] = {};
+    int broken = 0;
+    for (int i = 0; i < field.count; i++) {
+        int cell = field.cells[i];
+        int row = cell / FIELD_COLUMNS, column = cell % FIELD_COLUMNS;
+        if (cell >= FIELD_CELLS || taken[cell] || abs(row - field.startRow) <= 1 ||
+            (row >= FIELD_BAND_ROWS[FIELD_BANDS - 1] && abs(column - gameColumns / 2) <= FIELD_PLAYER_CLEARANCE)) {
+            broken++;
+            continue;
+        }
+        if (spec.spread) {
+            for (int r = max(0, row - 1); r <= min(FIELD_ROWS - 1, row + 1); r++) {
+                for (int c = max(0, column - 1); c <= min(FIELD_COLUMNS - 1, column + 1); c++) {
+                    broken += taken[r * FIELD_COLUMNS + c];
+                }
+            }
+        }
+        taken[cell] = true;
+    }
+    return broken;
+}
+
+// Shared world functions
+bool sharedWorldStart(SharedWorldExport& share, const string& name) {
+#ifdef SHARED_WORLD_POSIX
+    // Start from a fresh object, in case a game that crashed left one behind
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, sizeof(SharedWorldSegment)) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* mapped = mmap(nullptr, sizeof(SharedWorldSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // The object starts zeroed, so the sequence says nothing is published yet
+    // and readers turn it down until the header is filled in
+    share.segment = (SharedWorldSegment*) mapped;
+    share.segment->version = SHARED_WORLD_VERSION;
+    share.segment->size = sizeof(SharedWorldSegment);
+    share.segment->writerPid = getpid();
+    share.segment->open.store(1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    share.segment->magic = SHARED_WORLD_MAGIC;
+    share.name = name;
+    share.enabled = true;
+    cout << "Sharing the world as " << name << " (" << sizeof(SharedWorldSegment) << " bytes)" << endl;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void sharedWorldStop(SharedWorldExport& share) {
+    if (!share.enabled)
+        return;
+#ifdef SHARED_WORLD_POSIX
+    // Readers that still have it mapped see it closed; new ones cannot find it
+    share.segment->open.store(0, memory_order_release);
+    munmap(share.segment, sizeof(SharedWorldSegment));
+    shm_unlink(share.name.c_str());
+#endif
+    share.segment = nullptr;
+    share.enabled = false;
+    cout << "Shared world " << share.name << ": " << share.published << " ticks published, "
+         << (share.published ? share.publishNanos / share.published : 0) << " ns each" << endl;
+}
+
+void sharedWorldPublish(SharedWorldExport& share, const GameWorld& world) {
+    if (!share.enabled)
+        return;
+    uint64_t start = sharedWorldNanos();
+    SharedWorldState& state = sharedWorldBeginWrite(share.segment);
+    state.tick = world.tick;
+    state.score = world.player.score;
+    state.lives = world.player.lives;
+    state.level = world.level;
+    state.player = sharedEntity(world.player.position[x], world.player.position[y], SK_PLAYER,
+                                world.player.isInvulnerable ? SE_INVULNERABLE : 0, 0);
+
+    state.bulletCount = world.bullets.count;
+    for (int i = 0; i < world.bullets.count; i++) {
+        state.bullets[i] = sharedEntity(world.bullets.posX[i], world.bullets.posY[i], SK_BULLET, 0, 0);
+    }
+    int count = 0;
+    for (int i = 0; i < world.centipedeLength; i++) {
+        if (world.centipede[i][4])
+            state.segments[count++] = sharedEntity(world.centipede[i][x], world.centipede[i][y], world.centipede[i][2] ? SK_HEAD : SK_SEGMENT,
+                                                   world.centipede[i][3] ? SE_LEFT : 0, 0);
+    }
+    state.segmentCount = count;
+    count = 0;
+    for (int i = 0; i < MAX_HEADS; i++) {
+        if (world.centipedeheads[i][2])
+            state.heads[count++] = sharedEntity(world.centipedeheads[i][x], world.centipedeheads[i][y], SK_HEAD,
+                                                world.centipedeheads[i][3] ? SE_LEFT : 0, 0);
+    }
+    state.headCount = count;
+    count = 0;
+    for (int i = 0; i < world.enemies.count; i++) {
+        const Enemy& e = world.enemies.items[i];
+        if (!e.alive)
+            continue;
+        int kind = e.kind == ENEMY_FLEA ? SK_FLEA : e.kind == ENEMY_SPIDER ? SK_SPIDER : SK_SCORPION;
+        int flags = (e.right ? 0 : SE_LEFT) | (e.shot ? SE_SHOT : 0);
+        state.enemies[count++] = sharedEntity(e.posX, e.posY, kind, flags, e.shot ? e.points : 0);
+    }
+    state.enemyCount = count;
+
+    memset(state.mushrooms, 0, sizeof(state.mushrooms));
+    for (int i = 0; i < world.nmush; i++) {
+        if (!world.mush[i][3])
+            continue;
+        int column = min(max(fixedCell(world.mush[i][0] + toFixed(boxPixelsX / 2), boxPixelsX), 0), SHARED_GRID - 1);
+        int row = min(max(fixedCell(world.mush[i][1] + toFixed(boxPixelsY / 2), boxPixelsY), 0), SHARED_GRID - 1);
+        state.mushrooms[row][column] = SM_PRESENT | (min((int) world.mush[i][2], 3) & SM_HITS) | (world.mush[i][5] ? SM_POISON : 0);
+    }
+    state.publishedNanos = sharedWorldNanos();
+    sharedWorldEndWrite(share.segment);
+    share.published++;
+    share.publishNanos += sharedWorldNanos() - start;
+}
+
+SharedEntity sharedEntity(Fixed posX, Fixed posY, int kind, int flags, int value) {
+    SharedEntity entity;
+    entity.x = posX;
+    entity.y = posY;
+    entity.kind = kind;
+    entity.flags = flags;
+    entity.value = value;
+    return entity;
+}
+
+// Flow field functions
+int updateFlowField(FlowField& flow, const PlayerData& player, const Fixed mush[][6], int nmush) {
+    // Find what changed since the last update: the player's cell, and the
+    // cells that gained their first mushroom or lost their last
+    unsigned int rows[FLOW_ROWS] = {};
+    for (int i = 0; i < nmush; i++) {
+        if (!mush[i][3])
+            continue;
+        int column = min(max(fixedCell(mush[i][0] + toFixed(boxPixelsX / 2), boxPixelsX), 0), FLOW_COLUMNS - 1);
+        int row = min(max(fixedCell(mush[i][1] + toFixed(boxPixelsY / 2), boxPixelsY), 0), FLOW_ROWS - 1);
+        rows[row] |= 1u << column;
+    }
+    int column = min(max(fixedCell(player.position[x] + toFixed(boxPixelsX / 2), boxPixelsX), 0), FLOW_COLUMNS - 1);
+    int row = min(max(fixedCell(player.position[y] + toFixed(boxPixelsY / 2), boxPixelsY), 0), FLOW_ROWS - 1);
+    int target = row * FLOW_COLUMNS + column;
+
+    unsigned int grown = 0, gone = 0;
+    for (int r = 0; r < FLOW_ROWS; r++) {
+        grown |= rows[r] & ~flow.mushroomRows[r];
+        gone |= flow.mushroomRows[r] & ~rows[r];
+    }
+    if (target != flow.target || grown) {
+        memcpy(flow.mushroomRows, rows, sizeof(rows));
+        flow.target = target;
+        rebuildFlowField(flow);
+        return FLOW_REBUILT;
+    }
+    if (!gone)
+        return FLOW_UNCHANGED;
+
+    // Only paths through the emptied cells got cheaper, so lower the costs
+    // they lead to instead of starting over
+    unsigned int emptied[FLOW_ROWS];
+    for (int r = 0; r < FLOW_ROWS; r++) {
+        emptied[r] = flow.mushroomRows[r] & ~rows[r];
+        flow.mushroomRows[r] = rows[r];
+    }
+    for (int r = 0; r < FLOW_ROWS; r++) {
+        for (unsigned int bits = emptied[r]; bits; bits &= bits - 1) {
+            repairFlowField(flow, r * FLOW_COLUMNS + __builtin_ctz(bits));
+        }
+    }
+    return FLOW_REPAIRED;
+}
+
+void rebuildFlowField(FlowField& flow) {
+    unsigned short buckets[FLOW_BUCKETS][FLOW_CELLS];
+    int counts[FLOW_BUCKETS] = {};
+    for (int cell = 0; cell < FLOW_CELLS; cell++) {
+        flow.cost[cell] = USHRT_MAX;
+        flow.step[cell] = FLOW_STILL;
+    }
+    flow.cost[flow.target] = 0;
+    buckets[0][counts[0]++] = flow.target;
+    relaxFlowField(flow, buckets, counts, 0);
+}
+
+void repairFlowField(FlowField& flow, int cell) {
+    // Queue the cell again at its own cost, and its neighbours get the
+    // cheaper way through it
+    unsigned short buckets[FLOW_BUCKETS][FLOW_CELLS];
+    int counts[FLOW_BUCKETS] = {};
+    int cost = flow.cost[cell];
+    buckets[cost % FLOW_BUCKETS][counts[cost % FLOW_BUCKETS]++] = cell;
+    relaxFlowField(flow, buckets, counts, cost);
+}
+
+void relaxFlowField(FlowField& flow, unsigned short buckets[FLOW_BUCKETS][FLOW_CELLS], int counts[FLOW_BUCKETS], int cost) {
+    // Dial's algorithm: a step costs at most FLOW_MUSHROOM_COST, so the costs
+    // queued at once span fewer than FLOW_BUCKETS and the buckets are taken
+    // in turn, cheapest first. Each cell is queued once for every cost it is
+    // lowered to, and skipped in buckets it has since been lowered out of.
+    int queued = 0;
+    for (int b = 0; b < FLOW_BUCKETS; b++) {
+        queued += counts[b];
+    }
+    for (; queued > 0; cost++) {
+        int b = cost % FLOW_BUCKETS;
+        for (int i = 0; i < counts[b]; i++) {
+            int cell = buckets[b][i];
+            queued--;
+            if (flow.cost[cell] != cost)
+                continue;
+            int through = cost + flowCellCost(flow, cell);
+            int row = cell / FLOW_COLUMNS, column = cell % FLOW_COLUMNS;
+            for (int d = 0; d < FLOW_STILL; d++) {
+                // The neighbour that reaches this cell by stepping along d
+                int r = row - FLOW_DY[d], c = column - FLOW_DX[d];
+                if (r < 0 || r >= FLOW_ROWS || c < 0 || c >= FLOW_COLUMNS)
+                    continue;
+                int from = r * FLOW_COLUMNS + c;
+                if (through < flow.cost[from]) {
+                    flow.cost[from] = through;
+                    flow.step[from] = d;
+                    int to = through % FLOW_BUCKETS;
+                    buckets[to][counts[to]++] = from;
+                    queued++;
+                }
+            }
+        }
+        counts[b] = 0;
+    }
+}
+
+int flowCellCost(const FlowField& flow, int cell) {
+    // Of walking into the cell
+    return (flow.mushroomRows[cell / FLOW_COLUMNS] >> (cell % FLOW_COLUMNS) & 1) ? FLOW_MUSHROOM_COST : FLOW_STEP_COST;
+}
+
+int flowStep(const FlowField& flow, Fixed posX, Fixed posY) {
+    // The step out of the cell under the top-left corner
+    if (flow.target < 0)
+        return FLOW_STILL;
+    int column = min(max(fixedCell(posX, boxPixelsX), 0), FLOW_COLUMNS - 1);
+    int row = min(max(fixedCell(posY, boxPixelsY), 0), FLOW_ROWS - 1);
+    return flow.step[row * FLOW_COLUMNS + column];
+}
+
+bool checkFlowField(const FlowField& flow) {
+    // Debug check: the costs must match a field built from scratch, and
+    // every step must lead to a neighbour whose cost accounts for it
+    static FlowField scratch;
+    scratch = flow;
+    rebuildFlowField(scratch);
+    for (int cell = 0; cell < FLOW_CELLS; cell++) {
+        if (flow.cost[cell] != scratch.cost[cell])
+            return false;
+        if (cell == flow.target)
+            continue;
+        int d = flow.step[cell];
+        if (d >= FLOW_STILL)
+            return false;
+        int r = cell / FLOW_COLUMNS + FLOW_DY[d], c = cell % FLOW_COLUMNS + FLOW_DX[d];
+        if (r < 0 || r >= FLOW_ROWS || c < 0 || c >= FLOW_COLUMNS)
+            return false;
+        int next = r * FLOW_COLUMNS + c;
+        if (flow.cost[cell] != flow.cost[next] + flowCellCost(flow, next))
+            return false;
+    }
+    return true;
+}
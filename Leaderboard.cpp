@@ -0,0 +1,405 @@
+#include <iostream>
+#include <SFML/Network.hpp>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "Leaderboard.h"
+
+using namespace std;
+
+// Constants for the ranking
+const int SHARD_COUNT = 16; // Players are split over this many independently locked shards
+const string DEFAULT_SNAPSHOT_FILE = "leaderboard.txt";
+const int DEFAULT_SNAPSHOT_SECONDS = 10;
+
+// Structure for one shard of players: each player's best score, plus the same
+// entries ordered best first for top-N queries
+struct RankingShard {
+    mutex lock;
+    unordered_map<string, int> best;
+    set<pair<int, string>, greater<pair<int, string>>> ordered;
+};
+
+// Structure for the whole ranking. Submissions for different players only
+// contend when they hash to the same shard. Ranks come from a Fenwick tree of
+// atomic counters indexed by score, so answering "how many players beat this
+// score" never takes a lock.
+struct Ranking {
+    RankingShard shards[SHARD_COUNT];
+    unique_ptr<atomic<int>[]> tree; // Fenwick tree over scores 0..LEADERBOARD_MAX_SCORE
+    atomic<int> players{0};
+    atomic<long long> submissions{0};
+    atomic<bool> dirty{false}; // Changed since the last snapshot
+
+    Ranking() : tree(new atomic<int>[LEADERBOARD_MAX_SCORE + 2]()) {}
+};
+
+// Structure for command-line options
+struct ServerOptions {
+    unsigned short port = LEADERBOARD_DEFAULT_PORT;
+    string snapshotFile = DEFAULT_SNAPSHOT_FILE;
+    int snapshotSeconds = DEFAULT_SNAPSHOT_SECONDS;
+
+    // Load generator
+    bool load = false;
+    string address = "127.0.0.1";
+    int clients = 8;
+    int seconds = 10;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//                                                                         //
+// Function declarations                                                   //
+//                                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+// Helper functions
+void parseOptions(int argc, char* argv[], ServerOptions& options);
+string cleanName(const string& name);
+
+// Ranking functions
+void countScore(Ranking& ranking, int score, int delta);
+int playersAbove(const Ranking& ranking, int score);
+int submitScore(Ranking& ranking, const string& name, int score, int& best);
+int rankOf(Ranking& ranking, const string& name, int& best);
+vector<pair<int, string>> topScores(Ranking& ranking, int count);
+void loadSnapshot(Ranking& ranking, const string& path);
+bool saveSnapshot(Ranking& ranking, const string& path);
+void snapshotLoop(Ranking* ranking, string path, int seconds);
+
+// Server functions
+int runServer(const ServerOptions& options);
+void serveClient(Ranking* ranking, sf::TcpSocket* socket);
+
+// Load generator functions
+int runLoadGenerator(const ServerOptions& options);
+void loadClient(const ServerOptions* options, int id, vector<float>* latencies);
+
+int main(int argc, char* argv[]) {
+    ServerOptions options;
+    parseOptions(argc, argv, options);
+    if (options.load) {
+        return runLoadGenerator(options);
+    }
+    return runServer(options);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//                                                                         //
+// Function implementations                                                //
+//                                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+void parseOptions(int argc, char* argv[], ServerOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            options.port = atoi(argv[++i]);
+        }
+        else if (arg == "--snapshot" && i + 1 < argc) {
+            options.snapshotFile = argv[++i];
+        }
+        else if (arg == "--snapshot-interval" && i + 1 < argc) {
+            options.snapshotSeconds = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--load" && i + 1 < argc) {
+            // Accepts "address" or "address:port"
+            options.load = true;
+            options.address = argv[++i];
+            size_t colon = options.address.find(':');
+            if (colon != string::npos) {
+                options.port = atoi(options.address.substr(colon + 1).c_str());
+                options.address = options.address.substr(0, colon);
+            }
+        }
+        else if (arg == "--clients" && i + 1 < argc) {
+            options.clients = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--seconds" && i + 1 < argc) {
+            options.seconds = max(1, atoi(argv[++i]));
+        }
+        else {
+            cerr << "Unknown option: " << arg << endl;
+        }
+    }
+}
+
+string cleanName(const string& name) {
+    // Names are stored one word per line, like high_scores.txt
+    string clean = name.substr(0, LEADERBOARD_NAME_LENGTH);
+    for (size_t i = 0; i < clean.size(); i++) {
+        if (clean[i] <= ' ')
+            clean[i] = '_';
+    }
+    return clean.empty() ? "Player" : clean;
+}
+
+// Ranking functions
+void countScore(Ranking& ranking, int score, int delta) {
+    for (int i = score + 1; i <= LEADERBOARD_MAX_SCORE + 1; i += i & -i) {
+        ranking.tree[i].fetch_add(delta, memory_order_relaxed);
+    }
+}
+
+int playersAbove(const Ranking& ranking, int score) {
+    // Everyone minus those at or below the score. Concurrent submissions may be
+    // half counted, which only ever shifts a rank by the players in flight.
+    int atOrBelow = 0;
+    for (int i = score + 1; i > 0; i -= i & -i) {
+        atOrBelow += ranking.tree[i].load(memory_order_relaxed);
+    }
+    return max(0, ranking.players.load(memory_order_relaxed) - atOrBelow);
+}
+
+int submitScore(Ranking& ranking, const string& name, int score, int& best) {
+    score = min(max(score, 0), LEADERBOARD_MAX_SCORE);
+    RankingShard& shard = ranking.shards[hash<string>()(name) % SHARD_COUNT];
+    {
+        // Only a player's best score counts
+        lock_guard<mutex> guard(shard.lock);
+        auto found = shard.best.find(name);
+        if (found == shard.best.end()) {
+            shard.best[name] = score;
+            shard.ordered.insert(make_pair(score, name));
+            countScore(ranking, score, 1);
+            ranking.players++;
+            ranking.dirty = true;
+        } else if (score > found->second) {
+            shard.ordered.erase(make_pair(found->second, name));
+            shard.ordered.insert(make_pair(score, name));
+            countScore(ranking, found->second, -1);
+            countScore(ranking, score, 1);
+            found->second = score;
+            ranking.dirty = true;
+        }
+        best = shard.best[name];
+    }
+    ranking.submissions++;
+    return playersAbove(ranking, best) + 1;
+}
+
+int rankOf(Ranking& ranking, const string& name, int& best) {
+    RankingShard& shard = ranking.shards[hash<string>()(name) % SHARD_COUNT];
+    {
+        lock_guard<mutex> guard(shard.lock);
+        auto found = shard.best.find(name);
+        if (found == shard.best.end()) {
+            best = 0;
+            return 0;
+        }
+        best = found->second;
+    }
+    return playersAbove(ranking, best) + 1;
+}
+
+vector<pair<int, string>> topScores(Ranking& ranking, int count) {
+    // The overall top N is among the top N of every shard
+    vector<pair<int, string>> top;
+    for (int s = 0; s < SHARD_COUNT; s++) {
+        lock_guard<mutex> guard(ranking.shards[s].lock);
+        int taken = 0;
+        for (auto it = ranking.shards[s].ordered.begin(); it != ranking.shards[s].ordered.end() && taken < count; ++it, taken++) {
+            top.push_back(*it);
+        }
+    }
+    sort(top.begin(), top.end(), greater<pair<int, string>>());
+    if ((int) top.size() > count)
+        top.resize(count);
+    return top;
+}
+
+void loadSnapshot(Ranking& ranking, const string& path) {
+    ifstream file(path);
+    if (!file.is_open())
+        return;
+    string line;
+    while (getline(file, line)) {
+        stringstream ss(line);
+        string name;
+        int score;
+        if (ss >> name >> score) {
+            int best;
+            submitScore(ranking, cleanName(name), score, best);
+        }
+    }
+    ranking.submissions = 0;
+    ranking.dirty = false;
+    cout << "Loaded " << ranking.players << " players from " << path << endl;
+}
+
+bool saveSnapshot(Ranking& ranking, const string& path) {
+    // Write beside the old snapshot and swap it in, so a crash never leaves half a file.
+    // Cleared before copying so a submission during the write marks it again,
+    // and set again if the write fails so the next round retries it.
+    ranking.dirty = false;
+    string temp = path + ".tmp";
+    ofstream file(temp);
+    if (!file.is_open()) {
+        ranking.dirty = true;
+        return false;
+    }
+    for (int s = 0; s < SHARD_COUNT; s++) {
+        vector<pair<int, string>> entries;
+        {
+            lock_guard<mutex> guard(ranking.shards[s].lock);
+            entries.assign(ranking.shards[s].ordered.begin(), ranking.shards[s].ordered.end());
+        }
+        for (size_t i = 0; i < entries.size(); i++) {
+            file << entries[i].second << " " << entries[i].first << "\n";
+        }
+    }
+    file.close();
+    if (!file.good() || rename(temp.c_str(), path.c_str()) != 0) {
+        ranking.dirty = true;
+        return false;
+    }
+    return true;
+}
+
+void snapshotLoop(Ranking* ranking, string path, int seconds) {
+    while (true) {
+        sf::sleep(sf::seconds(seconds));
+        if (ranking->dirty && !saveSnapshot(*ranking, path)) {
+            cerr << "Could not write snapshot " << path << endl;
+        }
+    }
+}
+
+// Server functions
+int runServer(const ServerOptions& options) {
+    static Ranking ranking; // Outlives every client thread
+    loadSnapshot(ranking, options.snapshotFile);
+
+    sf::TcpListener listener;
+    if (listener.listen(options.port, sf::IpAddress::LocalHost) != sf::Socket::Done) {
+        cerr << "Could not listen on port " << options.port << endl;
+        return 1;
+    }
+    cout << "Leaderboard listening on 127.0.0.1:" << options.port << endl;
+    thread(snapshotLoop, &ranking, options.snapshotFile, options.snapshotSeconds).detach();
+
+    // One thread per connection: a game instance or a load generator client
+    while (true) {
+        sf::TcpSocket* socket = new sf::TcpSocket;
+        if (listener.accept(*socket) != sf::Socket::Done) {
+            delete socket;
+            continue;
+        }
+        thread(serveClient, &ranking, socket).detach();
+    }
+}
+
+void serveClient(Ranking* ranking, sf::TcpSocket* socket) {
+    sf::Packet request;
+    while (socket->receive(request) == sf::Socket::Done) {
+        sf::Uint32 magic;
+        sf::Uint8 type;
+        if (!(request >> magic >> type) || magic != LEADERBOARD_MAGIC)
+            break;
+
+        sf::Packet reply;
+        reply << LEADERBOARD_MAGIC << type;
+        if (type == LB_SUBMIT) {
+            sf::Uint32 score;
+            string name;
+            if (!(request >> score >> name))
+                break;
+            int best;
+            int rank = submitScore(*ranking, cleanName(name), score, best);
+            reply << (sf::Uint32) rank << (sf::Uint32) best;
+        }
+        else if (type == LB_TOP) {
+            sf::Uint8 count;
+            if (!(request >> count))
+                break;
+            vector<pair<int, string>> top = topScores(*ranking, min((int) count, LEADERBOARD_MAX_TOP));
+            reply << (sf::Uint8) top.size();
+            for (size_t i = 0; i < top.size(); i++) {
+                reply << top[i].second << (sf::Uint32) top[i].first;
+            }
+        }
+        else if (type == LB_RANK) {
+            string name;
+            if (!(request >> name))
+                break;
+            int best;
+            int rank = rankOf(*ranking, cleanName(name), best);
+            reply << (sf::Uint32) rank << (sf::Uint32) best;
+        }
+        else {
+            break;
+        }
+        if (socket->send(reply) != sf::Socket::Done)
+            break;
+    }
+    socket->disconnect();
+    delete socket;
+}
+
+// Load generator functions
+int runLoadGenerator(const ServerOptions& options) {
+    cout << "Submitting from " << options.clients << " clients for " << options.seconds << " s to "
+         << options.address << ":" << options.port << endl;
+
+    // Every client records the round trip of each submission it made
+    vector<vector<float>> latencies(options.clients);
+    vector<thread> clients;
+    sf::Clock clock;
+    for (int i = 0; i < options.clients; i++) {
+        clients.push_back(thread(loadClient, &options, i, &latencies[i]));
+    }
+    for (size_t i = 0; i < clients.size(); i++) {
+        clients[i].join();
+    }
+    float elapsed = clock.getElapsedTime().asSeconds();
+
+    vector<float> all;
+    for (size_t i = 0; i < latencies.size(); i++) {
+        all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+    }
+    if (all.empty()) {
+        cerr << "No submissions succeeded" << endl;
+        return 1;
+    }
+    sort(all.begin(), all.end());
+    printf("%zu submissions in %.1f s: %.0f submissions/s\n", all.size(), elapsed, all.size() / elapsed);
+    printf("latency us: p50 %.0f  p99 %.0f  max %.0f\n", all[all.size() / 2], all[all.size() * 99 / 100], all.back());
+    return 0;
+}
+
+void loadClient(const ServerOptions* options, int id, vector<float>* latencies) {
+    sf::TcpSocket socket;
+    if (socket.connect(options->address, options->port, sf::seconds(2)) != sf::Socket::Done) {
+        cerr << "Client " << id << " could not connect" << endl;
+        return;
+    }
+
+    // A thousand players per client, each improving now and then
+    unsigned int rng = 2463534242u ^ (id * 2654435761u);
+    sf::Clock clock;
+    sf::Clock roundTrip;
+    while (clock.getElapsedTime().asSeconds() < options->seconds) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        string name = "load" + to_string(id) + "_" + to_string(rng % 1000);
+
+        sf::Packet request;
+        request << LEADERBOARD_MAGIC << (sf::Uint8) LB_SUBMIT << (sf::Uint32) (rng % (LEADERBOARD_MAX_SCORE + 1)) << name;
+        roundTrip.restart();
+        sf::Packet reply;
+        if (socket.send(request) != sf::Socket::Done || socket.receive(reply) != sf::Socket::Done)
+            break;
+        latencies->push_back(roundTrip.getElapsedTime().asMicroseconds());
+    }
+}
@@ -0,0 +1,22 @@
+// Wire protocol shared by the game and the leaderboard daemon (Leaderboard.cpp).
+// Every message is one sf::Packet over TCP: the magic number, the message type,
+// then the fields listed next to the type. Replies start the same way.
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <SFML/Config.hpp>
+
+const unsigned short LEADERBOARD_DEFAULT_PORT = 47810;
+const sf::Uint32 LEADERBOARD_MAGIC = 0x4c445244; // "LDRD"
+const int LEADERBOARD_MAX_SCORE = 999999; // Same cap as the game
+const int LEADERBOARD_MAX_TOP = 100; // Most entries one top-N query returns
+const int LEADERBOARD_NAME_LENGTH = 15;
+
+// Leaderboard message types
+enum LeaderboardMessage {
+    LB_SUBMIT, // Uint32 score, string name  -> Uint32 rank, Uint32 best score
+    LB_TOP,    // Uint8 count                -> Uint8 count, then string name, Uint32 score each
+    LB_RANK    // string name                -> Uint32 rank, Uint32 best score (rank 0 if unknown)
+};
+
+#endif
@@ -0,0 +1,202 @@
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "SharedWorld.h"
+
+using namespace std;
+
+// Constants for the client
+const int REPORT_MILLIS = 1000;
+const int RETRY_MILLIS = 1000; // Between looks for a game that is not running yet
+const int POLL_MICROS = 100; // Sleep between polls unless spinning
+
+// Structure for command-line options
+struct WatchOptions {
+    string name = SHARED_WORLD_DEFAULT_NAME;
+    bool map = false; // Draw the field with every report
+    bool spin = false; // Poll without sleeping, for the lowest latency
+    float seconds = 0.0f; // Stop after this long, 0 to watch until the game exits
+};
+
+// Structure for what has been seen since the last report
+struct WatchStats {
+    long long reads = 0;
+    long long missedTicks = 0; // Published while we were not looking
+    long long readNanos = 0;
+    long long latencyNanos = 0;
+    long long maxLatencyNanos = 0;
+    long long retries = 0;
+    uint32_t lastTick = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//                                                                         //
+// Function declarations                                                   //
+//                                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+// Helper functions
+void parseOptions(int argc, char* argv[], WatchOptions& options);
+bool waitForGame(SharedWorldReader& reader, const WatchOptions& options, uint64_t deadline);
+
+// Report functions
+void printReport(const SharedWorldState& state, WatchStats& stats, const SharedWorldReader& reader);
+void printMap(const SharedWorldState& state);
+void plotEntity(char map[SHARED_GRID][SHARED_GRID + 1], const SharedEntity& entity, char symbol);
+
+int main(int argc, char* argv[]) {
+    WatchOptions options;
+    parseOptions(argc, argv, options);
+    uint64_t deadline = options.seconds > 0 ? sharedWorldNanos() + (uint64_t) (options.seconds * 1e9) : UINT64_MAX;
+
+    SharedWorldReader reader;
+    if (!waitForGame(reader, options, deadline))
+        return 1;
+
+    SharedWorldState state;
+    WatchStats stats;
+    uint64_t nextReport = sharedWorldNanos() + REPORT_MILLIS * 1000000ull;
+    bool haveState = false;
+    while (sharedWorldAlive(reader) && sharedWorldNanos() < deadline) {
+        if (!sharedWorldChanged(reader)) {
+            if (!options.spin)
+                this_thread::sleep_for(chrono::microseconds(POLL_MICROS));
+        }
+        else {
+            uint64_t start = sharedWorldNanos();
+            if (sharedWorldRead(reader, state)) {
+                uint64_t now = sharedWorldNanos();
+                long long latency = now - state.publishedNanos;
+                stats.reads++;
+                stats.readNanos += now - start;
+                stats.latencyNanos += latency;
+                stats.maxLatencyNanos = max(stats.maxLatencyNanos, latency);
+                if (haveState && state.tick > stats.lastTick + 1)
+                    stats.missedTicks += state.tick - stats.lastTick - 1;
+                stats.lastTick = state.tick;
+                haveState = true;
+            }
+        }
+
+        if (sharedWorldNanos() >= nextReport) {
+            nextReport += REPORT_MILLIS * 1000000ull;
+            if (haveState) {
+                printReport(state, stats, reader);
+                if (options.map)
+                    printMap(state);
+            }
+            else {
+                cout << "Waiting for the first tick" << endl;
+            }
+        }
+    }
+    cout << (sharedWorldAlive(reader) ? "Done watching " : "The game closed ") << options.name << endl;
+    sharedWorldClose(reader);
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//                                                                         //
+// Function implementations                                                //
+//                                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+// Helper functions
+void parseOptions(int argc, char* argv[], WatchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--name" && i + 1 < argc) {
+            options.name = argv[++i];
+        }
+        else if (arg == "--map") {
+            options.map = true;
+        }
+        else if (arg == "--spin") {
+            options.spin = true;
+        }
+        else if (arg == "--seconds" && i + 1 < argc) {
+            options.seconds = max(0.0f, (float) atof(argv[++i]));
+        }
+        else {
+            cerr << "Unknown option: " << arg << endl;
+        }
+    }
+}
+
+bool waitForGame(SharedWorldReader& reader, const WatchOptions& options, uint64_t deadline) {
+    // The game may not be running yet, or may be an older build
+    bool told = false;
+    while (!sharedWorldOpen(reader, options.name.c_str())) {
+        if (!told) {
+            cout << "Waiting for a game sharing " << options.name << " (./sfml-app --share-world)" << endl;
+            told = true;
+        }
+        if (sharedWorldNanos() >= deadline)
+            return false;
+        this_thread::sleep_for(chrono::milliseconds(RETRY_MILLIS));
+    }
+    cout << "Watching " << options.name << " from game process " << reader.segment->writerPid << endl;
+    return true;
+}
+
+// Report functions
+void printReport(const SharedWorldState& state, WatchStats& stats, const SharedWorldReader& reader) {
+    char line[256];
+    snprintf(line, sizeof(line), "tick %u  score %d  lives %d  level %d  player (%.1f, %.1f)  %d segments %d heads %d enemies %d bullets",
+             state.tick, state.score, state.lives, state.level, (float) state.player.x / SHARED_FIXED_ONE,
+             (float) state.player.y / SHARED_FIXED_ONE, state.segmentCount, state.headCount, state.enemyCount, state.bulletCount);
+    cout << line << endl;
+    if (stats.reads > 0) {
+        snprintf(line, sizeof(line), "  %lld reads, %.0f ns each, latency %.1f us (max %.1f us), %lld ticks missed, %lld retries",
+                 stats.reads, (double) stats.readNanos / stats.reads, stats.latencyNanos / 1000.0 / stats.reads,
+                 stats.maxLatencyNanos / 1000.0, stats.missedTicks, reader.retries - stats.retries);
+        cout << line << endl;
+    }
+    uint32_t lastTick = stats.lastTick;
+    long long retries = reader.retries;
+    stats = WatchStats();
+    stats.lastTick = lastTick;
+    stats.retries = retries;
+}
+
+void printMap(const SharedWorldState& state) {
+    // One character per cell: mushrooms under everything that moves
+    char map[SHARED_GRID][SHARED_GRID + 1];
+    for (int row = 0; row < SHARED_GRID; row++) {
+        for (int column = 0; column < SHARED_GRID; column++) {
+            uint8_t cell = state.mushrooms[row][column];
+            map[row][column] = !(cell & SM_PRESENT) ? '.' : (cell & SM_POISON) ? 'm' : 'M';
+        }
+        map[row][SHARED_GRID] = '\0';
+    }
+    for (int i = 0; i < state.segmentCount; i++) {
+        plotEntity(map, state.segments[i], state.segments[i].kind == SK_HEAD ? '@' : 'o');
+    }
+    for (int i = 0; i < state.headCount; i++) {
+        plotEntity(map, state.heads[i], '@');
+    }
+    for (int i = 0; i < state.enemyCount; i++) {
+        const SharedEntity& e = state.enemies[i];
+        plotEntity(map, e, e.kind == SK_FLEA ? 'F' : e.kind == SK_SPIDER ? 'S' : 'X');
+    }
+    for (int i = 0; i < state.bulletCount; i++) {
+        plotEntity(map, state.bullets[i], '|');
+    }
+    if (state.lives > 0)
+        plotEntity(map, state.player, 'A');
+    for (int row = 0; row < SHARED_GRID; row++) {
+        cout << "  " << map[row] << endl;
+    }
+}
+
+void plotEntity(char map[SHARED_GRID][SHARED_GRID + 1], const SharedEntity& entity, char symbol) {
+    // Into the cell under the entity's middle
+    int column = (entity.x / SHARED_FIXED_ONE + SHARED_CELL_PIXELS / 2) / SHARED_CELL_PIXELS;
+    int row = (entity.y / SHARED_FIXED_ONE + SHARED_CELL_PIXELS / 2) / SHARED_CELL_PIXELS;
+    if (column >= 0 && column < SHARED_GRID && row >= 0 && row < SHARED_GRID)
+        map[row][column] = symbol;
+}
@@ -0,0 +1,194 @@
+// Shared-memory world layout written by the game (--share-world) and read by
+// external tools through the functions at the bottom (see SharedWorld.cpp).
+// The game maps a POSIX shared-memory object holding one SharedWorldSegment
+// and rewrites its state after every tick. Readers map the same object and
+// copy the state out under a seqlock: the sequence is odd while the game is
+// writing, and a copy is good if the sequence was even and unchanged around
+// it. The game never waits for a reader and readers never take a lock.
+// Positions are 16.16 fixed point pixels, the top-left corner of the sprite.
+#ifndef SHARED_WORLD_H
+#define SHARED_WORLD_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define SHARED_WORLD_POSIX
+#endif
+
+const char* const SHARED_WORLD_DEFAULT_NAME = "/centipede-world";
+const uint32_t SHARED_WORLD_MAGIC = 0x444c5257; // "WRLD"
+const uint32_t SHARED_WORLD_VERSION = 1;
+const int SHARED_WORLD_READ_ATTEMPTS = 1000; // Copies a read tries before giving up on a stalled writer
+
+// Capacities, the same as the game's pools
+const int SHARED_BULLETS = 256;
+const int SHARED_SEGMENTS = 12;
+const int SHARED_HEADS = 12;
+const int SHARED_ENEMIES = 256;
+const int SHARED_GRID = 30; // Cells per side of the playing field
+const int SHARED_CELL_PIXELS = 32;
+const int SHARED_FIXED_ONE = 1 << 16; // One pixel
+
+// What an entity is
+enum SharedKind {
+    SK_PLAYER,
+    SK_BULLET,
+    SK_SEGMENT,
+    SK_HEAD,
+    SK_FLEA,
+    SK_SPIDER,
+    SK_SCORPION
+};
+
+// Entity flags
+enum SharedEntityFlag {
+    SE_LEFT = 1 << 0,         // Segments, heads and scorpions heading left
+    SE_SHOT = 1 << 1,         // A spider showing its points before it goes
+    SE_INVULNERABLE = 1 << 2  // The player, just after losing a life
+};
+
+// A mushroom grid cell: 0 for none, else SM_PRESENT with the hits it has taken
+enum SharedMushroom {
+    SM_HITS = 3,         // Mask of the hits taken, 0-2
+    SM_POISON = 1 << 2,  // Poisoned by a scorpion
+    SM_PRESENT = 1 << 7
+};
+
+// Structure for one entity, 12 bytes
+struct SharedEntity {
+    int32_t x;
+    int32_t y;
+    uint8_t kind; // SharedKind
+    uint8_t flags; // SharedEntityFlag bits
+    uint16_t value; // A shot spider's points, else 0
+};
+
+// Structure for everything a tick publishes. Each list holds its count of
+// entities packed at the front; the rest is left over from earlier ticks.
+struct SharedWorldState {
+    uint64_t publishedNanos; // Steady clock (CLOCK_MONOTONIC on Linux) when the tick was published
+    uint32_t tick;
+    int32_t score;
+    int32_t lives; // 0 once the game is over
+    int32_t level;
+    SharedEntity player;
+    uint16_t bulletCount;
+    uint16_t segmentCount;
+    uint16_t headCount;
+    uint16_t enemyCount; // Fleas, spiders and scorpions
+    SharedEntity bullets[SHARED_BULLETS];
+    SharedEntity segments[SHARED_SEGMENTS]; // The centipede's body, its own head included
+    SharedEntity heads[SHARED_HEADS]; // Heads that broke off the body
+    SharedEntity enemies[SHARED_ENEMIES];
+    uint8_t mushrooms[SHARED_GRID][SHARED_GRID]; // [row][column], SharedMushroom bits, by the cell under a mushroom's middle
+};
+
+// Structure for the whole shared object
+struct SharedWorldSegment {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size; // sizeof(SharedWorldSegment), so a reader can check its layout matches
+    uint32_t writerPid;
+    std::atomic<uint32_t> sequence; // Odd while a tick is being written, 0 before the first
+    std::atomic<uint32_t> open; // Cleared when the game lets go of the object
+    SharedWorldState state;
+};
+
+static_assert(sizeof(SharedEntity) == 12, "SharedEntity is part of the published layout");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "The sequence must be lock-free to work across processes");
+
+inline uint64_t sharedWorldNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Writer side: fill the state returned by the first call, then make it visible with the second
+inline SharedWorldState& sharedWorldBeginWrite(SharedWorldSegment* segment) {
+    segment->sequence.store(segment->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return segment->state;
+}
+
+inline void sharedWorldEndWrite(SharedWorldSegment* segment) {
+    segment->sequence.store(segment->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Structure for a reader's mapping of the object
+struct SharedWorldReader {
+    const SharedWorldSegment* segment = nullptr;
+    uint32_t lastSequence = 0; // Of the last good read
+    long long retries = 0; // Copies thrown away because the game wrote during them
+};
+
+inline bool sharedWorldOpen(SharedWorldReader& reader, const char* name) {
+#ifdef SHARED_WORLD_POSIX
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    void* mapped = mmap(nullptr, sizeof(SharedWorldSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+    const SharedWorldSegment* segment = (const SharedWorldSegment*) mapped;
+    if (segment->magic != SHARED_WORLD_MAGIC || segment->version != SHARED_WORLD_VERSION || segment->size != sizeof(SharedWorldSegment)) {
+        munmap(mapped, sizeof(SharedWorldSegment));
+        return false;
+    }
+    reader.segment = segment;
+    reader.lastSequence = 0;
+    return true;
+#else
+    (void) reader;
+    (void) name;
+    return false;
+#endif
+}
+
+inline void sharedWorldClose(SharedWorldReader& reader) {
+#ifdef SHARED_WORLD_POSIX
+    if (reader.segment)
+        munmap((void*) reader.segment, sizeof(SharedWorldSegment));
+#endif
+    reader.segment = nullptr;
+}
+
+// True while the game still has the object; a closed one will never change again
+inline bool sharedWorldAlive(const SharedWorldReader& reader) {
+    return reader.segment && reader.segment->open.load(std::memory_order_relaxed);
+}
+
+// True once a tick newer than the last good read has been published; cheap enough to spin on
+inline bool sharedWorldChanged(const SharedWorldReader& reader) {
+    uint32_t sequence = reader.segment->sequence.load(std::memory_order_relaxed);
+    return sequence != reader.lastSequence && !(sequence & 1);
+}
+
+// Copy the latest tick out. False if none was published yet, or the writer
+// stayed in the middle of a tick for every attempt.
+inline bool sharedWorldRead(SharedWorldReader& reader, SharedWorldState& state) {
+    const SharedWorldSegment* segment = reader.segment;
+    for (int attempt = 0; attempt < SHARED_WORLD_READ_ATTEMPTS; attempt++) {
+        uint32_t before = segment->sequence.load(std::memory_order_acquire);
+        if (before == 0)
+            return false;
+        if (before & 1) {
+            reader.retries++;
+            continue;
+        }
+        memcpy(&state, (const void*) &segment->state, sizeof(SharedWorldState));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (segment->sequence.load(std::memory_order_relaxed) == before) {
+            reader.lastSequence = before;
+            return true;
+        }
+        reader.retries++;
+    }
+    return false;
+}
+
+#endif
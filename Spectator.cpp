@@ -0,0 +1,369 @@
+#include <iostream>
+#include <SFML/Graphics.hpp>
+#include <SFML/Network.hpp>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Spectator.h"
+
+using namespace std;
+
+// Constants for the display
+const int WINDOW_SIZE = 640;
+const int FIELD_SIZE = 960; // The game's playing field, in pixels
+const int CELL = 32;
+const float RECONNECT_SECONDS = 2.0f;
+const string FONT_PATH = "/usr/share/fonts/truetype/freefont/FreeMonoBold.ttf";
+
+// Structure for command-line options
+struct SpectatorOptions {
+    string address = "127.0.0.1";
+    unsigned short port = SPECTATOR_DEFAULT_PORT;
+};
+
+// Structure for the connection to a game and the view rebuilt from its stream
+struct SpectatorClient {
+    sf::TcpSocket socket;
+    bool connected = false;
+    bool helloSeen = false;
+    bool synced = false; // A keyframe has arrived since connecting
+    vector<unsigned char> pending; // Received bytes not yet a whole message
+    SpectatorView view;
+    sf::Clock reconnectClock;
+
+    // Statistics
+    long long bytes = 0;
+    long long messages = 0;
+    long long bytesThisSecond = 0;
+    float bytesPerSecond = 0.0f;
+    sf::Clock rateClock;
+};
+
+// Structure for the sprites, loaded from the game's textures
+struct SpectatorSprites {
+    sf::Texture player, mushroom, bullet, centipede, chead, flea, spider, scorpion, background;
+    sf::Sprite sprite;
+    sf::Sprite backgroundSprite;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+//                                                                         //
+// Function declarations                                                   //
+//                                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+// Helper functions
+void parseOptions(int argc, char* argv[], SpectatorOptions& options);
+void loadSprites(SpectatorSprites& sprites);
+
+// Stream functions
+bool connectToGame(SpectatorClient& client, const SpectatorOptions& options);
+bool receiveStream(SpectatorClient& client);
+bool applyMessage(SpectatorClient& client, const unsigned char* data, size_t size);
+bool applySlotUpdates(SpectatorView& view, const unsigned char*& in, const unsigned char* end);
+
+// Drawing functions
+void drawView(sf::RenderWindow& window, SpectatorSprites& sprites, const SpectatorView& view);
+void drawSlot(sf::RenderWindow& window, SpectatorSprites& sprites, const SpectatorSlot& slot);
+void drawStatus(sf::RenderWindow& window, sf::Font& font, const SpectatorClient& client, const SpectatorOptions& options);
+
+int main(int argc, char* argv[]) {
+    SpectatorOptions options;
+    parseOptions(argc, argv, options);
+
+    sf::RenderWindow window(sf::VideoMode(WINDOW_SIZE, WINDOW_SIZE), "Centipede Spectator", sf::Style::Close | sf::Style::Titlebar | sf::Style::Resize);
+    window.setFramerateLimit(60);
+    window.setView(sf::View(sf::FloatRect(0, 0, FIELD_SIZE, FIELD_SIZE)));
+    SpectatorSprites sprites;
+    loadSprites(sprites);
+    sf::Font font;
+    font.loadFromFile(FONT_PATH);
+
+    SpectatorClient client;
+    connectToGame(client, options);
+    while (window.isOpen()) {
+        sf::Event e;
+        while (window.pollEvent(e)) {
+            if (e.type == sf::Event::Closed || (e.type == sf::Event::KeyPressed && e.key.code == sf::Keyboard::Escape))
+                window.close();
+        }
+
+        // Keep trying while the game is away, so a hall display recovers by itself
+        if (!client.connected && client.reconnectClock.getElapsedTime().asSeconds() > RECONNECT_SECONDS) {
+            connectToGame(client, options);
+        }
+        if (client.connected && !receiveStream(client)) {
+            cerr << "Lost the game at " << options.address << ":" << options.port << endl;
+            client.socket.disconnect();
+            client.connected = false;
+            client.reconnectClock.restart();
+        }
+
+        window.clear(sf::Color(0, 0, 0));
+        if (client.synced) {
+            drawView(window, sprites, client.view);
+        }
+        drawStatus(window, font, client, options);
+        window.display();
+    }
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//                                                                         //
+// Function implementations                                                //
+//                                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+// Helper functions
+void parseOptions(int argc, char* argv[], SpectatorOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg[0] != '-') {
+            // Accepts "address" or "address:port"
+            options.address = arg;
+            size_t colon = options.address.find(':');
+            if (colon != string::npos) {
+                options.port = atoi(options.address.substr(colon + 1).c_str());
+                options.address = options.address.substr(0, colon);
+            }
+        }
+        else {
+            cerr << "Unknown option: " << arg << endl;
+        }
+    }
+}
+
+void loadSprites(SpectatorSprites& sprites) {
+    // The same files the game draws with
+    sprites.player.loadFromFile("Textures/player.png");
+    sprites.mushroom.loadFromFile("Textures/mushroom.png");
+    sprites.bullet.loadFromFile("Textures/bullet.png");
+    sprites.centipede.loadFromFile("Textures/c_body_left_walk.png");
+    sprites.chead.loadFromFile("Textures/c_head_left_walk.png");
+    sprites.flea.loadFromFile("Textures/flea.png");
+    sprites.spider.loadFromFile("Textures/spider_and_score.png");
+    sprites.scorpion.loadFromFile("Textures/scorpion.png");
+    sprites.background.loadFromFile("Textures/orange_forest.png");
+    sprites.backgroundSprite.setTexture(sprites.background);
+    sprites.backgroundSprite.setColor(sf::Color(255, 255, 255, 255 * 0.20));
+}
+
+// Stream functions
+bool connectToGame(SpectatorClient& client, const SpectatorOptions& options) {
+    client.reconnectClock.restart();
+    client.socket.setBlocking(true);
+    if (client.socket.connect(options.address, options.port, sf::seconds(1)) != sf::Socket::Done)
+        return false;
+    client.socket.setBlocking(false);
+    client.connected = true;
+    client.helloSeen = false;
+    client.synced = false;
+    client.pending.clear();
+    cout << "Spectating " << options.address << ":" << options.port << endl;
+    return true;
+}
+
+bool receiveStream(SpectatorClient& client) {
+    // Take whatever has arrived and apply every whole message in it
+    char buffer[16384];
+    while (true) {
+        size_t received = 0;
+        sf::Socket::Status status = client.socket.receive(buffer, sizeof(buffer), received);
+        if (status == sf::Socket::Disconnected || status == sf::Socket::Error)
+            return false;
+        if (received == 0)
+            break;
+        client.pending.insert(client.pending.end(), buffer, buffer + received);
+        client.bytes += received;
+        client.bytesThisSecond += received;
+    }
+    if (client.rateClock.getElapsedTime().asSeconds() >= 1.0f) {
+        client.bytesPerSecond = client.bytesThisSecond / client.rateClock.restart().asSeconds();
+        client.bytesThisSecond = 0;
+    }
+
+    size_t at = 0;
+    while (client.pending.size() - at >= 2) {
+        size_t length = client.pending[at] | client.pending[at + 1] << 8;
+        if (client.pending.size() - at - 2 < length)
+            break;
+        if (!applyMessage(client, &client.pending[at + 2], length))
+            return false;
+        at += 2 + length;
+    }
+    client.pending.erase(client.pending.begin(), client.pending.begin() + at);
+    return true;
+}
+
+bool applyMessage(SpectatorClient& client, const unsigned char* data, size_t size) {
+    // False if the stream is not one we understand
+    if (size < 1)
+        return false;
+    const unsigned char* in = data + 1;
+    const unsigned char* end = data + size;
+    client.messages++;
+    SpectatorView& view = client.view;
+
+    if (data[0] == SM_HELLO) {
+        if (size < 9 || spectatorGet32(in) != SPECTATOR_MAGIC || spectatorGet32(in) != SPECTATOR_VERSION) {
+            cerr << "Not a spectator stream this client understands" << endl;
+            return false;
+        }
+        client.helloSeen = true;
+        return true;
+    }
+    if (!client.helloSeen)
+        return false;
+
+    if (data[0] == SM_KEYFRAME) {
+        if (end - in < 13)
+            return false;
+        view.tick = spectatorGet32(in);
+        view.score = spectatorGet32(in);
+        view.lives = *in++;
+        view.level = spectatorGet16(in);
+        for (SpectatorSlot& slot : view.slots) {
+            slot = {0, 0, SS_NONE};
+        }
+        client.synced = true;
+        return applySlotUpdates(view, in, end);
+    }
+
+    if (data[0] == SM_DELTA) {
+        if (end - in < 5)
+            return false;
+        view.tick = spectatorGet32(in);
+        int fields = *in++;
+        if (end - in < ((fields & SF_SCORE) ? 4 : 0) + ((fields & SF_LIVES) ? 1 : 0) + ((fields & SF_LEVEL) ? 2 : 0))
+            return false;
+        if (fields & SF_SCORE)
+            view.score = spectatorGet32(in);
+        if (fields & SF_LIVES)
+            view.lives = *in++;
+        if (fields & SF_LEVEL)
+            view.level = spectatorGet16(in);
+        return applySlotUpdates(view, in, end);
+    }
+
+    // Newer message types are skipped
+    return true;
+}
+
+bool applySlotUpdates(SpectatorView& view, const unsigned char*& in, const unsigned char* end) {
+    if (end - in < 2)
+        return false;
+    int count = spectatorGet16(in);
+    for (int i = 0; i < count; i++) {
+        if (end - in < 2)
+            return false;
+        int update = spectatorGet16(in);
+        int slot = update & 0x3fff;
+        int op = update >> 14;
+        if (slot >= SPECTATOR_SLOTS)
+            return false;
+        SpectatorSlot& s = view.slots[slot];
+        int needs = op == SO_MOVE ? 2 : op == SO_SET ? 5 : op == SO_LOOK ? 1 : 0;
+        if (end - in < needs)
+            return false;
+        if (op == SO_MOVE) {
+            s.x += (int8_t) in[0];
+            s.y += (int8_t) in[1];
+            in += 2;
+        } else if (op == SO_SET) {
+            s.look = *in++;
+            s.x = (int16_t) spectatorGet16(in);
+            s.y = (int16_t) spectatorGet16(in);
+        } else if (op == SO_LOOK) {
+            s.look = *in++;
+        } else {
+            s.look = SS_NONE;
+        }
+    }
+    return true;
+}
+
+// Drawing functions
+void drawView(sf::RenderWindow& window, SpectatorSprites& sprites, const SpectatorView& view) {
+    window.draw(sprites.backgroundSprite);
+    // Same order as the game: centipede, enemies and mushrooms, then bullets, then the player
+    for (int i = SPECTATOR_FIRST_SEGMENT; i < SPECTATOR_SLOTS; i++) {
+        drawSlot(window, sprites, view.slots[i]);
+    }
+    for (int i = SPECTATOR_FIRST_BULLET; i < SPECTATOR_FIRST_SEGMENT; i++) {
+        drawSlot(window, sprites, view.slots[i]);
+    }
+    drawSlot(window, sprites, view.slots[0]);
+}
+
+void drawSlot(sf::RenderWindow& window, SpectatorSprites& sprites, const SpectatorSlot& slot) {
+    // Texture rectangles match the game's draw functions
+    int sprite = slot.look & 15;
+    int frame = slot.look >> 4;
+    sf::Sprite& s = sprites.sprite;
+    switch (sprite) {
+        case SS_PLAYER:
+            s.setTexture(sprites.player);
+            s.setTextureRect(sf::IntRect(frame * CELL, 0, CELL, CELL));
+            break;
+        case SS_BULLET:
+            s.setTexture(sprites.bullet, true);
+            break;
+        case SS_SEGMENT:
+            s.setTexture(sprites.centipede);
+            s.setTextureRect(sf::IntRect(0, 0, CELL, CELL));
+            break;
+        case SS_HEAD:
+            s.setTexture(sprites.chead);
+            s.setTextureRect(sf::IntRect(0, 0, CELL, CELL));
+            break;
+        case SS_FLEA:
+            s.setTexture(sprites.flea);
+            s.setTextureRect(sf::IntRect(0, 0, CELL, CELL));
+            break;
+        case SS_SPIDER: {
+            // Walking, or the points a shot spider was worth
+            static const sf::IntRect rects[4] = {
+                sf::IntRect(7.5 * CELL, 0, 1.9 * CELL, CELL), sf::IntRect(0, 0, 1.9 * CELL, 2 * CELL),
+                sf::IntRect(1.9 * CELL, 0, 1.9 * CELL, 2 * CELL), sf::IntRect(3.9 * CELL, 0, 1.9 * CELL, 2 * CELL)};
+            s.setTexture(sprites.spider);
+            s.setTextureRect(rects[frame & 3]);
+            break;
+        }
+        case SS_SCORPION:
+            s.setTexture(sprites.scorpion);
+            s.setTextureRect(sf::IntRect(0, 0, 2 * CELL, CELL));
+            break;
+        case SS_MUSHROOM:
+            s.setTexture(sprites.mushroom);
+            s.setTextureRect(sf::IntRect((frame & 3) ? 3 * CELL : 0, (frame & 4) ? CELL : 0, CELL, CELL));
+            break;
+        default:
+            return;
+    }
+    s.setPosition(slot.x, slot.y);
+    window.draw(s);
+}
+
+void drawStatus(sf::RenderWindow& window, sf::Font& font, const SpectatorClient& client, const SpectatorOptions& options) {
+    char line[160];
+    if (!client.connected) {
+        snprintf(line, sizeof(line), "Waiting for %s:%d ...", options.address.c_str(), options.port);
+    } else if (!client.synced) {
+        snprintf(line, sizeof(line), "Connected, waiting for a keyframe");
+    } else {
+        snprintf(line, sizeof(line), "Score: %u\nLives: %d\nLevel: %d", client.view.score, client.view.lives, client.view.level);
+    }
+    sf::Text text(line, font, 24);
+    text.setFillColor(sf::Color::White);
+    text.setPosition(10, 9);
+    window.draw(text);
+
+    snprintf(line, sizeof(line), "%.1f KB/s", client.bytesPerSecond / 1024);
+    sf::Text rate(line, font, 18);
+    rate.setFillColor(sf::Color(160, 160, 160));
+    rate.setPosition(FIELD_SIZE - rate.getGlobalBounds().width - 10, FIELD_SIZE - 30);
+    window.draw(rate);
+}
@@ -0,0 +1,119 @@
+// Stream format shared by the game's spectator publisher and the spectator client (Spectator.cpp).
+// The stream is a run of messages: a uint16 length (of the type and body), a
+// uint8 type, then the body. It starts with a hello; after that a keyframe
+// carries the whole view and a delta only what changed since the message
+// before it. Values are little-endian.
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+const unsigned short SPECTATOR_DEFAULT_PORT = 47820;
+const uint32_t SPECTATOR_MAGIC = 0x43455053; // "SPEC"
+const uint32_t SPECTATOR_VERSION = 1;
+
+// The view is a fixed table of slots, one per entity the game can hold, in
+// this order. The game's own capacities must match.
+const int SPECTATOR_BULLETS = 256;
+const int SPECTATOR_SEGMENTS = 12;
+const int SPECTATOR_HEADS = 12;
+const int SPECTATOR_ENEMIES = 256;
+const int SPECTATOR_MUSHROOMS = 200;
+const int SPECTATOR_FIRST_BULLET = 1; // Slot 0 is the player
+const int SPECTATOR_FIRST_SEGMENT = SPECTATOR_FIRST_BULLET + SPECTATOR_BULLETS;
+const int SPECTATOR_FIRST_HEAD = SPECTATOR_FIRST_SEGMENT + SPECTATOR_SEGMENTS;
+const int SPECTATOR_FIRST_ENEMY = SPECTATOR_FIRST_HEAD + SPECTATOR_HEADS;
+const int SPECTATOR_FIRST_MUSHROOM = SPECTATOR_FIRST_ENEMY + SPECTATOR_ENEMIES;
+const int SPECTATOR_SLOTS = SPECTATOR_FIRST_MUSHROOM + SPECTATOR_MUSHROOMS;
+
+// Largest message with its length: a keyframe, or a delta that sets every slot
+const int SPECTATOR_MAX_MESSAGE = 32 + 7 * SPECTATOR_SLOTS;
+
+// Message types
+enum SpectatorMessage {
+    SM_HELLO,    // uint32 magic, uint32 version
+    SM_KEYFRAME, // uint32 tick, uint32 score, uint8 lives, uint16 level, uint16 count, then count slot updates
+    SM_DELTA     // uint32 tick, uint8 SpectatorField bits and those fields in order, uint16 count, then count slot updates
+};
+
+// Fields a delta carries when they changed
+enum SpectatorField {
+    SF_SCORE = 1 << 0, // uint32
+    SF_LIVES = 1 << 1, // uint8
+    SF_LEVEL = 1 << 2  // uint16
+};
+
+// A slot update is a uint16: the slot in the low 14 bits, the operation in the
+// top 2, followed by the operation's fields
+enum SpectatorOp {
+    SO_MOVE,   // int8 dx, int8 dy
+    SO_SET,    // uint8 look, int16 x, int16 y
+    SO_REMOVE, // nothing
+    SO_LOOK    // uint8 look
+};
+
+// What a slot shows: the sprite in the low 4 bits of its look, a frame above
+enum SpectatorSprite {
+    SS_NONE,
+    SS_PLAYER,   // Frame is the animation frame
+    SS_BULLET,
+    SS_SEGMENT,
+    SS_HEAD,
+    SS_FLEA,
+    SS_SPIDER,   // Frame 0 walking, 1-3 shot for 300, 600 or 900 points
+    SS_SCORPION,
+    SS_MUSHROOM  // Frame bits 0-1 hits taken, bit 2 poisonous
+};
+
+// Structure for one slot: where its sprite is drawn, in whole pixels
+struct SpectatorSlot {
+    int16_t x;
+    int16_t y;
+    uint8_t look; // SS_NONE for an empty slot
+};
+
+// Structure for everything a spectator draws
+struct SpectatorView {
+    uint32_t tick;
+    uint32_t score;
+    uint8_t lives;
+    uint16_t level;
+    SpectatorSlot slots[SPECTATOR_SLOTS];
+};
+
+// Positions are sent in whole pixels
+inline int16_t spectatorPixel(float position) {
+    return (int16_t) floor(position + 0.5f);
+}
+
+inline uint8_t spectatorLook(int sprite, int frame) {
+    return (uint8_t) (sprite | frame << 4);
+}
+
+inline void spectatorPut16(unsigned char*& out, uint16_t value) {
+    out[0] = value & 0xff;
+    out[1] = value >> 8;
+    out += 2;
+}
+
+inline void spectatorPut32(unsigned char*& out, uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        out[i] = (value >> (8 * i)) & 0xff;
+    out += 4;
+}
+
+inline uint16_t spectatorGet16(const unsigned char*& in) {
+    uint16_t value = in[0] | in[1] << 8;
+    in += 2;
+    return value;
+}
+
+inline uint32_t spectatorGet32(const unsigned char*& in) {
+    uint32_t value = in[0] | in[1] << 8 | in[2] << 16 | (uint32_t) in[3] << 24;
+    in += 4;
+    return value;
+}
+
+#endif